@@ -2,13 +2,21 @@
 #define SIM_MMU_H
 
 #include <cstdint>
+#include <deque>
+#include <optional>
 #include <unordered_map>
+#include <vector>
 
+#include "sim/cache.h"
+#include "sim/cgroup.h"
 #include "sim/process.h"
 #include "sim/physicalmem.h"
 #include "sim/clock.h"
 #include "sim/TLB.h"
 #include "sim/metrics.h"
+#include "sim/config.h"
+#include "sim/swap.h"
+#include "sim/zswap.h"
 
 
 
@@ -16,41 +24,285 @@ namespace sim {
 
 // Result of a memory access attempt
 enum class MMUAccessResult {
-    HIT,
+    HIT,            // TLB hit
+    PT_HIT,         // TLB miss, page table hit
     PAGE_FAULT
 };
 
+// Outcome of a calloc: pages that may hold old data must be zeroed by
+// the caller; fresh pages come zero-filled on first touch
+struct CallocResult {
+    std::optional<uint64_t> addr;
+    std::vector<uint64_t> zero_vpns;
+};
+
+/*
+ * MMU
+ *
+ * Page tables live in the processes; the MMU owns one TLB per core.
+ * Accesses name the core they run on. Dropping a translation other
+ * cores still cache (eviction, DONTNEED, munmap) sends each of them a
+ * shootdown IPI: the entry goes and the core owes shootdown_latency
+ * stall cycles, which the caller collects with take_shootdown_stall().
+ *
+ * With NUMA nodes, cores are split evenly over the nodes. Faulted-in
+ * pages are placed per numa-policy. An access to another node's frame
+ * costs numa-latency per 10 of SLIT distance over local. Every
+ * numa-sample'th access to a first-touch page is a hinting fault: two
+ * in a row from the same remote node migrate the page there (AutoNUMA's
+ * two-stage filter), if that node has a free frame.
+ *
+ * With caches configured, an access costs tlb-hit-latency plus its data
+ * reference through the hierarchy; a TLB miss adds one reference per
+ * walk level (pt-hit-latency no longer applies) and a fault adds the
+ * walk to fault-latency. Page-table pages get physical addresses above
+ * the data frames as the walk first reaches them, so neighbouring pages
+ * share PTE lines. Remote NUMA cost only applies to references that
+ * reach memory.
+ *
+ * frame-policy picks whose frame a fault takes. global: any process's
+ * LRU frame. local: the faulting process's own least recently
+ * referenced page once it holds frame-budget frames. ws and pff size
+ * each resident set from the process's own references (its virtual
+ * time): trim_resident_set() drops what left the working set, and a
+ * fault with no free frame left replaces the process's own page.
+ * Deciding who to swap out instead is the caller's load control.
+ *
+ * Every frame is charged to its process's cgroup (see cgroup.h). With
+ * a max or low configured, a fault past a group's max evicts inside
+ * that group, and a fault that finds memory full spares protected
+ * groups while others have pages; both pick the LRU frame among the
+ * candidates.
+ *
+ * With a zswap pool, an evicted page (not lazily freed) is compressed
+ * into it when it fits, else it goes to swap. A fault on a pooled page
+ * takes zswap-decompress-latency to page in instead of pagein-latency;
+ * compressing costs zswap-compress-latency per page, owed by whoever
+ * evicted it (see take_compress_cycles()).
+ *
+ * With swap-slots set, pages that go to swap get slots in the swap area
+ * (see swap.h). A fault on a page still in the swap cache takes
+ * swap-cache-latency; one that misses reads its readahead window.
+ */
 class MMU {
 public:
+    // Takes geometry, latencies, heap layout and release policy from cfg
     MMU(PhysicalMemory &pmem,
-    uint64_t page_size,
-    size_t tlb_size,
+    const SimConfig &cfg,
     Metrics &metrics);
 
-    // Process lifecycle
+    // Process lifecycle; cgroup is a path in the cgroup tree ("" = root)
     void register_process(uint32_t pid,
                       uint64_t heap_base,
-                      uint64_t heap_size);
+                      uint64_t heap_size,
+                      const std::string &cgroup = "");
+
+    // Frees every frame the process still holds
+    void unregister_process(uint32_t pid, uint64_t now);
+
+    // Layout applied to processes registered from now on
+    void set_heap_layout(const HeapLayout &layout) noexcept;
+
+    // Threads of a process; exiting flushes the thread's cache and
+    // returns the number of pages released or unmapped
+    void thread_start(uint32_t pid, uint32_t tid);
+    uint64_t thread_exit(uint32_t pid, uint32_t tid, uint64_t now);
+
+    // Heap operations: virtual side in Process, physical side here.
+    // heap_free returns the number of pages released or unmapped.
+    std::optional<uint64_t> heap_alloc(uint32_t pid, uint64_t size, uint32_t tid = 0);
+    uint64_t heap_free(uint32_t pid, uint64_t addr, uint64_t now, uint32_t tid = 0);
+    HeapReallocResult heap_realloc(uint32_t pid, uint64_t addr, uint64_t size,
+                                   uint32_t tid = 0);
+    CallocResult heap_calloc(uint32_t pid, uint64_t size, uint32_t tid = 0);
+
+    // Attempt an access from `core` (does NOT resolve faults)
+    MMUAccessResult access(uint32_t pid, uint64_t vaddr, uint32_t core = 0);
+
+    // Cycles the last access() cost (its latency sample)
+    uint64_t last_access_latency() const noexcept;
+
+    // Cycles until the page of the last faulting access() is in: its
+    // tier's page-in latency
+    uint64_t last_pagein_latency() const noexcept;
+
+    // Complete a previously faulted page-in, on the core that faulted;
+    // true if it had to evict a page for it (direct reclaim). Unaccounted
+    // (sampled fast-forward), Metrics and stall charges are left alone
+    bool complete_pagein(uint32_t pid, uint64_t vpn, uint64_t now,
+                         uint32_t core = 0, bool account = true);
 
-    void unregister_process(uint32_t pid);
+    // Functional access for sampled fast-forward: the same TLB and page
+    // table changes as access(), without touching Metrics. True if it
+    // completed, taking last_access_latency() (cache and NUMA cycles
+    // left out); false if it faulted, and the page comes in through an
+    // unaccounted complete_pagein() after last_pagein_latency(), so the
+    // process blocks just as in detail
+    bool warm_access(uint32_t pid, uint64_t vaddr, uint32_t core = 0);
 
-    // Attempt an access (does NOT resolve faults)
-    MMUAccessResult access(uint32_t pid, uint64_t vaddr);
+    // Heap page release (madvise-style)
+    void set_heap_release_policy(HeapReleasePolicy policy) noexcept;
+    HeapReleasePolicy heap_release_policy() const noexcept;
 
-    // Complete a previously faulted page-in
-    void complete_pagein(uint32_t pid, uint64_t vpn, uint64_t now);
+    // Apply the release policy to every whole page inside [start, end).
+    // Returns the number of pages released.
+    uint64_t release_heap_range(uint32_t pid, uint64_t start, uint64_t end,
+                                uint64_t now);
+
+    // munmap: drop every page in [start, end) and free its frame
+    uint64_t unmap_range(uint32_t pid, uint64_t start, uint64_t end,
+                         uint64_t now);
 
     uint64_t vpn_from_vaddr(uint64_t vaddr) const noexcept;
 
+    // Drop every entry of core's TLB (switch on an untagged TLB)
+    void flush_tlb(uint32_t core = 0);
+
+    size_t cores() const noexcept;
+    const TLB& tlb(uint32_t core) const;
+
+    // Stall cycles core owes for shootdowns since the last call
+    uint64_t take_shootdown_stall(uint32_t core);
+
+    // Shootdown IPIs core has received
+    uint64_t shootdowns_received(uint32_t core) const;
+
+    uint32_t core_node(uint32_t core) const;
+
+    // ws/pff, at a fault of pid: drops the pages outside its working
+    // set (ws: not referenced in the last ws-window references; pff: not
+    // since the previous fault, if that was over pff-interval ago).
+    // Returns the number dropped.
+    uint64_t trim_resident_set(uint32_t pid, uint64_t now, bool account = true);
+
+    // Load control: every resident page of pid goes out; returns how many
+    uint64_t swap_out(uint32_t pid, uint64_t now, bool account = true);
+
+    // Background reclaim: evicts up to `pages` frames, the ones a fault
+    // would (cgroup protection included); returns how many
+    uint64_t reclaim(uint64_t pages, uint64_t now, bool account = true);
+
+    // Compression cycles owed by evictions since the last call
+    uint64_t take_compress_cycles();
+
+    const CacheHierarchy& caches() const noexcept;
+    const CgroupTree& cgroups() const noexcept;
+    const ZswapPool& zswap() const noexcept;
+    const SwapArea& swap() const noexcept;
+
     Process& process(uint32_t pid);
+    const std::unordered_map<uint32_t, Process>& processes() const noexcept;
+
+    // TLBs and every process; latencies and policies stay as configured
+    void save(SnapshotWriter &w) const;
+    void load(SnapshotReader &r);
 
 private:
     PhysicalMemory &pmem_;
     uint64_t page_size_;
-    TLB tlb_;
+    uint64_t tlb_hit_latency_;
+    uint64_t pt_hit_latency_;
+    uint64_t fault_latency_;
+    uint64_t shootdown_latency_;
+    uint64_t pagein_latency_;
+    std::deque<TLB> tlbs_;                   // one per core
+    std::vector<uint64_t> stall_;            // owed shootdown cycles, per core
+    std::vector<uint64_t> received_;         // shootdown IPIs, per core
+    uint64_t last_latency_;
+    uint64_t last_pagein_;
+
+    // NUMA (numa_ off with one node)
+    bool numa_;
+    NumaPolicy numa_policy_;
+    std::vector<uint32_t> core_node_;                // per core
+    std::vector<std::vector<uint32_t>> fallback_;    // per node: nodes nearest first
+    std::vector<uint32_t> bind_order_;
+    std::vector<std::vector<uint64_t>> remote_cost_; // [from][to] extra cycles
+    uint64_t numa_sample_;
+    uint64_t numa_migrate_latency_;
+    uint64_t numa_accesses_;                         // toward the next hinting fault
+
+    // Caches, and the page-table pages walks read through them
+    CacheHierarchy caches_;
+    uint64_t pt_base_;                               // first page-table address
+    unsigned pte_bits_;                              // log2 of PTEs per table
+    uint64_t walk_levels_;
+    std::unordered_map<uint32_t, std::unordered_map<uint64_t, uint64_t>> page_tables_;
+                                                     // pid → (prefix, level) → table
+    std::vector<uint64_t> free_tables_;              // of exited processes, reused first
+    uint64_t next_table_;
     Metrics &metrics_;
+    HeapReleasePolicy release_policy_;
+    FramePolicy frame_policy_;
+    uint64_t frame_budget_;
+    uint64_t ws_window_;
+    uint64_t pff_interval_;
+    CgroupTree cgroups_;
+    std::unordered_map<uint32_t, uint32_t> cgroup_of_;   // pid → group
+    ZswapPool zswap_;
+    uint64_t compress_latency_;
+    uint64_t decompress_latency_;
+    uint64_t compress_owed_;
+    SwapArea swap_;
+    uint64_t swap_cache_latency_;
+    HeapLayout layout_;
+    std::vector<HeapFreeResult> freed_scratch_;
 
     std::unordered_map<uint32_t, Process> processes_;
+
+    void account_heap(const HeapCounters &before, const HeapCounters &after);
+    uint64_t release_freed(uint32_t pid, uint64_t now);
+
+    // A frame for (pid, vpn) under frame-policy and the cgroup limits
+    // (may evict), charged to pid's group
+    FrameAllocResult allocate_frame(uint32_t pid, Process &proc, uint64_t vpn,
+                                    uint64_t now, bool account);
+    FrameAllocResult take_frame(uint32_t pid, Process &proc, uint32_t group,
+                                uint64_t vpn, uint64_t now, bool account);
+
+    // The frame reclaim for scope's sake takes on node (NO_NODE: any);
+    // breach: only protected pages were left
+    int reclaim_victim(uint32_t scope, uint32_t node, bool &breach) const;
+
+    // Uncharge and free
+    void free_frame(int frame_id);
+    uint32_t cgroup_of(uint32_t pid) const;
+
+    // Unmap an evicted page: lazily freed contents are dropped, the
+    // rest go to the zswap pool or the swap area
+    void evict_page(uint32_t pid, Process &proc, uint64_t vpn, bool lazy, bool account);
+
+    // proc's resident page count changed
+    void note_rss(const Process &proc);
+
+    // Unmap and free each (vpn, frame) page of pid
+    void drop_resident(uint32_t pid, Process &proc,
+                       const std::vector<std::pair<uint64_t, int>> &pages, bool account);
+    FrameAllocResult page_in(uint32_t pid, Process &proc, uint64_t vpn,
+                             uint64_t now, bool account);
+
+    // Tier a faulting page comes back from (reading its swap window);
+    // sets last_pagein_ to that tier's latency
+    PageinSource fault_source(uint32_t pid, const Process &proc, uint64_t vpn);
+
+    // Nodes to place vpn on, in order, for a fault from core
+    const std::vector<uint32_t> &placement(uint64_t vpn, uint32_t core) const;
+
+    // Local/remote accounting and hinting faults for an access to
+    // `frame`; returns the extra cycles (remote cost only if `memory`)
+    uint64_t numa_access(uint32_t pid, Process &proc, uint64_t vpn, int frame,
+                         uint32_t core, bool memory);
+
+    // Data reference for vaddr in frame; sets `memory` if it missed
+    // every cache level (always, without caches)
+    uint64_t data_ref(uint32_t core, int frame, uint64_t vaddr, bool &memory);
+
+    // Reads vpn's PTE at every walk level; cycles spent, or 0 if `warm`
+    uint64_t walk(uint32_t pid, uint64_t vpn, uint32_t core, bool warm);
+
+    // Drop (pid, vpn) from every TLB; cores other than the initiator
+    // that cached it get an IPI (counted and stalled if `account`)
+    void shootdown(uint32_t pid, uint64_t vpn, uint32_t initiator, bool account);
 };
 
 } // namespace sim
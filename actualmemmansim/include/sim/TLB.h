@@ -6,6 +6,9 @@
 #include <memory>
 namespace sim {
 
+class SnapshotWriter;
+class SnapshotReader;
+
 /*
  * TLBEntry
  *
@@ -52,8 +55,9 @@ public:
     // Invalidate all entries for a process
     void flush_process(uint32_t pid);
 
-    // Invalidate single translation (used on eviction)
-    void invalidate(uint32_t pid, uint64_t vpn);
+    // Invalidate single translation (used on eviction); true if it
+    // was cached
+    bool invalidate(uint32_t pid, uint64_t vpn);
 
     // Flush entire TLB
     void flush_all();
@@ -62,6 +66,12 @@ public:
     uint64_t hits() const noexcept;
     uint64_t misses() const noexcept;
     double hit_rate() const noexcept;
+
+    // -------- Checkpoint --------
+    // Entries in replacement order; load() keeps this TLB's capacity
+    void save(SnapshotWriter &w) const;
+    void load(SnapshotReader &r);
+
     ~TLB();
 
 private:
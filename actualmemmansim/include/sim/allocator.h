@@ -2,11 +2,14 @@
 #define SIM_ALLOCATOR_H
 
 #include <cstdint>
-#include <map>
 #include <optional>
+#include <vector>
 
 namespace sim {
 
+class SnapshotWriter;
+class SnapshotReader;
+
 /*
  * HeapAllocator
  *
@@ -19,8 +22,17 @@ namespace sim {
  *
  * Address space model:
  *   [heap_base ........................................ heap_end)
+ * heap_end moves up when the owner grows the heap (brk).
  *
- * Internally maintains free and allocated blocks.
+ * Internally maintains free and allocated blocks as boundary tags in a
+ * flat array (no per-block host allocations):
+ *   - every block, free or allocated, has one Tag
+ *   - tags are chained in address order (physical neighbours)
+ *   - free tags are additionally chained in an address-ordered free list,
+ *     and kept in a treap by address so a new free block finds its list
+ *     position in O(log free blocks)
+ *   - allocated tags are found by address through an open-addressing index
+ * Tag slots are recycled, so steady-state alloc/free never calls host malloc.
  */
 class HeapAllocator {
 public:
@@ -42,8 +54,30 @@ public:
     std::optional<uint64_t> alloc(uint64_t size);
 
     // Free a previously allocated block by its starting address.
-    // Undefined behavior if addr was not returned by alloc().
-    void free(uint64_t addr);
+    // Throws if addr was not returned by alloc().
+    // Returns the free block the range ended up in after coalescing.
+    Block free(uint64_t addr);
+
+    // Resize an allocated block without moving it: shrinking hands the
+    // tail back to the free list, growing takes bytes from the free block
+    // right after it. Returns false (block untouched) if that block is
+    // missing or too small. Throws if addr was not returned by alloc().
+    bool try_resize(uint64_t addr, uint64_t new_size);
+
+    // Size of an allocated block. Throws if addr was not returned by alloc().
+    uint64_t block_size(uint64_t addr) const;
+
+    // Owner tag of an allocated block (e.g. the thread whose cache holds
+    // it). 0 after alloc(). Throws if addr was not returned by alloc().
+    void set_owner(uint64_t addr, uint32_t owner);
+    uint32_t owner(uint64_t addr) const;
+
+    // Extend the heap end by `bytes` (brk). The new space joins the
+    // top free block, or becomes one.
+    void grow(uint64_t bytes);
+
+    uint64_t heap_base() const noexcept;
+    uint64_t heap_end() const noexcept;
 
     // ---------------- Metrics ----------------
 
@@ -59,21 +93,74 @@ public:
     // 1 - (largest_free_block / free_bytes)
     double external_fragmentation() const noexcept;
 
+    // ---------------- Checkpoint ----------------
+
+    // load() replaces the whole state, bounds included
+    void save(SnapshotWriter &w) const;
+    void load(SnapshotReader &r);
+
 private:
+    // Boundary tag for one block. 40 bytes; links are tag slot indices.
+    struct Tag {
+        uint64_t start;       // virtual start address
+        uint64_t size;        // size in bytes, top bit = FREE_BIT
+        uint32_t prev;        // physical neighbour below (NIL at heap base)
+        uint32_t next;        // physical neighbour above (NIL at heap end)
+        uint32_t prev_free;   // free list links (address order); while
+        uint32_t next_free;   // allocated, prev_free holds the owner tag
+                              // and next_free chains recycled slots
+        uint32_t left;        // free treap children (free tags only)
+        uint32_t right;
+    };
+
+    static constexpr uint32_t NIL = UINT32_MAX;
+    static constexpr uint64_t FREE_BIT = 1ull << 63;
+
     // Heap bounds
     uint64_t heap_base_;
     uint64_t heap_size_;
 
-    // Free blocks, keyed by start address
-    std::map<uint64_t, Block> free_blocks_;
+    // Block metadata
+    std::vector<Tag> tags_;
+    uint32_t free_head_;      // lowest-address free block
+    uint32_t free_root_;      // root of the free treap
+    uint32_t tail_;           // highest-address block
+    uint32_t spare_slots_;    // recycled tag slots
 
-    // Allocated blocks, keyed by start address
-    std::map<uint64_t, Block> allocated_blocks_;
+    // Allocated blocks: start address -> tag slot (linear probing)
+    std::vector<uint32_t> index_;
+    size_t index_count_;
+    unsigned index_bits_;
 
     // Fragmentation accounting
     uint64_t allocated_bytes_;
     uint64_t internal_frag_bytes_;
 
+    // Tag helpers
+    uint64_t tag_size(uint32_t t) const noexcept;
+    bool tag_is_free(uint32_t t) const noexcept;
+    uint32_t new_tag(uint64_t start, uint64_t size);
+    void release_tag(uint32_t t);
+    void unlink_phys(uint32_t t);
+    void unlink_free(uint32_t t);
+    void insert_free_after(uint32_t t, uint32_t pred);
+
+    // Free treap: keyed by start address, heap-ordered by a hash of the
+    // slot, so its shape follows from the free blocks alone
+    static uint64_t treap_priority(uint32_t t) noexcept;
+    uint32_t free_below(uint64_t addr) const noexcept;   // NIL if none
+    void treap_insert(uint32_t t);
+    void treap_erase(uint32_t t);
+    uint32_t treap_merge(uint32_t a, uint32_t b);
+    void treap_split(uint32_t n, uint64_t addr, uint32_t &lo, uint32_t &hi);
+
+    // Index helpers
+    size_t index_home(uint64_t addr) const noexcept;
+    uint32_t index_find(uint64_t addr) const noexcept;
+    void index_insert(uint32_t t);
+    void index_erase(uint64_t addr);
+    void index_grow();
+
     // Alignment helper (kept simple for now)
     static constexpr uint64_t ALIGNMENT = 8;
     static uint64_t align_up(uint64_t n) noexcept;
@@ -0,0 +1,119 @@
+#ifndef SIM_CACHE_H
+#define SIM_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sim/config.h"
+
+namespace sim {
+
+class SnapshotWriter;
+class SnapshotReader;
+
+/*
+ * Cache
+ *
+ * One set-associative cache over physical addresses. Tags only: there
+ * is no data and no dirty state, so write-backs are not timed. A miss
+ * fills the line, into an empty way if there is one, else over the
+ * policy's victim.
+ */
+class Cache {
+public:
+    Cache(const CacheLevelConfig &cfg, uint64_t line, CacheReplacement policy);
+
+    // True on a hit; a miss fills the line
+    bool access(uint64_t paddr);
+
+    // Lines in replacement state order; load() needs the same geometry
+    void save(SnapshotWriter &w) const;
+    void load(SnapshotReader &r);
+
+private:
+    static constexpr uint64_t EMPTY = UINT64_MAX;
+
+    uint64_t sets_;
+    uint32_t ways_;
+    unsigned line_shift_;
+    CacheReplacement policy_;
+
+    std::vector<uint64_t> tags_;     // sets x ways line addresses
+    std::vector<uint64_t> stamps_;   // lru: last use of each way
+    std::vector<uint64_t> tree_;     // plru: ways - 1 direction bits per set
+    uint64_t tick_;
+
+    // Way to fill in set
+    uint32_t victim(uint64_t set) const;
+
+    // Record a use of (set, way)
+    void touch(uint64_t set, uint32_t way);
+};
+
+// What a reference through the hierarchy is for
+enum class CacheRef {
+    DATA,       // the access itself
+    WALK        // a page-table entry read on a TLB miss
+};
+
+// Hits and misses of one level, summed over its caches
+struct CacheLevelStats {
+    std::string name;                   // "l1", "l2", "llc"
+    CacheLevelConfig geometry;
+    bool shared = false;                // one cache for all cores
+    uint64_t hits[2] = { 0, 0 };        // by CacheRef
+    uint64_t misses[2] = { 0, 0 };
+
+    double hit_rate() const noexcept;
+};
+
+/*
+ * CacheHierarchy
+ *
+ * Private L1 and L2 per core in front of one shared LLC; any level may
+ * be left out. A reference probes the levels in order and costs the
+ * latency of the first that hits, or mem-latency after missing every
+ * one. Each level it missed gets the line (non-inclusive, no
+ * back-invalidation).
+ *
+ * No coherence traffic: a page belongs to one process, and a process
+ * runs on one core at a time.
+ */
+class CacheHierarchy {
+public:
+    explicit CacheHierarchy(const SimConfig &cfg);
+
+    CacheHierarchy(const CacheHierarchy &) = delete;
+    CacheHierarchy &operator=(const CacheHierarchy &) = delete;
+
+    // False with every level left out: access() must not be called
+    bool enabled() const noexcept;
+
+    // Cycles for one reference from core; `memory` tells whether it
+    // missed every level
+    uint64_t access(uint32_t core, uint64_t paddr, CacheRef ref, bool &memory);
+
+    // Functional reference for fast-forward: fills, counts nothing
+    void warm(uint32_t core, uint64_t paddr);
+
+    const std::vector<CacheLevelStats> &levels() const noexcept;
+
+    // References that missed every level
+    uint64_t memory_refs(CacheRef ref) const noexcept;
+
+    void save(SnapshotWriter &w) const;
+    void load(SnapshotReader &r);
+
+private:
+    std::vector<std::vector<Cache>> caches_;   // per level: one per core, or one shared
+    std::vector<CacheLevelStats> stats_;
+    uint64_t mem_latency_;
+    uint64_t memory_[2];
+
+    Cache &cache(size_t level, uint32_t core);
+};
+
+} // namespace sim
+
+#endif // SIM_CACHE_H
@@ -0,0 +1,92 @@
+#ifndef SIM_CGROUP_H
+#define SIM_CGROUP_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "sim/config.h"
+
+namespace sim {
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// One group of the tree. usage counts the frames of the whole subtree;
+// the fault counters only the group's own processes.
+struct Cgroup {
+    std::string path;                // "" = root, else "a/b"
+    uint32_t parent = 0;
+    uint64_t max = 0;                // 0 = no limit
+    uint64_t low = 0;                // 0 = no protection
+
+    uint64_t usage = 0;
+    uint64_t peak = 0;
+    uint64_t faults = 0;
+    uint64_t limit_faults = 0;       // faults that had to reclaim for a max
+    uint64_t reclaimed = 0;          // pages reclaimed because of this max
+    uint64_t evicted = 0;            // own pages taken by any reclaim
+    uint64_t low_breaches = 0;       // evicted while protected: nothing else left
+
+    double limit_fault_rate() const noexcept;
+};
+
+/*
+ * CgroupTree
+ *
+ * Memory cgroups with memory.max and memory.low, counted in frames. A
+ * frame is charged to its process's group and every ancestor. Charging
+ * one more frame past a max makes the fault reclaim inside that group
+ * first (the deepest one over, as the kernel's charge walk fails
+ * there). A group whose usage, or an ancestor's, is within its low is
+ * protected: reclaim from outside it takes unprotected pages while
+ * there are any.
+ *
+ * Groups named by a process but not by SimConfig::cgroups are created
+ * with no limits, along with their parents.
+ */
+class CgroupTree {
+public:
+    static constexpr uint32_t ROOT = 0;
+
+    explicit CgroupTree(const std::vector<CgroupConfig> &cfg);
+
+    // "" or "/" = root; leading and trailing '/' are ignored
+    uint32_t find_or_create(const std::string &path);
+
+    // Some group has a max or a low
+    bool limited() const noexcept;
+
+    void charge(uint32_t id);
+    void uncharge(uint32_t id);
+
+    // Deepest group from id up with no room for one more frame
+    std::optional<uint32_t> over_limit(uint32_t id) const;
+
+    bool in_subtree(uint32_t id, uint32_t ancestor) const;
+
+    // Within the low of id or an ancestor below scope (the group
+    // reclaiming)
+    bool is_protected(uint32_t id, uint32_t scope = ROOT) const;
+
+    void record_fault(uint32_t id, bool limit);
+
+    // A page of victim's reclaimed, for limited's max (none: memory full)
+    void record_reclaim(std::optional<uint32_t> limited, uint32_t victim, bool breach);
+
+    const std::vector<Cgroup> &groups() const noexcept;
+
+    void save(SnapshotWriter &w) const;
+    void load(SnapshotReader &r);
+
+private:
+    std::vector<Cgroup> groups_;     // parents before children
+    bool limited_;
+
+    std::optional<uint32_t> find(const std::string &path) const;
+};
+
+} // namespace sim
+
+#endif // SIM_CGROUP_H
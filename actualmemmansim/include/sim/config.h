@@ -0,0 +1,184 @@
+#ifndef SIM_CONFIG_H
+#define SIM_CONFIG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "sim/process.h"
+
+namespace sim {
+
+// What FREE does with heap pages that became entirely free
+enum class HeapReleasePolicy {
+    NONE,       // keep them mapped (LRU reclaims them eventually)
+    DONTNEED,   // MADV_DONTNEED: unmap now, frame back to the free pool
+    LAZY_FREE   // MADV_FREE: stay mapped, reclaimed first under pressure
+};
+
+// Which ready process gets the CPU, and for how long
+enum class SchedPolicy {
+    FIFO,       // run until it blocks, then the longest-waiting one
+    RR,         // round robin, one quantum per turn
+    CFS         // least virtual runtime first, slice shrinks with load
+};
+
+// What a switch to another process does to the TLB
+enum class TlbSwitchPolicy {
+    ASID,       // entries are tagged by process and survive the switch
+    FLUSH       // untagged TLB: flushed on every switch
+};
+
+// Which node a faulted-in page goes to
+enum class NumaPolicy {
+    FIRST_TOUCH,  // the faulting core's node, else the nearest with room
+    INTERLEAVE,   // round robin over the nodes by page number
+    BIND          // numa-bind's node only; evicts there when it is full
+};
+
+// Whose frame a fault may take, and how many a process may hold
+enum class FramePolicy {
+    GLOBAL,     // any process's LRU frame
+    LOCAL,      // its own LRU page once it holds frame-budget frames
+    WS,         // working set: pages referenced in the last ws-window references
+    PFF         // page-fault frequency: grow under pff-interval, else trim
+};
+
+// One memory cgroup; limits in frames, 0 = none
+struct CgroupConfig {
+    std::string path;                 // "a/b": group b under group a
+    uint64_t max = 0;                 // memory.max: over it, reclaim inside the group
+    uint64_t low = 0;                 // memory.low: spared by reclaim from outside
+};
+
+// One bucket of the compressed pool's ratio distribution
+struct ZswapRatio {
+    double ratio = 3.0;               // page size / compressed size; 1 = incompressible
+    uint64_t weight = 1;              // relative share of pages
+};
+
+// Which way of a full cache set a fill replaces
+enum class CacheReplacement {
+    LRU,        // least recently used
+    PLRU        // tree pseudo-LRU; ways must be a power of two
+};
+
+// One cache level; size 0 = no such level
+struct CacheLevelConfig {
+    uint64_t size = 0;                // bytes
+    uint64_t ways = 0;
+    uint64_t latency = 0;             // cycles for a hit here
+};
+
+/*
+ * SimConfig
+ *
+ * Everything that describes the simulated machine, so one binary covers
+ * a whole sweep.
+ *
+ * Keys are the command-line option names without "--". A config file
+ * holds one "key = value" per line; '#' starts a comment.
+ */
+struct SimConfig {
+    // -------- Machine geometry --------
+    uint64_t page_size = 4096;
+    size_t num_frames = 4;
+    size_t tlb_size = 16;             // per core
+    size_t cores = 1;
+
+    // -------- Latencies (cycles) --------
+    uint64_t tlb_hit_latency = 1;
+    uint64_t pt_hit_latency = 5;      // TLB miss, page table hit
+    uint64_t fault_latency = 100;     // charged to the faulting access
+    uint64_t pagein_latency = 10;     // fault → PAGEIN_COMPLETE
+    uint64_t shootdown_latency = 50;  // stall of a core hit by a TLB shootdown IPI
+
+    // -------- Policies / allocator --------
+    HeapReleasePolicy heap_release = HeapReleasePolicy::NONE;
+    HeapLayout heap;
+
+    // -------- Scheduler --------
+    SchedPolicy sched = SchedPolicy::FIFO;
+    uint64_t quantum = 50;            // rr slice; cfs target latency
+    uint64_t ctx_switch_latency = 0;  // cycles per switch to another process
+    TlbSwitchPolicy tlb_switch = TlbSwitchPolicy::ASID;
+
+    // -------- NUMA --------
+    size_t numa_nodes = 1;                // frames and cores split evenly
+    std::vector<uint64_t> numa_distance;  // row-major SLIT; empty = 10 local, 20 remote
+    NumaPolicy numa_policy = NumaPolicy::FIRST_TOUCH;
+    uint32_t numa_bind = 0;
+    uint64_t numa_latency = 10;           // extra cycles per 10 of distance over local
+    uint64_t numa_sample = 0;             // every Nth access is a hinting fault, 0 = off
+    uint64_t numa_migrate_latency = 200;  // copying a page to another node
+
+
+    // -------- Resident sets --------
+    FramePolicy frame_policy = FramePolicy::GLOBAL;
+    uint64_t frame_budget = 0;            // local: frames per process, 0 = equal share
+    uint64_t ws_window = 100;             // ws: tau, in the process's own references
+    uint64_t pff_interval = 50;           // pff: references between faults
+
+    // -------- Background reclaim (kswapd; watermarks in free frames) --------
+    uint64_t watermark_low = 0;           // wake kswapd below this, 0 = no kswapd
+    uint64_t watermark_high = 0;          // kswapd reclaims up to this
+    uint64_t kswapd_batch = 32;           // pages per kswapd pass
+    uint64_t reclaim_latency = 0;         // cycles per page reclaimed
+
+    // -------- Memory cgroups (PROC_START's third argument) --------
+    std::vector<CgroupConfig> cgroups;    // limits; unlisted groups have none
+
+    // -------- Compressed pool (zswap/zram) in front of swap --------
+    uint64_t zswap_pool = 0;              // bytes of compressed pages, 0 = no pool
+    std::vector<ZswapRatio> zswap_ratio{ ZswapRatio{} };
+    uint64_t zswap_compress_latency = 2;       // per page stored
+    uint64_t zswap_decompress_latency = 1;     // page-in from the pool
+
+    // -------- Swap area layout (pages) --------
+    uint64_t swap_slots = 0;              // 0 = swap has no layout, no swap cache
+    uint64_t swap_cluster = 16;           // slots per allocation cluster
+    uint64_t swap_readahead = 8;          // slots read per swap-in I/O, <= 1 = off
+    uint64_t swap_cache = 64;             // pages written out or read ahead, kept
+    uint64_t swap_cache_latency = 1;      // page-in from the swap cache
+
+    // -------- Caches (every level absent = flat latencies) --------
+    CacheLevelConfig l1;                  // private, per core
+    CacheLevelConfig l2;                  // private, per core
+    CacheLevelConfig llc;                 // shared
+    uint64_t cache_line = 64;
+    CacheReplacement cache_policy = CacheReplacement::LRU;
+    uint64_t mem_latency = 100;           // a reference that misses every level
+    uint64_t walk_levels = 4;             // page-table entries read per TLB miss
+
+    // SLIT distance from one node to another
+    uint64_t distance(size_t from, size_t to) const noexcept;
+
+    // Any cache level configured
+    bool caches() const noexcept;
+
+    // Returns false for an unknown key; throws std::invalid_argument
+    // for a bad value
+    bool set(const std::string &key, const std::string &value);
+
+    // Throws std::invalid_argument describing the first bad setting
+    void validate() const;
+};
+
+// Throws std::runtime_error naming the file and line on any error
+void load_config_file(const std::string &path, SimConfig &cfg);
+
+// The config in file syntax, every key listed
+void write_config(std::ostream &os, const SimConfig &cfg);
+
+const char *heap_release_name(HeapReleasePolicy policy) noexcept;
+const char *sched_policy_name(SchedPolicy policy) noexcept;
+const char *tlb_switch_name(TlbSwitchPolicy policy) noexcept;
+const char *numa_policy_name(NumaPolicy policy) noexcept;
+const char *cache_policy_name(CacheReplacement policy) noexcept;
+const char *frame_policy_name(FramePolicy policy) noexcept;
+
+} // namespace sim
+
+#endif // SIM_CONFIG_H
@@ -9,6 +9,9 @@
 
 namespace sim {
 
+class SnapshotWriter;
+class SnapshotReader;
+
 // Deterministic ordering key used for events.
 struct EventKey {
     uint64_t time{0};    // simulation time in cycles
@@ -20,6 +23,7 @@ struct EventKey {
 // Simple event record produced by parser or simulator.
 struct Event {
     EventKey key;
+    uint32_t tid{0};                // thread within key.pid (0 = main thread)
     std::string type;               // e.g., "ACCESS", "MALLOC", "PAGEIN_COMPLETE"
     std::vector<std::string> args;  // raw args (strings)
     std::string raw_line;           // original CSV line (optional; for debugging)
@@ -38,6 +42,9 @@ class EventQueue {
 public:
     EventQueue();
 
+    // Sequence numbers start at first_seq (to follow events numbered elsewhere)
+    explicit EventQueue(uint64_t first_seq);
+
     // Push a pre-constructed Event. If ev.key.seq == 0, seq will be assigned.
     void push(Event ev);
 
@@ -60,6 +67,10 @@ public:
     // Expose next sequence for external use (read-only)
     uint64_t next_seq() const noexcept;
 
+    // Pending events (in pop order) and the sequence counter
+    void save(SnapshotWriter &w) const;
+    void load(SnapshotReader &r);
+
 private:
     // underlying priority queue using EventCompare
     std::priority_queue<Event, std::vector<Event>, EventCompare> pq_;
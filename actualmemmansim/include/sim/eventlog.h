@@ -0,0 +1,128 @@
+#ifndef SIM_EVENTLOG_H
+#define SIM_EVENTLOG_H
+
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <string>
+
+namespace sim {
+
+// ---------------- Levels ----------------
+
+enum class LogLevel {
+    OFF,        // nothing on stdout/stderr
+    SUMMARY,    // end-of-run summary and failures only
+    FAULTS,     // + page faults and page-in completions
+    ALL         // + every event (the classic trace)
+};
+
+// ---------------- Records ----------------
+
+enum class LogKind : uint8_t {
+    PROC_START,
+    PROC_EXIT,
+    THREAD_START,
+    THREAD_EXIT,        // a = released pages
+    MALLOC,             // a = size, b = addr
+    FREE,               // a = addr, b = released pages
+    REALLOC,            // a = old addr, b = size, c = new addr, d = copy bytes
+    CALLOC,             // a = size, b = addr, c = zeroed pages
+    ACCESS_HIT,         // a = vaddr
+    PAGE_FAULT,         // a = vpn
+    PAGEIN_COMPLETE,    // a = vpn
+    MALLOC_FAILED,
+    REALLOC_FAILED,
+    CALLOC_FAILED,
+    PREEMPT,            // time slice over, back to the ready queue
+    SUSPEND,            // a = pages swapped out
+    RESUME,
+    KSWAPD,             // a = pages reclaimed, b = free frames after
+    NUM_KINDS
+};
+
+struct LogRecord {
+    LogKind kind = LogKind::PROC_START;
+    uint64_t time = 0;
+    uint32_t pid = 0;
+    uint32_t tid = 0;
+    uint64_t a = 0;
+    uint64_t b = 0;
+    uint64_t c = 0;
+    uint64_t d = 0;
+    bool moved = false;     // REALLOC only
+};
+
+// The human-readable line for a record, without the trailing newline
+void format_record(const LogRecord &rec, std::string &out);
+
+bool is_failure(LogKind kind) noexcept;
+
+/*
+ * EventLog
+ *
+ * Where simulation events go.
+ *
+ * - Text: filtered by level, formatted into a buffer, written in chunks
+ *   (failures go to the error stream, after flushing the text)
+ * - Binary: every record, varint encoded, through a buffered writer;
+ *   memsim_decode turns it back into the text form
+ */
+class EventLog {
+public:
+    EventLog(std::ostream &text, std::ostream &errors, LogLevel level);
+    ~EventLog();
+
+    EventLog(const EventLog &) = delete;
+    EventLog &operator=(const EventLog &) = delete;
+
+    // Binary copy of every record from now on; false if it cannot be opened
+    bool open_binary(const std::string &path);
+
+    LogLevel level() const noexcept;
+    void record(const LogRecord &rec);
+
+    // Push buffered text (and binary) out; call before writing to the
+    // text stream directly
+    void flush();
+
+private:
+    std::ostream &text_;
+    std::ostream &errors_;
+    LogLevel level_;
+
+    std::string text_buf_;
+    std::string line_;
+
+    std::ofstream bin_;
+    std::string bin_buf_;
+    uint64_t last_time_;
+
+    bool wants_text(LogKind kind) const noexcept;
+    void encode(const LogRecord &rec);
+};
+
+/*
+ * EventLogReader
+ *
+ * Reads records back from a binary event log.
+ */
+class EventLogReader {
+public:
+    // Throws std::runtime_error if the stream is not an event log
+    explicit EventLogReader(std::istream &in);
+
+    // false at a clean end of file; throws on a truncated record
+    bool next(LogRecord &rec);
+
+private:
+    std::istream &in_;
+    uint64_t last_time_;
+
+    bool read_varint(uint64_t &v, bool at_record_start);
+};
+
+} // namespace sim
+
+#endif // SIM_EVENTLOG_H
@@ -0,0 +1,63 @@
+#ifndef SIM_HISTOGRAM_H
+#define SIM_HISTOGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sim {
+
+class SnapshotWriter;
+class SnapshotReader;
+
+/*
+ * LatencyHistogram
+ *
+ * Log-bucketed (HDR style) histogram of cycle counts.
+ *
+ * - Values below 2^precision_bits are counted exactly
+ * - Above that, every power of two is split into 2^(precision_bits-1)
+ *   buckets, so a reported value is within 2^-(precision_bits-1) of
+ *   the true one
+ * - Memory is fixed at construction, whatever the number of samples
+ * - Histograms with the same precision can be merged (runs, threads)
+ */
+class LatencyHistogram {
+public:
+    explicit LatencyHistogram(unsigned precision_bits = 7);
+
+    void record(uint64_t value, uint64_t count = 1);
+    void merge(const LatencyHistogram &other);
+    void reset();
+
+    uint64_t count() const noexcept;
+    uint64_t min() const noexcept;
+    uint64_t max() const noexcept;
+    double mean() const noexcept;
+
+    // Value at quantile p in [0, 1]: the sample of rank floor(p * (n - 1)),
+    // reported as the top of its bucket (clamped to max). O(buckets).
+    uint64_t percentile(double p) const;
+
+    unsigned precision_bits() const noexcept;
+    size_t num_buckets() const noexcept;
+
+    // load() throws on a precision mismatch
+    void save(SnapshotWriter &w) const;
+    void load(SnapshotReader &r);
+
+private:
+    unsigned sub_bits_;
+    std::vector<uint64_t> counts_;
+    uint64_t total_;
+    uint64_t min_;
+    uint64_t max_;
+    long double sum_;
+
+    size_t bucket_of(uint64_t value) const noexcept;
+    uint64_t bucket_high(size_t idx) const noexcept;
+};
+
+} // namespace sim
+
+#endif // SIM_HISTOGRAM_H
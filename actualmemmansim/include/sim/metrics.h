@@ -4,13 +4,91 @@
 #include <cstdint>
 #include <vector>
 
+#include "sim/histogram.h"
+
 namespace sim {
 
+class SnapshotWriter;
+class SnapshotReader;
+
+// Where a page fault landed, for per-process attribution
+enum FaultRegion {
+    REGION_HEAP,
+    REGION_MMAP,
+    REGION_OTHER,     // outside every VMA (stack, data, ...)
+    NUM_REGIONS
+};
+
+// Where a faulted page's contents come from
+enum PageinSource {
+    PAGEIN_ZERO,          // never swapped out (first touch, released, unmapped)
+    PAGEIN_ZSWAP,         // the compressed pool
+    PAGEIN_SWAP,          // the swap device
+    PAGEIN_SWAP_CACHE,    // swapped out, still in the swap cache
+    NUM_PAGEIN_SOURCES
+};
+
+// Counters of one process, in a dense slot
+struct ProcessMetrics {
+    uint32_t pid = 0;
+    bool live = true;
+
+    // Heap state at the last heap operation (kept after exit)
+    uint64_t total_heap = 0;
+    uint64_t allocated_bytes = 0;
+    uint64_t free_bytes = 0;
+    uint64_t largest_free_block = 0;
+    uint64_t internal_frag_bytes = 0;
+
+    uint64_t tlb_hits = 0;
+    uint64_t tlb_misses = 0;
+    uint64_t page_faults = 0;
+    uint64_t faults_by_region[NUM_REGIONS] = {};
+    uint64_t evictions = 0;          // this process's pages evicted
+
+    // Resident-set control (frame-policy ws/pff)
+    uint64_t trimmed = 0;            // pages dropped from the working set
+    uint64_t suspensions = 0;        // swapped out by load control
+    uint64_t swapped_out = 0;        // pages those took
+    uint64_t resumes = 0;
+
+    // Access stream: trace accesses, served in arrival order
+    uint64_t stream_accesses = 0;
+    uint64_t stall_cycles = 0;       // queued behind the CPU or earlier accesses
+    uint64_t service_cycles = 0;     // started to done, fault wait included
+    uint64_t first_arrival = 0;
+    uint64_t finish = 0;             // last access done
+
+    // Resident set in pages; a change is pending until the next
+    // update_resident() gives it a time
+    uint64_t rss = 0;
+    uint64_t rss_pending = 0;
+    bool rss_dirty = false;
+    uint64_t peak_rss = 0;
+    uint64_t rss_first = 0;          // first page came in
+    uint64_t rss_since = 0;
+    uint64_t rss_area = 0;           // pages * cycles
+
+    double external_fragmentation() const noexcept;
+    double tlb_hit_rate() const noexcept;
+
+    // Time-weighted mean from the first page to exit (or now): the
+    // steady-state resident set
+    double steady_rss(uint64_t now) const noexcept;
+
+    // Arrival to done over the uncontended service time, summed over
+    // the accesses (1.0 = none waited for the CPU or an earlier access)
+    double slowdown() const noexcept;
+};
+
 /*
  * Metrics
  *
  * Collects simulation statistics across subsystems.
  * Does NOT know about MMU, TLB, or Scheduler internals.
+ *
+ * Heap, TLB and fault counters live in one slot per process (slot ids
+ * are handed out at process start); the global getters sum the slots.
  */
 class Metrics {
 public:
@@ -18,13 +96,26 @@ public:
 
     void reset();
 
+    // ---------------- Per-process slots ----------------
+    // A restarted pid gets a fresh slot; the old one stays for reporting
+    uint32_t open_slot(uint32_t pid);
+    void close_slot(uint32_t slot);
+
+    size_t num_slots() const noexcept;
+    const ProcessMetrics& slot(uint32_t slot) const;
+
     // ---------------- Heap metrics ----------------
-    void update_heap(uint64_t total_heap,
+    void update_heap(uint32_t slot,
+                     uint64_t total_heap,
                      uint64_t allocated,
                      uint64_t free,
                      uint64_t largest_free,
                      uint64_t internal_frag);
 
+    // Summed over processes; largest_free is the max of any heap and
+    // external_frag is the share of free bytes outside each heap's
+    // largest free block
+
     uint64_t total_heap_size() const noexcept;
     uint64_t allocated_bytes() const noexcept;
     uint64_t free_bytes() const noexcept;
@@ -32,37 +123,219 @@ public:
     uint64_t internal_fragmentation() const noexcept;
     double external_fragmentation() const noexcept;
 
+    // ---------------- Realloc / calloc ----------------
+    void record_realloc(bool moved, uint64_t copy_bytes);
+    void record_calloc(uint64_t zeroed_pages, uint64_t zero_fill_pages);
+
+    uint64_t reallocs_in_place() const noexcept;
+    uint64_t realloc_moves() const noexcept;
+    uint64_t realloc_copy_bytes() const noexcept;
+    uint64_t callocs() const noexcept;
+    uint64_t calloc_zeroed_pages() const noexcept;
+    uint64_t calloc_zero_fill_pages() const noexcept;
+
+    // ---------------- Thread caches ----------------
+    void record_tcache(uint64_t hits, uint64_t misses,
+                       uint64_t central_ops, uint64_t cross_thread_frees);
+    void add_stranded_bytes(int64_t delta);
+
+    uint64_t tcache_hits() const noexcept;
+    uint64_t tcache_misses() const noexcept;
+    double tcache_hit_rate() const noexcept;
+    uint64_t central_ops() const noexcept;
+    uint64_t cross_thread_frees() const noexcept;
+    uint64_t stranded_bytes() const noexcept;
+    uint64_t peak_stranded_bytes() const noexcept;
+
     // ---------------- TLB metrics ----------------
-    void record_tlb_hit();
-    void record_tlb_miss();
+    void record_tlb_hit(uint32_t slot);
+    void record_tlb_miss(uint32_t slot);
 
     uint64_t tlb_hits() const noexcept;
     uint64_t tlb_misses() const noexcept;
     double tlb_hit_rate() const noexcept;
 
+    // ---------------- Page faults ----------------
+    void record_page_fault(uint32_t slot, FaultRegion region);
+    void record_eviction(uint32_t slot);
+
+    uint64_t page_faults() const noexcept;
+
+    // ---------------- Resident-set control ----------------
+    void record_trim(uint32_t slot, uint64_t pages);
+    void record_suspend(uint32_t slot, uint64_t pages);
+    void record_resume(uint32_t slot);
+
+    // Summed over processes
+    uint64_t trimmed_pages() const noexcept;
+    uint64_t suspensions() const noexcept;
+    uint64_t swapped_out_pages() const noexcept;
+    uint64_t resumes() const noexcept;
+
+    // ---------------- Access streams ----------------
+    // One access of slot's stream: arrived, started on the CPU, done
+    void record_stream_access(uint32_t slot, uint64_t arrival,
+                              uint64_t start, uint64_t done);
+
+    uint64_t stream_accesses() const noexcept;
+    uint64_t stall_cycles() const noexcept;
+    uint64_t service_cycles() const noexcept;
+
+    // First arrival to last access done, over every process
+    uint64_t stream_makespan() const noexcept;
+
+    // ---------------- TLB shootdowns ----------------
+    // One dropped translation that `ipis` other cores cached
+    void record_shootdown(uint64_t ipis, uint64_t stall_cycles);
+
+    uint64_t shootdowns() const noexcept;
+    uint64_t shootdown_ipis() const noexcept;
+    uint64_t shootdown_stall_cycles() const noexcept;
+
+    // ---------------- NUMA ----------------
+    // Access from a core on `node`, to a frame on that node or another
+    void record_numa_access(uint32_t node, bool local);
+    void record_numa_migration(bool done);
+
+    // Per accessing node; nodes never seen count zero
+    uint64_t numa_local(uint32_t node) const noexcept;
+    uint64_t numa_remote(uint32_t node) const noexcept;
+    uint64_t numa_migrations() const noexcept;
+    uint64_t numa_migrate_failed() const noexcept;
+
+    // ---------------- Page release / residency ----------------
+    void record_pages_released(uint64_t pages);
+    void record_lazy_reclaim();
+    void record_refault();
+    void update_resident(uint64_t frames, uint64_t now);
+
+    // slot now holds `pages`; timed by the next update_resident()
+    void record_process_resident(uint32_t slot, uint64_t pages);
+
+    uint64_t pages_released() const noexcept;
+    uint64_t lazy_reclaims() const noexcept;
+    uint64_t refaults() const noexcept;
+    uint64_t resident_frames() const noexcept;
+    uint64_t peak_resident_frames() const noexcept;
+
+    // Time-weighted mean over [0, now]: the steady-state resident set
+    double avg_resident_frames(uint64_t now) const noexcept;
+
+    // ---------------- Reclaim ----------------
+    // A page-in that evicted inline, stalling its process `stall` cycles
+    void record_direct_reclaim(uint64_t stall);
+    void record_kswapd_wakeup();
+    void record_kswapd_batch(uint64_t pages);
+    // Fault to completion of the faulting access
+    void record_fault_service(uint64_t cycles);
+
+    uint64_t direct_reclaims() const noexcept;
+    uint64_t direct_reclaim_stall() const noexcept;
+    uint64_t kswapd_wakeups() const noexcept;
+    uint64_t kswapd_batches() const noexcept;
+    uint64_t kswapd_pages() const noexcept;
+    double mean_fault_service() const noexcept;
+
+    // ---------------- Page-in tiers ----------------
+    void record_pagein_source(PageinSource source);
+    uint64_t pageins(PageinSource source) const noexcept;
+
+    // ---------------- Heap growth ----------------
+    void record_brk_grow(uint64_t count = 1);
+    void record_mmap(uint64_t bytes);
+    void record_munmap(uint64_t bytes);
+
+    uint64_t brk_grows() const noexcept;
+    uint64_t mmaps() const noexcept;
+    uint64_t munmaps() const noexcept;
+    uint64_t mmap_bytes() const noexcept;
+    uint64_t peak_mmap_bytes() const noexcept;
+
     // ---------------- Latency metrics ----------------
     void record_access_latency(uint64_t cycles);
 
+    // Folds another run's (or thread's) samples into this one
+    void merge_latency(const LatencyHistogram &other);
+
     uint64_t latency_p50() const;
     uint64_t latency_p90() const;
     uint64_t latency_p99() const;
+    const LatencyHistogram& latency() const noexcept;
+
+    // ---------------- Checkpoint ----------------
+    void save(SnapshotWriter &w) const;
+    void load(SnapshotReader &r);
 
 private:
-    // Heap
-    uint64_t total_heap_;
-    uint64_t allocated_bytes_;
-    uint64_t free_bytes_;
-    uint64_t largest_free_block_;
-    uint64_t internal_frag_bytes_;
+    // Per-process slots (heap, TLB, faults)
+    std::vector<ProcessMetrics> slots_;
+
+    // Realloc / calloc
+    uint64_t reallocs_in_place_;
+    uint64_t realloc_moves_;
+    uint64_t realloc_copy_bytes_;
+    uint64_t callocs_;
+    uint64_t calloc_zeroed_pages_;
+    uint64_t calloc_zero_fill_pages_;
 
-    // TLB
-    uint64_t tlb_hits_;
-    uint64_t tlb_misses_;
+    // Thread caches
+    uint64_t tcache_hits_;
+    uint64_t tcache_misses_;
+    uint64_t central_ops_;
+    uint64_t cross_thread_frees_;
+    uint64_t stranded_bytes_;
+    uint64_t peak_stranded_bytes_;
 
-    // Latency samples
-    std::vector<uint64_t> latencies_;
+    // TLB shootdowns
+    uint64_t shootdowns_;
+    uint64_t shootdown_ipis_;
+    uint64_t shootdown_stall_cycles_;
+
+    // NUMA
+    std::vector<uint64_t> numa_local_;
+    std::vector<uint64_t> numa_remote_;
+    uint64_t numa_migrations_;
+    uint64_t numa_migrate_failed_;
+
+    // Page release / residency
+    uint64_t pages_released_;
+    uint64_t lazy_reclaims_;
+    uint64_t refaults_;
+    uint64_t resident_frames_;
+    uint64_t peak_resident_frames_;
+    uint64_t resident_since_;
+    uint64_t resident_area_;      // frames * cycles
+    std::vector<uint32_t> rss_dirty_;   // slots with a pending change
+
+    // Reclaim
+    uint64_t direct_reclaims_;
+    uint64_t direct_reclaim_stall_;
+    uint64_t kswapd_wakeups_;
+    uint64_t kswapd_batches_;
+    uint64_t kswapd_pages_;
+    uint64_t fault_services_;
+    uint64_t fault_service_cycles_;
+
+    // Page-in tiers, by PageinSource
+    uint64_t pageins_zero_;
+    uint64_t pageins_zswap_;
+    uint64_t pageins_swap_;
+    uint64_t pageins_swap_cache_;
+
+    // Heap growth
+    uint64_t brk_grows_;
+    uint64_t mmaps_;
+    uint64_t munmaps_;
+    uint64_t mmap_bytes_;
+    uint64_t peak_mmap_bytes_;
+
+    // Latency samples, bucketed
+    LatencyHistogram latency_;
 
     uint64_t percentile(double p) const;
+
+    // Every plain counter above, in checkpoint order
+    static const std::vector<uint64_t Metrics::*> &counter_fields();
 };
 
 } // namespace sim
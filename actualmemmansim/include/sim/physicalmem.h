@@ -2,17 +2,25 @@
 #define SIM_PHYSICAL_MEMORY_H
 
 #include <cstdint>
+#include <functional>
 #include <vector>
 #include <optional>
 
 namespace sim {
 
+class SnapshotWriter;
+class SnapshotReader;
+
 // Frame metadata
 struct Frame {
     bool occupied = false;
     uint32_t pid = 0;
     uint64_t vpn = 0;
     uint64_t last_used = 0;
+    bool lazy_free = false;   // MADV_FREE'd: reclaim before any LRU victim
+    uint32_t hint_node = NO_NODE;  // node of the last NUMA hinting fault
+
+    static constexpr uint32_t NO_NODE = UINT32_MAX;
 };
 
 // Result of a frame allocation request
@@ -21,17 +29,48 @@ struct FrameAllocResult {
     bool evicted;
     uint32_t evicted_pid;
     uint64_t evicted_vpn;
+    bool evicted_lazy;        // victim was a lazily freed page
 };
 
+/*
+ * PhysicalMemory
+ *
+ * Frames split into NUMA nodes of contiguous frame ids, as evenly as
+ * the count allows (one node unless asked otherwise).
+ */
 class PhysicalMemory {
 public:
-    explicit PhysicalMemory(size_t num_frames);
+    explicit PhysicalMemory(size_t num_frames, size_t nodes = 1);
 
     size_t num_frames() const noexcept;
+    size_t used_frames() const noexcept;
+
+    size_t nodes() const noexcept;
+    uint32_t node_of(int frame_id) const;
+    size_t node_frames(uint32_t node) const;
+    size_t used_frames(uint32_t node) const;
+
+    // Allocate a frame for (pid, vpn) at time 'now': a free frame from
+    // the first node of `order` that has one, else evict from order[0]
+    // (lazily freed pages first, then LRU). Empty order: any node.
+    FrameAllocResult allocate(uint32_t pid, uint64_t vpn, uint64_t now,
+                              const std::vector<uint32_t> &order = {});
+
+    // Evict frame_id's page and give the frame to (pid, vpn): local
+    // replacement, where the caller picks the victim
+    FrameAllocResult replace(int frame_id, uint32_t pid, uint64_t vpn, uint64_t now);
 
-    // Allocate a frame for (pid, vpn) at time 'now'.
-    // May evict an existing frame using LRU.
-    FrameAllocResult allocate(uint32_t pid, uint64_t vpn, uint64_t now);
+    // Move a frame's page to a free frame on `node` (never evicts);
+    // the new frame id, or nothing if the node is full
+    std::optional<int> migrate(int frame_id, uint32_t node);
+
+    void set_hint_node(int frame_id, uint32_t node);
+
+    // The frame allocate() would evict (lazily freed first, then LRU),
+    // among those of `node` (NO_NODE: all) that `eligible` accepts;
+    // -1 if none
+    int find_victim(const std::function<bool(const Frame &)> &eligible,
+                    uint32_t node = Frame::NO_NODE) const;
 
     // Mark a frame as accessed (for LRU updates)
     void touch(int frame_id, uint64_t now);
@@ -39,13 +78,28 @@ public:
     // Free a frame explicitly
     void free(int frame_id);
 
+    // MADV_FREE-style hint: frame may be reclaimed first, contents discarded.
+    // Any later access to the page cancels the hint.
+    void mark_lazy_free(int frame_id);
+    void clear_lazy_free(int frame_id);
+
     const Frame& frame(int frame_id) const;
 
+    // load() throws if the checkpoint has a different number of frames
+    void save(SnapshotWriter &w) const;
+    void load(SnapshotReader &r);
+
 private:
-    int find_free_frame() const;
-    int find_lru_frame() const;
+    // Within [begin, end) of frame ids
+    int find_free_frame(size_t begin, size_t end) const;
+    int find_lru_frame(size_t begin, size_t end) const;
+    int find_lazy_frame(size_t begin, size_t end) const;
 
     std::vector<Frame> frames_;
+    std::vector<size_t> node_start_;     // first frame of each node, then the end
+    std::vector<size_t> node_used_;
+    size_t used_frames_;
+    size_t lazy_frames_;
 };
 
 } // namespace sim
@@ -2,19 +2,74 @@
 #define SIM_PROCESS_H
 
 #include <cstdint>
+#include <map>
 #include <unordered_map>
 #include <optional>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "sim/allocator.h"
+#include "sim/threadcache.h"
 
 namespace sim {
 
+class SnapshotWriter;
+class SnapshotReader;
+
 // ---------------- Page Table ----------------
 
 struct PageTableEntry {
     bool valid = false;
     int frame_id = -1;
+    bool released = false;   // dropped by a heap page release, next fault is a re-fault
+    uint64_t last_ref = 0;   // process virtual time of the last reference
+};
+
+// ---------------- Address space ----------------
+
+enum class VmaKind {
+    HEAP,   // brk heap, managed by HeapAllocator
+    MMAP    // one anonymous mapping per large allocation
+};
+
+struct VMA {
+    uint64_t start;
+    uint64_t end;     // exclusive
+    VmaKind kind;
+};
+
+// Heap layout knobs, applied at PROC_START
+struct HeapLayout {
+    uint64_t brk_grow_step = 0;               // 0 = fixed heap, else min brk extension
+    uint64_t mmap_threshold = 0;              // 0 = off, else requests >= this are mmapped
+    uint64_t mmap_base = 0x7f0000000000ull;   // mmap area grows down from here
+    uint64_t tcache_batch = 0;                // 0 = off, else per-thread cache refill/flush batch
+};
+
+// Running heap counters of one process (monotonic except the byte gauges)
+struct HeapCounters {
+    uint64_t brk_grows = 0;
+    uint64_t mmap_bytes = 0;          // currently mapped by large allocations
+    uint64_t tcache_hits = 0;
+    uint64_t tcache_misses = 0;
+    uint64_t central_ops = 0;         // trips to the shared heap (lock acquisitions)
+    uint64_t cross_thread_frees = 0;
+    uint64_t stranded_bytes = 0;      // held in thread caches right now
+};
+
+// What a heap free gave back, in virtual addresses
+struct HeapFreeResult {
+    uint64_t start;
+    uint64_t end;
+    bool unmapped;    // true: a whole mapping went away (munmap)
+};
+
+// Outcome of a heap realloc
+struct HeapReallocResult {
+    std::optional<uint64_t> addr;   // nullopt: failed, old block untouched
+    bool moved = false;             // caller copies, then frees the old block
+    uint64_t copy_bytes = 0;
 };
 
 // ---------------- Process State ----------------
@@ -24,29 +79,52 @@ enum class ProcessState {
     READY,
     RUNNING,
     BLOCKED,
-    TERMINATED
+    TERMINATED,
+    SLEEPING,       // nothing queued to run
+    SUSPENDED       // swapped out by load control
 };
 
 // ---------------- Process ----------------
 
 class Process {
 public:
-    Process(uint32_t pid, uint64_t heap_base, uint64_t heap_size);
+    Process(uint32_t pid, uint64_t heap_base, uint64_t heap_size,
+            uint64_t page_size = 4096, const HeapLayout &layout = HeapLayout{});
 
     uint32_t pid() const noexcept;
 
+    // Metrics slot of this process (set by the MMU at registration)
+    uint32_t metrics_slot() const noexcept;
+    void set_metrics_slot(uint32_t slot) noexcept;
+
+    // Core it last touched memory from (set by the MMU on access)
+    uint32_t core() const noexcept;
+    void set_core(uint32_t core) noexcept;
+
     // -------- State management --------
     ProcessState state() const noexcept;
     void set_state(ProcessState s);
 
     // -------- Page table operations --------
     bool has_mapping(uint64_t vpn) const;
+    // Evicted with its contents kept: the next fault reads it back
+    bool is_swapped(uint64_t vpn) const;
     PageTableEntry get_pte(uint64_t vpn) const;
 
     void map_page(uint64_t vpn, int frame_id);
     void unmap_page(uint64_t vpn);
+    void release_page(uint64_t vpn);
+    void drop_page(uint64_t vpn);      // forget the PTE entirely (munmap)
     void clear_page_table();
 
+    // Pages in [first_vpn, end_vpn) that may hold old data, i.e. anything
+    // except never-touched or released pages (those read back as zero)
+    std::vector<uint64_t> dirty_pages_in(uint64_t first_vpn, uint64_t end_vpn) const;
+
+    // Valid (vpn, frame_id) mappings with first_vpn <= vpn < end_vpn
+    std::vector<std::pair<uint64_t, int>> mappings_in(uint64_t first_vpn,
+                                                      uint64_t end_vpn) const;
+
     // -------- Blocking info --------
     void block_on_page(uint64_t vpn);
     void clear_block();
@@ -54,15 +132,62 @@ public:
     bool is_blocked() const noexcept;
     std::optional<uint64_t> blocked_vpn() const noexcept;
 
+    // -------- Threads --------
+    // Thread 0 exists from the start. Exiting a thread flushes its cache.
+    void start_thread(uint32_t tid);
+    void exit_thread(uint32_t tid, std::vector<HeapFreeResult> &freed);
+    size_t num_threads() const noexcept;
+
     // -------- Heap interface --------
-    std::optional<uint64_t> heap_alloc(uint64_t size);
-    void heap_free(uint64_t addr);
+    // Small requests go through the calling thread's cache (if enabled),
+    // then the brk heap (grown on demand if the layout allows it);
+    // requests >= mmap_threshold get their own VMA.
+    std::optional<uint64_t> heap_alloc(uint64_t size, uint32_t tid = 0);
+
+    // Appends every range that went back to the central heap or was unmapped
+    void heap_free(uint64_t addr, uint32_t tid, std::vector<HeapFreeResult> &freed);
+
+    // Grow or shrink in place when possible, else allocate a new block.
+    // On a move the old block is left allocated for the caller to free.
+    HeapReallocResult heap_realloc(uint64_t addr, uint64_t size, uint32_t tid = 0);
+
+    bool is_mmapped(uint64_t addr) const;
+
+    // VMA containing addr, or nullptr
+    const VMA* vma_at(uint64_t addr) const;
 
     // -------- Heap metrics --------
     const HeapAllocator& heap() const noexcept;
+    const std::map<uint64_t, VMA>& vmas() const noexcept;
+    const HeapCounters& heap_counters() const noexcept;
+
+    // -------- Residency --------
+    uint64_t resident_pages() const noexcept;
+
+    // -------- References (resident-set policies) --------
+    // Virtual time counts the process's own references; map_page()
+    // stamps the page with the current one
+    void reference(uint64_t vpn);
+    uint64_t virtual_time() const noexcept;
+
+    // Resident (vpn, frame_id) pages last referenced before `vt`, by vpn
+    std::vector<std::pair<uint64_t, int>> pages_idle_since(uint64_t vt) const;
+
+    // Resident page with the oldest reference (ties: lowest vpn)
+    std::optional<std::pair<uint64_t, int>> lru_page() const;
+
+    // Virtual time of the last page fault (pff)
+    uint64_t last_fault() const noexcept;
+    void set_last_fault(uint64_t vt) noexcept;
+
+    // -------- Checkpoint --------
+    void save(SnapshotWriter &w) const;
+    static Process load(SnapshotReader &r);
 
 private:
     uint32_t pid_;
+    uint32_t metrics_slot_;
+    uint32_t core_;
     ProcessState state_;
 
     // Page table: VPN → PTE
@@ -73,6 +198,28 @@ private:
 
     // Heap allocator (owned by process)
     std::unique_ptr<HeapAllocator> heap_;
+
+    // Address space: VMAs keyed by start address
+    uint64_t page_size_;
+    HeapLayout layout_;
+    std::map<uint64_t, VMA> vmas_;
+    HeapCounters counters_;
+
+    // Threads and their caches
+    std::unordered_map<uint32_t, ThreadCache> threads_;
+    std::vector<uint64_t> flush_scratch_;
+
+    // Residency
+    uint64_t resident_pages_;
+    uint64_t vtime_;
+    uint64_t last_fault_;
+
+    uint64_t page_align(uint64_t n) const noexcept;
+    bool grow_heap(uint64_t need);
+    std::optional<uint64_t> mmap_alloc(uint64_t size);
+    std::optional<uint64_t> central_alloc(uint64_t size);
+    void central_free(uint64_t addr, std::vector<HeapFreeResult> &freed);
+    ThreadCache &thread(uint32_t tid);
 };
 
 } // namespace sim
@@ -0,0 +1,89 @@
+#ifndef SIM_PROFILE_H
+#define SIM_PROFILE_H
+
+#include <cstdint>
+#include <ostream>
+
+namespace sim {
+
+/*
+ * Profiler
+ *
+ * Host-side self-profiling of the simulator (not of the simulated machine).
+ *
+ * - Zones are timed with SIM_PROFILE_SCOPE; the macro is empty unless the
+ *   build defines MEMSIM_PROFILE, and a no-op branch until enable()
+ * - Ticks come from rdtsc on x86 (calibrated against steady_clock at
+ *   report time), steady_clock nanoseconds elsewhere
+ * - Optional hardware counters via Linux perf_event_open, whole run only
+ *
+ * Process-wide state: there is one simulator per process.
+ */
+class Profiler {
+public:
+    enum Zone {
+        PARSE,          // trace file → EventQueue
+        EVENT_LOOP,     // everything from first pop to empty queue
+        QUEUE,          //   EventQueue pop
+        MMU_ACCESS,     //   MMU::access
+        PAGEIN,         //   MMU::complete_pagein
+        FRAME_ALLOC,    //     PhysicalMemory::allocate
+        HEAP,           //   MMU heap operations
+        NUM_ZONES
+    };
+
+    static void enable(bool hw_counters);
+    static bool enabled() noexcept { return enabled_; }
+
+    static uint64_t ticks() noexcept;
+    static void add(Zone zone, uint64_t ticks) noexcept;
+
+    // For zones that do not fit a C++ scope (one open span per zone)
+    static void begin(Zone zone) noexcept;
+    static void end(Zone zone) noexcept;
+    static void set_events(uint64_t events) noexcept;
+
+    // Breakdown table; stops the hardware counters
+    static void report(std::ostream &os);
+
+private:
+    static bool enabled_;
+};
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Profiler::Zone zone) noexcept
+        : zone_(zone), active_(Profiler::enabled()),
+          start_(active_ ? Profiler::ticks() : 0) {}
+
+    ~ScopedTimer() {
+        if (active_)
+            Profiler::add(zone_, Profiler::ticks() - start_);
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    Profiler::Zone zone_;
+    bool active_;
+    uint64_t start_;
+};
+
+} // namespace sim
+
+#define SIM_PROFILE_CONCAT2(a, b) a##b
+#define SIM_PROFILE_CONCAT(a, b) SIM_PROFILE_CONCAT2(a, b)
+
+#ifdef MEMSIM_PROFILE
+#define SIM_PROFILE_SCOPE(zone) \
+    ::sim::ScopedTimer SIM_PROFILE_CONCAT(sim_profile_scope_, __LINE__)(::sim::Profiler::zone)
+#define SIM_PROFILE_BEGIN(zone) ::sim::Profiler::begin(::sim::Profiler::zone)
+#define SIM_PROFILE_END(zone) ::sim::Profiler::end(::sim::Profiler::zone)
+#else
+#define SIM_PROFILE_SCOPE(zone) ((void)0)
+#define SIM_PROFILE_BEGIN(zone) ((void)0)
+#define SIM_PROFILE_END(zone) ((void)0)
+#endif
+
+#endif // SIM_PROFILE_H
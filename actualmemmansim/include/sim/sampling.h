@@ -0,0 +1,94 @@
+#ifndef SIM_SAMPLING_H
+#define SIM_SAMPLING_H
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "sim/metrics.h"
+
+namespace sim {
+
+struct SampleConfig {
+    uint64_t period = 0;   // 0 = off, else events per sampling unit
+    uint64_t window = 0;   // measured events at the end of each unit
+    uint64_t warmup = 0;   // detailed, unmeasured events before the window
+
+    // Throws std::invalid_argument
+    void validate() const;
+};
+
+/*
+ * Sampler
+ *
+ * Systematic sampling (SMARTS style) of a run.
+ *
+ * - The event stream is cut into units of `period` events. Each unit is
+ *   fast-forwarded functionally, then run in detail for `warmup` events
+ *   and measured in detail for the last `window` events
+ * - Fast-forward keeps the TLB, page tables and frames warm and records
+ *   neither metrics nor log lines; its accesses take their latency and
+ *   its faults block until the page-in completes, as in detail
+ * - Each window yields access, fault, TLB hit and latency counts. Rates
+ *   are ratios over all windows; totals scale the count per access
+ *   served (counted in both modes) to every access the run served. An
+ *   access is counted when served, not when its ACCESS event arrives:
+ *   with queued streams the two fall in different windows. Both get a
+ *   95% confidence interval from the spread between windows
+ *
+ * Only reads Metrics, never changes it.
+ */
+class Sampler {
+public:
+    Sampler(const SampleConfig &cfg, const Metrics &metrics);
+
+    // Call before handling each event; true if it runs in detail
+    bool before_event();
+
+    // Every access served, in either mode
+    void count_access() noexcept;
+
+    // Closes a window cut short by the end of the run
+    void finish();
+
+    size_t windows() const noexcept;
+
+    // "Sampled estimate" block for the end-of-run summary
+    void report(std::ostream &os) const;
+
+private:
+    // Counters over one window (or their values at its start)
+    struct Window {
+        double served = 0.0;       // in either mode
+        double accesses = 0.0;     // executed in detail, with a latency sample
+        double faults = 0.0;
+        double tlb_hits = 0.0;
+        double latency = 0.0;      // summed cycles
+    };
+
+    // Ratio over all windows and its confidence half-width
+    struct Estimate {
+        double value = 0.0;
+        double half = 0.0;
+    };
+
+    SampleConfig cfg_;
+    const Metrics &metrics_;
+
+    uint64_t events_;
+    uint64_t detailed_events_;
+    uint64_t measured_events_;
+    uint64_t served_;
+
+    bool measuring_;
+    Window start_;
+    std::vector<Window> windows_;
+
+    Window counters() const;
+    void close_window();
+    Estimate ratio(double Window::*num, double Window::*den) const;
+};
+
+} // namespace sim
+
+#endif // SIM_SAMPLING_H
@@ -5,39 +5,165 @@
 #include <deque>
 #include <unordered_map>
 #include <optional>
+#include <utility>
+#include <vector>
 
+#include "sim/config.h"
 #include "sim/process.h"
 
 namespace sim {
 
+class SnapshotWriter;
+class SnapshotReader;
+
+// Where one process's time went, in cycles
+struct SchedStats {
+    uint64_t cpu = 0;            // running (switch cost excluded)
+    uint64_t wait = 0;           // ready, waiting for the CPU
+    uint64_t blocked = 0;        // waiting for page-ins
+    uint64_t idle = 0;           // nothing queued to run
+    uint64_t suspended = 0;      // swapped out by load control
+    uint64_t switches = 0;       // put on the CPU after another process
+    uint64_t preemptions = 0;    // time slice ran out
+    uint64_t migrations = 0;     // pulled to another core
+};
+
+// A process put on a core by schedule_next()
+struct Dispatch {
+    uint32_t pid = 0;
+    uint32_t core = 0;
+    bool switched = false;       // another process ran last: switch cost paid
+    uint64_t slice_end = 0;      // 0 = runs until it blocks (fifo)
+    uint64_t generation = 0;     // names this slice for its TIMER
+};
+
+/*
+ * Scheduler
+ *
+ * SimConfig::cores CPUs, each with its own run queue. A new process goes
+ * to the core with the fewest processes and stays there; a core with
+ * nothing to run pulls the newest waiting process off the busiest
+ * core (one that is running something). Policies (SimConfig::sched),
+ * per core:
+ *
+ * - fifo: a process runs until it blocks
+ * - rr:   a process runs for one quantum, then goes to the back
+ * - cfs:  the ready process with the least virtual runtime runs, for
+ *         quantum / runnable (at least quantum / 8); woken processes
+ *         get at most half a quantum of credit
+ *
+ * Only processes with queued work compete: a process sleeps from its
+ * start and whenever its work runs out, until work_arrived().
+ *
+ * Preemption is driven from outside: the caller arms a TIMER at the
+ * dispatch's slice_end and calls preempt() when it fires. A switch to
+ * another process starts its CPU time ctx_switch_latency cycles late.
+ */
 class Scheduler {
 public:
-    Scheduler();
+    explicit Scheduler(const SimConfig &cfg);
+
+    // Register a new process with scheduler (sleeping: no work yet)
+    void add_process(uint32_t pid, uint64_t now);
 
-    // Register a new process with scheduler
-    void add_process(uint32_t pid);
+    // A sleeping process got work and becomes ready; no-op otherwise
+    void work_arrived(uint32_t pid, uint64_t now);
+
+    // The process running on core ran out of work at `now`
+    void sleep_current(uint32_t core, uint64_t now);
 
     // Mark process as terminated and remove from scheduling
-    void terminate_process(uint32_t pid);
+    void terminate_process(uint32_t pid, uint64_t now);
+
+    // Block the process running on core
+    void block_current(uint32_t core, uint64_t now);
+
+    // Wake a blocked process (e.g., PAGEIN_COMPLETE); without work left
+    // it goes to sleep instead of the ready queue
+    void wake_process(uint32_t pid, uint64_t now, bool has_work = true);
+
+    // Load control: take a READY or SLEEPING process off the run queue
+    // until resume(); without work left it comes back sleeping
+    void suspend(uint32_t pid, uint64_t now);
+    void resume(uint32_t pid, uint64_t now, bool has_work);
+
+    ProcessState state(uint32_t pid) const;
+
+    // Pick next process to run on core (if needed)
+    std::optional<uint32_t> schedule_next(uint32_t core, uint64_t now);
 
-    // Block the currently running process
-    void block_current();
+    // The dispatch made by core's last schedule_next(), once
+    std::optional<Dispatch> take_dispatch(uint32_t core);
 
-    // Wake a blocked process (e.g., PAGEIN_COMPLETE)
-    void wake_process(uint32_t pid);
+    // TIMER: ends pid's slice if it is still running it (generation 0
+    // matches any slice). False if there was nothing to preempt.
+    bool preempt(uint32_t pid, uint64_t generation, uint64_t now);
 
-    // Pick next process to run (if needed)
-    std::optional<uint32_t> schedule_next();
+    // Process running on core (if any)
+    std::optional<uint32_t> current(uint32_t core) const;
 
-    // Current running process (if any)
-    std::optional<uint32_t> current() const noexcept;
+    // Something for core to run: its own or one it could pull
+    bool has_runnable(uint32_t core) const;
 
-    bool has_runnable() const noexcept;
+    // Core pid is queued on or running on
+    uint32_t core_of(uint32_t pid) const;
+
+    size_t cores() const noexcept;
+
+    uint64_t switches() const noexcept;
+    uint64_t switch_cycles() const noexcept;
+    uint64_t preemptions() const noexcept;
+    uint64_t migrations() const noexcept;
+
+    // Every process seen, in pid order; the running one is charged up to now
+    std::vector<std::pair<uint32_t, SchedStats>> stats(uint64_t now) const;
+
+    void save(SnapshotWriter &w) const;
+    void load(SnapshotReader &r);
 
 private:
-    std::deque<uint32_t> ready_queue_;
-    std::unordered_map<uint32_t, ProcessState> states_;
-    std::optional<uint32_t> current_;
+    struct Entry {
+        ProcessState state = ProcessState::READY;
+        uint32_t core = 0;
+        uint64_t since = 0;          // last state change (running: after switch cost)
+        uint64_t vruntime = 0;
+        uint64_t generation = 0;     // of the slice it is running
+        SchedStats stats;
+    };
+
+    struct Core {
+        std::deque<uint32_t> ready_queue;
+        std::optional<uint32_t> current;
+        std::optional<uint32_t> last;    // last process that ran here
+        std::optional<Dispatch> dispatch;
+        uint64_t min_vruntime = 0;
+    };
+
+    SchedPolicy policy_;
+    uint64_t quantum_;
+    uint64_t switch_latency_;
+
+    std::vector<Core> cores_;
+    std::unordered_map<uint32_t, Entry> procs_;
+
+    uint64_t generation_;
+    uint64_t switches_;
+    uint64_t switch_cycles_;
+    uint64_t preemptions_;
+    uint64_t migrations_;
+
+    // Charge now - since to the bucket of the entry's state
+    static void charge(Entry &e, uint64_t now);
+
+    // Into its core's ready queue, with CFS sleeper credit
+    void make_ready(uint32_t pid, Entry &e);
+
+    // Takes the next process off core's ready queue, per policy
+    std::optional<uint32_t> pick(uint32_t core);
+
+    // Moves the newest waiting process of the busiest core to `core`
+    bool pull(uint32_t core);
+    uint64_t slice(uint32_t core) const noexcept;
 };
 
 } // namespace sim
@@ -0,0 +1,168 @@
+#ifndef SIM_SIMULATOR_H
+#define SIM_SIMULATOR_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "sim/clock.h"
+#include "sim/config.h"
+#include "sim/event.h"
+#include "sim/eventlog.h"
+#include "sim/MMU.h"
+#include "sim/metrics.h"
+#include "sim/physicalmem.h"
+#include "sim/sampling.h"
+#include "sim/scheduler.h"
+#include "sim/snapshot.h"
+#include "sim/timeseries.h"
+#include "sim/workload.h"
+
+namespace sim {
+
+/*
+ * Simulator
+ *
+ * One simulated machine running one trace.
+ *
+ * - Reads trace events straight from a shared, read-only Trace
+ * - Events it generates itself (page-ins, copies, ...) go to a private
+ *   queue, merged with the trace in EventCompare order
+ * - Owns everything else (memory, MMU, scheduler, metrics), so several
+ *   simulators can run on different threads over the same Trace
+ *
+ * Each process's ACCESS events queue up on its own stream and run, in
+ * order, only while the scheduler has it on a core: a hit keeps the
+ * core busy for its latency, a fault blocks the process (and its later
+ * accesses) until the page-in. PROC_EXIT waits for the stream to drain.
+ * TLB shootdowns stall the cores they hit.
+ *
+ * Load control (frame-policy ws or pff): a fault that finds memory full
+ * after trimming swaps out the ready or sleeping process with the
+ * largest resident set. Suspended processes come back, oldest first,
+ * once as many frames are free as they held, and page back in on demand.
+ *
+ * With watermarks set, a page-in that leaves fewer than watermark-low
+ * free frames wakes kswapd: KSWAPD events reclaim kswapd-batch pages at
+ * a time, each pass reclaim-latency per page apart, until
+ * watermark-high frames are free. A page-in that still has to evict
+ * (direct reclaim) keeps its process blocked reclaim-latency longer,
+ * until its RECLAIM_DONE.
+ *
+ * A fault's page-in takes its tier's latency (see MMU). Compressing the
+ * pages a page-in evicted into the zswap pool blocks the faulting
+ * process too; kswapd's next pass waits for what it compressed.
+ */
+class Simulator {
+public:
+    Simulator(const SimConfig &cfg, const Trace &trace, EventLog &log);
+
+    Simulator(const Simulator &) = delete;
+    Simulator &operator=(const Simulator &) = delete;
+
+    // Periodic snapshots; call before run()
+    void enable_timeseries(std::ostream &out, const TimeSeriesConfig &ts_cfg);
+
+    // Sampled run: functional fast-forward between detailed windows
+    // (see sampling.h); call before run()
+    void enable_sampling(const SampleConfig &sample_cfg);
+
+    // nullptr unless sampling is enabled
+    const Sampler *sampler() const noexcept;
+
+    // Write a checkpoint during run(); call before run()
+    void set_checkpoint(const CheckpointConfig &ckpt);
+
+    // True if the run ended before the checkpoint point was reached
+    bool checkpoint_pending() const noexcept;
+
+    // Full state between two events. restore() replaces this simulator's
+    // state with a checkpoint taken over the same trace with the same
+    // page size, frames and TLB size; latencies and policies stay as
+    // configured here. Both throw std::runtime_error.
+    void save(std::ostream &out) const;
+    void restore(const std::string &snapshot);
+
+    // Runs until both the trace and the private queue are drained
+    void run();
+
+    uint64_t now() const noexcept;
+    const Scheduler& scheduler() const noexcept;
+    const MMU& mmu() const noexcept;
+    const PhysicalMemory& memory() const noexcept;
+    uint64_t events_handled() const noexcept;
+    const Metrics& metrics() const noexcept;
+    const SimConfig& config() const noexcept;
+
+private:
+    SimConfig cfg_;
+    const Trace &trace_;
+    size_t next_trace_;
+    EventLog &log_;
+
+    Clock clock_;
+    EventQueue queue_;
+    PhysicalMemory pmem_;
+    Metrics metrics_;
+    MMU mmu_;
+    Scheduler sched_;
+    std::unique_ptr<TimeSeries> ts_;
+    std::unique_ptr<Sampler> sampler_;
+    bool fast_forward_;
+    CheckpointConfig ckpt_;
+    bool ckpt_pending_;
+
+    uint64_t events_handled_;
+
+    // A trace access waiting on (or, at the head while its page comes
+    // in, running for) its process. An entry with free_addr set is not an
+    // access: REALLOC's old block, freed once the copy ahead of it is done
+    struct PendingAccess {
+        uint64_t vaddr = 0;
+        uint64_t arrival = 0;
+        uint64_t start = 0;
+        uint32_t tid = 0;
+        uint64_t free_addr = 0;
+    };
+    std::unordered_map<uint32_t, std::deque<PendingAccess>> streams_;
+    std::map<uint32_t, uint32_t> exit_pending_;  // pid → tid of a PROC_EXIT
+                                                 // waiting for the stream
+    std::vector<uint64_t> cpu_busy_until_;   // per core
+    std::vector<uint64_t> cpu_wakeup_;       // time of core's queued RUN, 0 = none
+    // A process load control swapped out; accounted unless it happened
+    // in sampled fast-forward, and its resume is counted likewise
+    struct Suspension {
+        uint32_t pid = 0;
+        uint64_t pages = 0;
+        bool accounted = true;
+    };
+    std::deque<Suspension> suspended_;
+    bool kswapd_pending_;                    // a KSWAPD pass is queued
+
+    uint64_t trace_fingerprint() const;
+    bool checkpoint_due(const Event &next) const;
+    void write_checkpoint();
+
+    void handle(const Event &ev);
+    void log(const LogRecord &rec);
+    void on_dispatch(const std::optional<Dispatch> &d);
+    void run_cpus();
+    void charge_shootdowns();
+    void run_cpu(uint32_t core);
+    void finish_access(uint32_t pid, uint64_t done);
+    void exit_process(uint32_t pid, uint32_t tid);
+    bool free_block(uint32_t pid, uint32_t tid, uint64_t addr);
+    void load_control(uint32_t pid);
+    void finish_pagein(uint32_t pid, uint64_t vpn, const Event &ev);
+    void wake_kswapd();
+    void resume_suspended();
+};
+
+} // namespace sim
+
+#endif // SIM_SIMULATOR_H
@@ -0,0 +1,70 @@
+#ifndef SIM_SNAPSHOT_H
+#define SIM_SNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+
+namespace sim {
+
+/*
+ * Snapshot
+ *
+ * Binary checkpoint of a whole Simulator (see Simulator::save/restore).
+ *
+ * Layout: magic "MSIMCKP1", then each component's save() output in a
+ * fixed order, read back by its load() in the same order. Integers are
+ * LEB128 varints, strings are length-prefixed, and every component opens
+ * with a short section name so a mismatch fails loudly instead of
+ * restoring garbage.
+ *
+ * The writer and reader work on an in-memory buffer: a checkpoint is
+ * built and parsed in one go, and many runs can restore from one buffer.
+ */
+class SnapshotWriter {
+public:
+    SnapshotWriter();
+
+    void section(const char *name);
+    void u64(uint64_t v);
+    void i64(int64_t v);            // zigzag
+    void boolean(bool b);
+    void str(const std::string &s);
+    void real(long double v);       // exact for up to 64 mantissa bits
+
+    const std::string &data() const noexcept;
+
+private:
+    std::string buf_;
+};
+
+class SnapshotReader {
+public:
+    // Throws std::runtime_error if data does not start with the magic
+    explicit SnapshotReader(const std::string &data);
+
+    // Throws std::runtime_error unless the next section is `name`
+    void section(const char *name);
+    uint64_t u64();
+    int64_t i64();
+    bool boolean();
+    std::string str();
+    long double real();
+
+    bool at_end() const noexcept;
+
+private:
+    const std::string &data_;
+    size_t pos_;
+};
+
+// Checkpoint trigger for a serial run
+struct CheckpointConfig {
+    std::string path;           // empty = no checkpoint
+    uint64_t at_cycles = 0;     // before the first event at or after this time
+    uint64_t at_events = 0;     // or once this many events were handled
+    bool stop = false;          // end the run right after writing it
+};
+
+} // namespace sim
+
+#endif // SIM_SNAPSHOT_H
@@ -0,0 +1,115 @@
+#ifndef SIM_SWAP_H
+#define SIM_SWAP_H
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "sim/config.h"
+
+namespace sim {
+
+class SnapshotWriter;
+class SnapshotReader;
+
+/*
+ * SwapArea
+ *
+ * Layout of the swap device: swap-slots page slots in clusters of
+ * swap-cluster. A page written out takes the next slot of the current
+ * cluster; a used-up cluster is followed by the next entirely free one,
+ * so pages evicted together sit next to each other. Once no cluster is
+ * free, slots are taken wherever one is (fragmented). With every slot
+ * used, a page goes to swap without a slot and gets none of the below.
+ *
+ * The swap cache holds the last swap-cache pages written out (still
+ * under writeback) or read ahead, oldest dropped first. A fault on a
+ * cached page needs no I/O. A fault that misses reads its slot plus the
+ * used ones among the next swap-readahead - 1 (at most swap-cache) into
+ * the cache with the same I/O.
+ *
+ * Swap-cache pages are not charged to any frame.
+ */
+class SwapArea {
+public:
+    explicit SwapArea(const SimConfig &cfg);
+
+    bool enabled() const noexcept;
+
+    // A page goes out to swap; false if no slot is free
+    bool write(uint32_t pid, uint64_t vpn);
+
+    // Fault on a swapped-out page: true if the swap cache has it, else
+    // its window is read ahead
+    bool read(uint32_t pid, uint64_t vpn);
+
+    // The page is back in a frame: its slot and cache entry go
+    void release(uint32_t pid, uint64_t vpn);
+
+    // The page's contents are gone (DONTNEED, munmap, exit)
+    void drop_range(uint32_t pid, uint64_t first_vpn, uint64_t end_vpn);
+    void drop_process(uint32_t pid);
+
+    uint64_t slots() const noexcept;
+    uint64_t used() const noexcept;
+    uint64_t peak_used() const noexcept;
+    uint64_t writes() const noexcept;
+    uint64_t new_clusters() const noexcept;      // writes that opened a cluster
+    uint64_t fragmented() const noexcept;        // writes outside any free cluster
+    uint64_t full() const noexcept;              // writes with no slot left
+    uint64_t reads() const noexcept;             // faults that needed I/O
+    uint64_t cache_hits() const noexcept;
+    uint64_t readahead_pages() const noexcept;
+    uint64_t readahead_hits() const noexcept;    // cache hits on read-ahead pages
+
+    // Slots, cache and counters; geometry must match
+    void save(SnapshotWriter &w) const;
+    void load(SnapshotReader &r);
+
+private:
+    static constexpr uint64_t NONE = UINT64_MAX;
+
+    struct Slot {
+        bool used = false;
+        uint32_t pid = 0;
+        uint64_t vpn = 0;
+        uint64_t cached = 0;         // swap-cache stamp, 0 = not cached
+        bool readahead = false;      // cached by readahead
+    };
+
+    uint64_t cluster_;
+    uint64_t readahead_;
+    uint64_t cache_size_;
+
+    std::vector<Slot> slots_;
+    std::vector<uint64_t> cluster_used_;             // used slots per cluster
+    std::map<std::pair<uint32_t, uint64_t>, uint64_t> slot_of_;
+    std::map<uint64_t, uint64_t> cache_;             // stamp → slot, oldest first
+    uint64_t cursor_;            // next slot of the current cluster
+    uint64_t next_cluster_;      // where the free-cluster search starts
+    uint64_t scan_;              // where the fragmented search starts
+    uint64_t stamp_;
+
+    uint64_t used_;
+    uint64_t peak_used_;
+    uint64_t writes_;
+    uint64_t new_clusters_;
+    uint64_t fragmented_;
+    uint64_t full_;
+    uint64_t reads_;
+    uint64_t cache_hits_;
+    uint64_t readahead_pages_;
+    uint64_t readahead_hits_;
+
+    // A free slot per the clustering rules, or NONE
+    uint64_t allocate();
+
+    void cache(uint64_t slot, bool readahead);
+    void uncache(uint64_t slot);
+    void free_slot(uint64_t slot);
+};
+
+} // namespace sim
+
+#endif // SIM_SWAP_H
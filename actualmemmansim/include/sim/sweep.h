@@ -0,0 +1,47 @@
+#ifndef SIM_SWEEP_H
+#define SIM_SWEEP_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "sim/config.h"
+#include "sim/workload.h"
+
+namespace sim {
+
+// One swept SimConfig key and the values it takes
+struct SweepAxis {
+    std::string key;
+    std::vector<std::string> values;
+};
+
+// One run of a sweep: the axis values and the config they produce
+struct SweepPoint {
+    std::vector<std::string> values;   // one per axis
+    SimConfig cfg;
+};
+
+// "key=v1,v2,..." → axis. Throws std::invalid_argument.
+SweepAxis parse_sweep_axis(const std::string &spec);
+
+// Cartesian product of the axes on top of base, last axis varying
+// fastest. Throws std::invalid_argument for an unknown key or a value
+// that does not make a valid config.
+std::vector<SweepPoint> expand_sweep(const SimConfig &base,
+                                     const std::vector<SweepAxis> &axes);
+
+/*
+ * Runs every point as an independent Simulator over the one shared trace,
+ * `jobs` at a time on a thread pool, and writes a CSV table (one row per
+ * point, in point order) once all of them finish. A point that throws
+ * gets its message in the error column; the others still run.
+ * With a non-empty snapshot every point starts from that checkpoint.
+ */
+void run_sweep(const Trace &trace, const std::vector<SweepAxis> &axes,
+               const std::vector<SweepPoint> &points, unsigned jobs,
+               std::ostream &out, const std::string &snapshot = std::string());
+
+} // namespace sim
+
+#endif // SIM_SWEEP_H
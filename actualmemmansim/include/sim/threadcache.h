@@ -0,0 +1,68 @@
+#ifndef SIM_THREADCACHE_H
+#define SIM_THREADCACHE_H
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace sim {
+
+class SnapshotWriter;
+class SnapshotReader;
+
+/*
+ * ThreadCache
+ *
+ * Per-thread front end to a process heap (tcmalloc style).
+ *
+ * - Holds freed small blocks in per-size-class lists
+ * - Is refilled from / flushed to the central heap in batches
+ * - Does NOT talk to HeapAllocator; Process moves blocks in and out
+ *
+ * Blocks in a cache are allocated as far as the central heap can tell,
+ * so their bytes are "stranded" until the cache flushes them.
+ */
+class ThreadCache {
+public:
+    static constexpr int NO_CLASS = -1;
+
+    // Smallest class that fits `size`, or NO_CLASS if too big to cache
+    static int size_class(uint64_t size) noexcept;
+
+    // Class whose size is exactly `size`, or NO_CLASS
+    static int exact_class(uint64_t size) noexcept;
+
+    static uint64_t class_size(int cls) noexcept;
+
+    explicit ThreadCache(size_t batch);
+
+    size_t batch() const noexcept;
+
+    // Most recently freed block of the class (hot end)
+    std::optional<uint64_t> pop(int cls);
+    void push(int cls, uint64_t addr);
+    size_t count(int cls) const;
+
+    // Cache holds more than this per class → flush a batch
+    size_t limit() const noexcept;
+
+    // Move the n least recently freed blocks of a class into out
+    void take_cold(int cls, size_t n, std::vector<uint64_t> &out);
+
+    // Move every cached block into out
+    void take_all(std::vector<uint64_t> &out);
+
+    uint64_t cached_bytes() const noexcept;
+
+    void save(SnapshotWriter &w) const;
+    void load(SnapshotReader &r);
+
+private:
+    size_t batch_;
+    std::vector<std::vector<uint64_t>> lists_;   // per class, back = hot
+    uint64_t cached_bytes_;
+};
+
+} // namespace sim
+
+#endif // SIM_THREADCACHE_H
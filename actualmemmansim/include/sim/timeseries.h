@@ -0,0 +1,75 @@
+#ifndef SIM_TIMESERIES_H
+#define SIM_TIMESERIES_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sim/MMU.h"
+#include "sim/metrics.h"
+#include "sim/physicalmem.h"
+
+namespace sim {
+
+struct TimeSeriesConfig {
+    uint64_t every_cycles = 0;   // 0 = off, else one row per N simulated cycles
+    uint64_t every_events = 0;   // 0 = off, else one row per N handled events
+};
+
+/*
+ * TimeSeries
+ *
+ * Periodic snapshots of the simulation, one CSV row each.
+ *
+ * - Rates (faults, TLB hits) cover the interval since the previous row
+ * - Gauges (frames, heap, RSS) are the value at the sample point
+ * - Only reads Metrics / MMU / PhysicalMemory, never changes them
+ *
+ * Columns: time,events,accesses,faults,fault_rate,tlb_hit_rate,
+ *          free_frames,resident_frames,heap_allocated,heap_free,
+ *          external_frag,rss
+ * where rss is "pid:pages" pairs separated by spaces.
+ */
+class TimeSeries {
+public:
+    TimeSeries(std::ostream &out, const TimeSeriesConfig &cfg,
+               const Metrics &metrics, const MMU &mmu,
+               const PhysicalMemory &pmem);
+
+    bool enabled() const noexcept;
+
+    // Call before handling each event, with the event's time and the
+    // clock (time of the previous event). Emits the row owed for the
+    // previous N events, then one per cycle boundary up to `time`.
+    void before_event(uint64_t time, uint64_t now);
+
+    // Last row, if anything happened since the previous one
+    void finish(uint64_t now);
+
+private:
+    std::ostream &out_;
+    TimeSeriesConfig cfg_;
+    const Metrics &metrics_;
+    const MMU &mmu_;
+    const PhysicalMemory &pmem_;
+
+    uint64_t next_time_;
+    uint64_t events_;
+
+    // Counter values at the previous row
+    uint64_t last_events_;
+    uint64_t last_tlb_hits_;
+    uint64_t last_tlb_misses_;
+    uint64_t last_faults_;
+
+    std::vector<std::pair<uint32_t, uint64_t>> rss_scratch_;
+    std::string line_;
+
+    void sample(uint64_t time);
+};
+
+} // namespace sim
+
+#endif // SIM_TIMESERIES_H
@@ -2,10 +2,17 @@
 #define SIM_WORKLOAD_H
 
 #include <string>
+#include <vector>
 #include "sim/event.h"
 
 namespace sim {
 
+// A parsed trace in event order (EventCompare), seq numbers 1..N.
+// Read-only once built, so any number of simulators can share it.
+struct Trace {
+    std::vector<Event> events;
+};
+
 class Workload {
 public:
     explicit Workload(const std::string &path);
@@ -14,6 +21,9 @@ public:
     // Returns true on success, false on error.
     bool parse_into(EventQueue &q);
 
+    // Same, into a sorted Trace
+    bool parse_into(Trace &trace);
+
 private:
     std::string path_;
 };
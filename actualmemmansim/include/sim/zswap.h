@@ -0,0 +1,85 @@
+#ifndef SIM_ZSWAP_H
+#define SIM_ZSWAP_H
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "sim/config.h"
+
+namespace sim {
+
+class SnapshotWriter;
+class SnapshotReader;
+
+/*
+ * ZswapPool
+ *
+ * A compressed-memory tier between the frames and swap, zram style: an
+ * evicted page is stored compressed if it fits in zswap-pool bytes,
+ * else it spills to swap. There is no writeback from the pool; its
+ * pages leave it when faulted back in or when their memory goes away.
+ *
+ * A page's compression ratio comes from the zswap-ratio distribution,
+ * picked by a hash of (pid, vpn), so it is the same every time that page
+ * is stored. Ratio 1 means incompressible: such pages go to swap.
+ */
+class ZswapPool {
+public:
+    explicit ZswapPool(const SimConfig &cfg);
+
+    bool enabled() const noexcept;
+
+    // Store an evicted page; false if it goes to swap instead
+    bool store(uint32_t pid, uint64_t vpn);
+
+    // Take the page out for a page-in; false if it is not in the pool
+    bool load(uint32_t pid, uint64_t vpn);
+
+    bool contains(uint32_t pid, uint64_t vpn) const;
+
+    // The page's contents are gone (DONTNEED, munmap, exit)
+    void drop_range(uint32_t pid, uint64_t first_vpn, uint64_t end_vpn);
+    void drop_process(uint32_t pid);
+
+    uint64_t capacity() const noexcept;
+    uint64_t pages() const noexcept;
+    uint64_t bytes() const noexcept;       // compressed
+    uint64_t peak_pages() const noexcept;
+    uint64_t peak_bytes() const noexcept;  // at peak_pages
+    uint64_t stores() const noexcept;
+    uint64_t loads() const noexcept;
+    uint64_t rejects_full() const noexcept;
+    uint64_t rejects_incompressible() const noexcept;
+
+    // Uncompressed / compressed bytes over every store
+    double mean_ratio() const noexcept;
+
+    // Pool contents and counters; the ratio distribution stays as configured
+    void save(SnapshotWriter &w) const;
+    void load(SnapshotReader &r);
+
+private:
+    uint64_t capacity_;
+    uint64_t page_size_;
+    std::vector<ZswapRatio> ratios_;
+    uint64_t total_weight_;
+
+    std::map<std::pair<uint32_t, uint64_t>, uint64_t> entries_;   // → compressed bytes
+    uint64_t bytes_;
+    uint64_t peak_pages_;
+    uint64_t peak_bytes_;
+    uint64_t stores_;
+    uint64_t loads_;
+    uint64_t rejects_full_;
+    uint64_t rejects_incompressible_;
+    uint64_t stored_bytes_;         // compressed, summed over stores
+
+    // Compressed size of (pid, vpn); page_size_ if incompressible
+    uint64_t compressed_size(uint32_t pid, uint64_t vpn) const;
+};
+
+} // namespace sim
+
+#endif // SIM_ZSWAP_H
@@ -1,38 +1,134 @@
 #include "sim/MMU.h"
 #include "sim/physicalmem.h"
+#include "sim/profile.h"
+#include "sim/snapshot.h"
 
+#include <algorithm>
+#include <functional>
 #include <stdexcept>
 
 namespace sim {
 
 MMU::MMU(PhysicalMemory &pmem,
-         uint64_t page_size,
-         size_t tlb_size,
+         const SimConfig &cfg,
          Metrics &metrics)
     : pmem_(pmem),
-      page_size_(page_size),
-      tlb_(tlb_size),
-      metrics_(metrics) {}
+      page_size_(cfg.page_size),
+      tlb_hit_latency_(cfg.tlb_hit_latency),
+      pt_hit_latency_(cfg.pt_hit_latency),
+      fault_latency_(cfg.fault_latency),
+      shootdown_latency_(cfg.shootdown_latency),
+      pagein_latency_(cfg.pagein_latency),
+      stall_(cfg.cores, 0),
+      received_(cfg.cores, 0),
+      last_latency_(0),
+      last_pagein_(0),
+      numa_(cfg.numa_nodes > 1),
+      numa_policy_(cfg.numa_policy),
+      bind_order_{ cfg.numa_bind },
+      numa_sample_(cfg.numa_sample),
+      numa_migrate_latency_(cfg.numa_migrate_latency),
+      numa_accesses_(0),
+      caches_(cfg),
+      pt_base_(cfg.num_frames * cfg.page_size),
+      pte_bits_(0),
+      walk_levels_(cfg.walk_levels),
+      next_table_(0),
+      metrics_(metrics),
+      release_policy_(cfg.heap_release),
+      frame_policy_(cfg.frame_policy),
+      frame_budget_(cfg.frame_budget),
+      ws_window_(cfg.ws_window),
+      pff_interval_(cfg.pff_interval),
+      cgroups_(cfg.cgroups),
+      zswap_(cfg),
+      compress_latency_(cfg.zswap_compress_latency),
+      decompress_latency_(cfg.zswap_decompress_latency),
+      compress_owed_(0),
+      swap_(cfg),
+      swap_cache_latency_(cfg.swap_cache_latency),
+      layout_(cfg.heap) {
+    // 8-byte PTEs, one page per table
+    for (uint64_t n = cfg.page_size / 8; n > 1; n >>= 1)
+        ++pte_bits_;
+
+    for (size_t c = 0; c < cfg.cores; ++c) {
+        tlbs_.emplace_back(cfg.tlb_size);
+        core_node_.push_back(static_cast<uint32_t>(c * cfg.numa_nodes / cfg.cores));
+    }
+
+    // Fallback: nearest node first, ties to the lower id
+    size_t nodes = cfg.numa_nodes;
+    fallback_.resize(nodes);
+    remote_cost_.assign(nodes, std::vector<uint64_t>(nodes, 0));
+    for (uint32_t a = 0; a < nodes; ++a) {
+        for (uint32_t b = 0; b < nodes; ++b) {
+            fallback_[a].push_back(b);
+            remote_cost_[a][b] = (cfg.distance(a, b) - 10) * cfg.numa_latency / 10;
+        }
+        std::stable_sort(fallback_[a].begin(), fallback_[a].end(),
+                         [&](uint32_t x, uint32_t y) {
+                             return cfg.distance(a, x) < cfg.distance(a, y);
+                         });
+    }
+}
 
 // ---------------- Process management ----------------
 
 void MMU::register_process(uint32_t pid,
                            uint64_t heap_base,
-                           uint64_t heap_size) {
+                           uint64_t heap_size,
+                           const std::string &cgroup) {
     if (processes_.count(pid))
         throw std::runtime_error("MMU: process already registered");
+    cgroup_of_[pid] = cgroups_.find_or_create(cgroup);
 
-    processes_.emplace(pid, Process(pid, heap_base, heap_size));
+    auto it = processes_.emplace(pid, Process(pid, heap_base, heap_size,
+                                              page_size_, layout_)).first;
+    it->second.set_metrics_slot(metrics_.open_slot(pid));
 }
 
-void MMU::unregister_process(uint32_t pid) {
+void MMU::unregister_process(uint32_t pid, uint64_t now) {
     auto it = processes_.find(pid);
     if (it == processes_.end())
         return;
 
-    tlb_.flush_process(pid);
+    // Cached blocks die with the process
+    if (uint64_t stranded = it->second.heap_counters().stranded_bytes)
+        metrics_.add_stranded_bytes(-static_cast<int64_t>(stranded));
+
+    // Not running anywhere: no IPIs needed
+    for (auto &tlb : tlbs_)
+        tlb.flush_process(pid);
+    for (const auto &m : it->second.mappings_in(0, UINT64_MAX))
+        free_frame(m.second);
     it->second.clear_page_table();
+    note_rss(it->second);
+    zswap_.drop_process(pid);
+    swap_.drop_process(pid);
+    metrics_.close_slot(it->second.metrics_slot());
+    cgroup_of_.erase(pid);
+
+    // Its page-table pages go back for reuse, in address order
+    auto pt = page_tables_.find(pid);
+    if (pt != page_tables_.end()) {
+        size_t first = free_tables_.size();
+        for (const auto &t : pt->second)
+            free_tables_.push_back(t.second);
+        std::sort(free_tables_.begin() + first, free_tables_.end(), std::greater<uint64_t>());
+        page_tables_.erase(pt);
+    }
     processes_.erase(it);
+
+    metrics_.update_resident(pmem_.used_frames(), now);
+}
+
+void MMU::set_heap_layout(const HeapLayout &layout) noexcept {
+    layout_ = layout;
+}
+
+const std::unordered_map<uint32_t, Process>& MMU::processes() const noexcept {
+    return processes_;
 }
 
 Process &MMU::process(uint32_t pid) {
@@ -48,57 +144,757 @@ uint64_t MMU::vpn_from_vaddr(uint64_t vaddr) const noexcept {
     return vaddr / page_size_;
 }
 
+// ---------------- Cores ----------------
+
+void MMU::flush_tlb(uint32_t core) {
+    tlbs_.at(core).flush_all();
+}
+
+size_t MMU::cores() const noexcept {
+    return tlbs_.size();
+}
+
+const TLB &MMU::tlb(uint32_t core) const {
+    return tlbs_.at(core);
+}
+
+uint64_t MMU::take_shootdown_stall(uint32_t core) {
+    uint64_t cycles = stall_[core];
+    stall_[core] = 0;
+    return cycles;
+}
+
+uint64_t MMU::shootdowns_received(uint32_t core) const {
+    return received_.at(core);
+}
+
+uint32_t MMU::core_node(uint32_t core) const {
+    return core_node_.at(core);
+}
+
+const CacheHierarchy &MMU::caches() const noexcept {
+    return caches_;
+}
+
+void MMU::shootdown(uint32_t pid, uint64_t vpn, uint32_t initiator, bool account) {
+    uint64_t ipis = 0;
+    for (uint32_t c = 0; c < tlbs_.size(); ++c) {
+        if (!tlbs_[c].invalidate(pid, vpn) || c == initiator || !account)
+            continue;
+        ++ipis;
+        ++received_[c];
+        stall_[c] += shootdown_latency_;
+    }
+    if (ipis)
+        metrics_.record_shootdown(ipis, ipis * shootdown_latency_);
+}
+
 // ---------------- Memory access ----------------
 
-MMUAccessResult MMU::access(uint32_t pid, uint64_t vaddr) {
+MMUAccessResult MMU::access(uint32_t pid, uint64_t vaddr, uint32_t core) {
+    SIM_PROFILE_SCOPE(MMU_ACCESS);
     auto &proc = process(pid);
     uint64_t vpn = vpn_from_vaddr(vaddr);
+    TLB &tlb = tlbs_[core];
+    proc.set_core(core);
+    if (frame_policy_ != FramePolicy::GLOBAL)
+        proc.reference(vpn);
 
     // ---------- 1. TLB lookup ----------
-    if (auto frame = tlb_.lookup(pid, vpn)) {
-        metrics_.record_tlb_hit();
-        metrics_.record_access_latency(1);   // fast path
+    if (auto frame = tlb.lookup(pid, vpn)) {
+        if (release_policy_ == HeapReleasePolicy::LAZY_FREE)
+            pmem_.clear_lazy_free(*frame);
+        metrics_.record_tlb_hit(proc.metrics_slot());
+        bool memory = true;
+        last_latency_ = tlb_hit_latency_;                   // fast path
+        if (caches_.enabled())
+            last_latency_ += data_ref(core, *frame, vaddr, memory);
+        if (numa_)
+            last_latency_ += numa_access(pid, proc, vpn, *frame, core, memory);
+        metrics_.record_access_latency(last_latency_);
         return MMUAccessResult::HIT;
     }
 
-    metrics_.record_tlb_miss();
+    metrics_.record_tlb_miss(proc.metrics_slot());
 
     // ---------- 2. Page table ----------
     if (proc.has_mapping(vpn)) {
         auto pte = proc.get_pte(vpn);
-        tlb_.insert(pid, vpn, pte.frame_id);
-        metrics_.record_access_latency(5);   // page-table hit
-        return MMUAccessResult::HIT;
+        if (release_policy_ == HeapReleasePolicy::LAZY_FREE)
+            pmem_.clear_lazy_free(pte.frame_id);
+        tlb.insert(pid, vpn, pte.frame_id);
+        bool memory = true;
+        last_latency_ = pt_hit_latency_;                    // page-table hit
+        if (caches_.enabled())
+            last_latency_ = tlb_hit_latency_ + walk(pid, vpn, core, false) +
+                            data_ref(core, pte.frame_id, vaddr, memory);
+        if (numa_)
+            last_latency_ += numa_access(pid, proc, vpn, pte.frame_id, core, memory);
+        metrics_.record_access_latency(last_latency_);
+        return MMUAccessResult::PT_HIT;
     }
 
     // ---------- 3. Page fault ----------
-    metrics_.record_access_latency(100);     // page fault path
+    if (release_policy_ != HeapReleasePolicy::NONE && proc.get_pte(vpn).released)
+        metrics_.record_refault();
+    const VMA *vma = proc.vma_at(vaddr);
+    FaultRegion region = !vma ? REGION_OTHER
+                       : vma->kind == VmaKind::HEAP ? REGION_HEAP : REGION_MMAP;
+    metrics_.record_page_fault(proc.metrics_slot(), region);
+    metrics_.record_pagein_source(fault_source(pid, proc, vpn));
+    last_latency_ = fault_latency_;                     // page fault path
+    if (caches_.enabled())
+        last_latency_ += walk(pid, vpn, core, false);
+    metrics_.record_access_latency(last_latency_);
     return MMUAccessResult::PAGE_FAULT;
 }
 
-// ---------------- Page-in completion ----------------
+PageinSource MMU::fault_source(uint32_t pid, const Process &proc, uint64_t vpn) {
+    PageinSource source = PAGEIN_ZERO;
+    if (zswap_.contains(pid, vpn))
+        source = PAGEIN_ZSWAP;
+    else if (proc.is_swapped(vpn))
+        source = swap_.enabled() && swap_.read(pid, vpn) ? PAGEIN_SWAP_CACHE : PAGEIN_SWAP;
+    last_pagein_ = source == PAGEIN_ZSWAP      ? decompress_latency_
+                 : source == PAGEIN_SWAP_CACHE ? swap_cache_latency_
+                 : pagein_latency_;
+    return source;
+}
 
-void MMU::complete_pagein(uint32_t pid,
-                          uint64_t vpn,
-                          uint64_t now) {
+uint64_t MMU::last_access_latency() const noexcept {
+    return last_latency_;
+}
+
+uint64_t MMU::last_pagein_latency() const noexcept {
+    return last_pagein_;
+}
+
+// ---------------- Caches ----------------
+
+uint64_t MMU::data_ref(uint32_t core, int frame, uint64_t vaddr, bool &memory) {
+    uint64_t paddr = static_cast<uint64_t>(frame) * page_size_ + vaddr % page_size_;
+    return caches_.access(core, paddr, CacheRef::DATA, memory);
+}
+
+uint64_t MMU::walk(uint32_t pid, uint64_t vpn, uint32_t core, bool warm) {
+    auto &tables = page_tables_[pid];
+    uint64_t cycles = 0;
+    for (uint64_t level = walk_levels_; level-- > 0;) {
+        // The table at this level covers every vpn with the same prefix
+        unsigned shift = pte_bits_ * static_cast<unsigned>(level + 1);
+        uint64_t prefix = shift < 64 ? vpn >> shift : 0;
+        auto ins = tables.emplace(prefix * 8 + level, 0);
+        if (ins.second) {
+            if (free_tables_.empty()) {
+                ins.first->second = next_table_++;
+            } else {
+                ins.first->second = free_tables_.back();
+                free_tables_.pop_back();
+            }
+        }
+
+        uint64_t index = (vpn >> (pte_bits_ * level)) & ((uint64_t(1) << pte_bits_) - 1);
+        uint64_t paddr = pt_base_ + ins.first->second * page_size_ + index * 8;
+        if (warm) {
+            caches_.warm(core, paddr);
+        } else {
+            bool memory;
+            cycles += caches_.access(core, paddr, CacheRef::WALK, memory);
+        }
+    }
+    return cycles;
+}
+
+// ---------------- NUMA ----------------
+
+const std::vector<uint32_t> &MMU::placement(uint64_t vpn, uint32_t core) const {
+    switch (numa_policy_) {
+        case NumaPolicy::INTERLEAVE: return fallback_[vpn % fallback_.size()];
+        case NumaPolicy::BIND:       return bind_order_;
+        default:                     return fallback_[core_node_[core]];
+    }
+}
+
+uint64_t MMU::numa_access(uint32_t pid, Process &proc, uint64_t vpn, int frame,
+                          uint32_t core, bool memory) {
+    uint32_t node = core_node_[core];
+    uint32_t home = pmem_.node_of(frame);
+    metrics_.record_numa_access(node, node == home);
+    uint64_t extra = memory ? remote_cost_[node][home] : 0;
+
+    // Bound and interleaved pages stay where the policy put them
+    if (numa_sample_ == 0 || numa_policy_ != NumaPolicy::FIRST_TOUCH ||
+        ++numa_accesses_ % numa_sample_ != 0)
+        return extra;
+
+    // Hinting fault: migrate on the second one in a row from this node
+    if (home == node || pmem_.frame(frame).hint_node != node) {
+        pmem_.set_hint_node(frame, node);
+        return extra;
+    }
+    auto to = pmem_.migrate(frame, node);
+    metrics_.record_numa_migration(to.has_value());
+    if (!to)
+        return extra;
+
+    proc.map_page(vpn, *to);
+    shootdown(pid, vpn, core, true);
+    tlbs_[core].insert(pid, vpn, *to);
+    return numa_migrate_latency_;
+}
+
+// ---------------- Resident sets ----------------
+
+FrameAllocResult MMU::allocate_frame(uint32_t pid, Process &proc, uint64_t vpn,
+                                     uint64_t now, bool account) {
+    uint32_t group = cgroup_of(pid);
+    FrameAllocResult res = take_frame(pid, proc, group, vpn, now, account);
+    if (res.evicted)
+        cgroups_.uncharge(cgroup_of(res.evicted_pid));
+    cgroups_.charge(group);
+    return res;
+}
+
+FrameAllocResult MMU::take_frame(uint32_t pid, Process &proc, uint32_t group,
+                                 uint64_t vpn, uint64_t now, bool account) {
+    // Local replacement: over budget (local) or out of frames (ws/pff)
+    bool own = false;
+    if (frame_policy_ == FramePolicy::LOCAL) {
+        uint64_t budget = frame_budget_ ? frame_budget_
+                        : std::max<uint64_t>(1, pmem_.num_frames() / processes_.size());
+        own = proc.resident_pages() >= budget;
+    } else if (frame_policy_ != FramePolicy::GLOBAL) {
+        own = pmem_.used_frames() == pmem_.num_frames();
+    }
+    if (own) {
+        if (auto victim = proc.lru_page()) {
+            if (account)
+                cgroups_.record_fault(group, false);
+            return pmem_.replace(victim->second, pid, vpn, now);
+        }
+    }
+
+    static const std::vector<uint32_t> any_node;
+    const std::vector<uint32_t> &order = numa_ ? placement(vpn, proc.core()) : any_node;
+    auto over = cgroups_.limited() ? cgroups_.over_limit(group) : std::nullopt;
+    if (account)
+        cgroups_.record_fault(group, over.has_value());
+
+    // Reclaim inside the group over its max, or anywhere once memory is
+    // full; pages under memory.low only when nothing else is left
+    if (cgroups_.limited()) {
+        bool full = true;
+        for (uint32_t n = 0; n < pmem_.nodes() && full; ++n) {
+            if (order.empty() || std::find(order.begin(), order.end(), n) != order.end())
+                full = pmem_.used_frames(n) == pmem_.node_frames(n);
+        }
+        if (over || full) {
+            uint32_t scope = over ? *over : CgroupTree::ROOT;
+            uint32_t node = over || order.empty() ? Frame::NO_NODE : order[0];
+            bool breach = false;
+            int victim = reclaim_victim(scope, node, breach);
+            if (victim != -1) {
+                if (account)
+                    cgroups_.record_reclaim(over, cgroup_of(pmem_.frame(victim).pid), breach);
+                return pmem_.replace(victim, pid, vpn, now);
+            }
+        }
+    }
+
+    return pmem_.allocate(pid, vpn, now, order);
+}
+
+int MMU::reclaim_victim(uint32_t scope, uint32_t node, bool &breach) const {
+    breach = false;
+    if (!cgroups_.limited())
+        return pmem_.find_victim([](const Frame &) { return true; }, node);
+
+    int victim = pmem_.find_victim([&](const Frame &f) {
+        uint32_t g = cgroup_of(f.pid);
+        return cgroups_.in_subtree(g, scope) && !cgroups_.is_protected(g, scope);
+    }, node);
+    if (victim == -1) {
+        victim = pmem_.find_victim([&](const Frame &f) {
+            return cgroups_.in_subtree(cgroup_of(f.pid), scope);
+        }, node);
+        breach = true;
+    }
+    return victim;
+}
+
+uint64_t MMU::reclaim(uint64_t pages, uint64_t now, bool account) {
+    uint64_t done = 0;
+    for (; done < pages; ++done) {
+        bool breach;
+        int victim = reclaim_victim(CgroupTree::ROOT, Frame::NO_NODE, breach);
+        if (victim == -1)
+            break;
+
+        const Frame &f = pmem_.frame(victim);
+        uint32_t owner = f.pid;
+        uint64_t vpn = f.vpn;
+        bool lazy = f.lazy_free;
+        auto &proc = process(owner);
+        evict_page(owner, proc, vpn, lazy, account);
+        shootdown(owner, vpn, proc.core(), account);
+        if (account) {
+            metrics_.record_eviction(proc.metrics_slot());
+            if (lazy)
+                metrics_.record_lazy_reclaim();
+            cgroups_.record_reclaim(std::nullopt, cgroup_of(owner), breach);
+        }
+        free_frame(victim);
+    }
+
+    if (done)
+        metrics_.update_resident(pmem_.used_frames(), now);
+    return done;
+}
+
+void MMU::evict_page(uint32_t pid, Process &proc, uint64_t vpn, bool lazy, bool account) {
+    if (lazy) {
+        // Lazily freed page: contents dropped, no writeback
+        proc.release_page(vpn);
+        note_rss(proc);
+        return;
+    }
+    proc.unmap_page(vpn);
+    note_rss(proc);
+    if (zswap_.enabled() && zswap_.store(pid, vpn)) {
+        if (account)
+            compress_owed_ += compress_latency_;
+        return;
+    }
+    if (swap_.enabled())
+        swap_.write(pid, vpn);
+}
+
+void MMU::note_rss(const Process &proc) {
+    metrics_.record_process_resident(proc.metrics_slot(), proc.resident_pages());
+}
+
+uint64_t MMU::take_compress_cycles() {
+    uint64_t cycles = compress_owed_;
+    compress_owed_ = 0;
+    return cycles;
+}
+
+void MMU::free_frame(int frame_id) {
+    cgroups_.uncharge(cgroup_of(pmem_.frame(frame_id).pid));
+    pmem_.free(frame_id);
+}
+
+uint32_t MMU::cgroup_of(uint32_t pid) const {
+    auto it = cgroup_of_.find(pid);
+    return it == cgroup_of_.end() ? CgroupTree::ROOT : it->second;
+}
+
+const CgroupTree &MMU::cgroups() const noexcept {
+    return cgroups_;
+}
+
+const ZswapPool &MMU::zswap() const noexcept {
+    return zswap_;
+}
+
+const SwapArea &MMU::swap() const noexcept {
+    return swap_;
+}
+
+void MMU::drop_resident(uint32_t pid, Process &proc,
+                        const std::vector<std::pair<uint64_t, int>> &pages, bool account) {
+    for (const auto &p : pages) {
+        evict_page(pid, proc, p.first, pmem_.frame(p.second).lazy_free, account);
+        shootdown(pid, p.first, proc.core(), account);
+        free_frame(p.second);
+    }
+}
+
+uint64_t MMU::trim_resident_set(uint32_t pid, uint64_t now, bool account) {
+    auto &proc = process(pid);
+    uint64_t vt = proc.virtual_time();
+    uint64_t cutoff = 0;
+    if (frame_policy_ == FramePolicy::WS) {
+        cutoff = vt > ws_window_ ? vt - ws_window_ + 1 : 0;
+    } else if (frame_policy_ == FramePolicy::PFF) {
+        if (vt - proc.last_fault() > pff_interval_)
+            cutoff = proc.last_fault();
+        proc.set_last_fault(vt);
+    }
+    if (cutoff == 0)
+        return 0;
+
+    auto idle = proc.pages_idle_since(cutoff);
+    drop_resident(pid, proc, idle, account);
+    if (account && !idle.empty()) {
+        metrics_.record_trim(proc.metrics_slot(), idle.size());
+        metrics_.update_resident(pmem_.used_frames(), now);
+    }
+    return idle.size();
+}
+
+uint64_t MMU::swap_out(uint32_t pid, uint64_t now, bool account) {
     auto &proc = process(pid);
+    auto pages = proc.mappings_in(0, UINT64_MAX);
+    std::sort(pages.begin(), pages.end());
+    drop_resident(pid, proc, pages, account);
+    if (account) {
+        metrics_.record_suspend(proc.metrics_slot(), pages.size());
+        metrics_.update_resident(pmem_.used_frames(), now);
+    }
+    return pages.size();
+}
+
+// ---------------- Page-in completion ----------------
+
+// Give vpn a frame (evicting if needed), map it and fill the TLB of the
+// process's core
+FrameAllocResult MMU::page_in(uint32_t pid, Process &proc, uint64_t vpn,
+                              uint64_t now, bool account) {
+    // Out of the pool or its swap slot, wherever it was
+    zswap_.load(pid, vpn);
+    swap_.release(pid, vpn);
 
     // Allocate frame (may evict)
-    FrameAllocResult res = pmem_.allocate(pid, vpn, now);
+    FrameAllocResult res = allocate_frame(pid, proc, vpn, now, account);
 
     // If eviction happened, clean up old mapping
     if (res.evicted) {
         auto &old_proc = process(res.evicted_pid);
-        old_proc.unmap_page(res.evicted_vpn);
-        tlb_.invalidate(res.evicted_pid, res.evicted_vpn);
+        evict_page(res.evicted_pid, old_proc, res.evicted_vpn, res.evicted_lazy, account);
+        shootdown(res.evicted_pid, res.evicted_vpn, proc.core(), account);
     }
 
     // Map new page
     proc.map_page(vpn, res.frame_id);
+    note_rss(proc);
 
     // Fill TLB
-    tlb_.insert(pid, vpn, res.frame_id);
+    tlbs_[proc.core()].insert(pid, vpn, res.frame_id);
+    return res;
+}
+
+bool MMU::complete_pagein(uint32_t pid,
+                          uint64_t vpn,
+                          uint64_t now,
+                          uint32_t core,
+                          bool account) {
+    SIM_PROFILE_SCOPE(PAGEIN);
+    auto &proc = process(pid);
+    proc.set_core(core);
+
+    FrameAllocResult res = page_in(pid, proc, vpn, now, account);
+    if (!account)
+        return res.evicted;
+    if (res.evicted) {
+        metrics_.record_eviction(process(res.evicted_pid).metrics_slot());
+        if (res.evicted_lazy)
+            metrics_.record_lazy_reclaim();
+    }
+
+    metrics_.update_resident(pmem_.used_frames(), now);
+    return res.evicted;
+}
+
+// ---------------- Functional access ----------------
+
+bool MMU::warm_access(uint32_t pid, uint64_t vaddr, uint32_t core) {
+    SIM_PROFILE_SCOPE(MMU_ACCESS);
+    auto &proc = process(pid);
+    uint64_t vpn = vpn_from_vaddr(vaddr);
+    TLB &tlb = tlbs_[core];
+    proc.set_core(core);
+    if (frame_policy_ != FramePolicy::GLOBAL)
+        proc.reference(vpn);
+
+    int frame;
+    if (auto hit = tlb.lookup(pid, vpn)) {
+        frame = *hit;
+        last_latency_ = tlb_hit_latency_;
+    } else {
+        if (caches_.enabled())
+            walk(pid, vpn, core, true);
+        if (!proc.has_mapping(vpn)) {
+            fault_source(pid, proc, vpn);
+            return false;
+        }
+        frame = proc.get_pte(vpn).frame_id;
+        tlb.insert(pid, vpn, frame);
+        last_latency_ = caches_.enabled() ? tlb_hit_latency_ : pt_hit_latency_;
+    }
+
+    if (release_policy_ == HeapReleasePolicy::LAZY_FREE)
+        pmem_.clear_lazy_free(frame);
+    if (caches_.enabled())
+        caches_.warm(core, static_cast<uint64_t>(frame) * page_size_ + vaddr % page_size_);
+    return true;
+}
+
+// ---------------- Threads ----------------
+
+void MMU::thread_start(uint32_t pid, uint32_t tid) {
+    process(pid).start_thread(tid);
+}
+
+uint64_t MMU::thread_exit(uint32_t pid, uint32_t tid, uint64_t now) {
+    SIM_PROFILE_SCOPE(HEAP);
+    auto &proc = process(pid);
+    HeapCounters before = proc.heap_counters();
+
+    freed_scratch_.clear();
+    proc.exit_thread(tid, freed_scratch_);
+
+    account_heap(before, proc.heap_counters());
+    return release_freed(pid, now);
+}
+
+// ---------------- Heap operations ----------------
+
+// Forward what a heap call changed on the process side into Metrics
+void MMU::account_heap(const HeapCounters &before, const HeapCounters &after) {
+    if (after.brk_grows != before.brk_grows)
+        metrics_.record_brk_grow(after.brk_grows - before.brk_grows);
+    if (after.mmap_bytes > before.mmap_bytes)
+        metrics_.record_mmap(after.mmap_bytes - before.mmap_bytes);
+
+    metrics_.record_tcache(after.tcache_hits - before.tcache_hits,
+                           after.tcache_misses - before.tcache_misses,
+                           after.central_ops - before.central_ops,
+                           after.cross_thread_frees - before.cross_thread_frees);
+    if (after.stranded_bytes != before.stranded_bytes)
+        metrics_.add_stranded_bytes(static_cast<int64_t>(after.stranded_bytes) -
+                                    static_cast<int64_t>(before.stranded_bytes));
+}
+
+// Hand every range in freed_scratch_ back to the physical side
+uint64_t MMU::release_freed(uint32_t pid, uint64_t now) {
+    uint64_t pages = 0;
+    for (const auto &f : freed_scratch_) {
+        if (f.unmapped) {
+            metrics_.record_munmap(f.end - f.start);
+            pages += unmap_range(pid, f.start, f.end, now);
+        } else {
+            pages += release_heap_range(pid, f.start, f.end, now);
+        }
+    }
+    return pages;
+}
+
+std::optional<uint64_t> MMU::heap_alloc(uint32_t pid, uint64_t size, uint32_t tid) {
+    SIM_PROFILE_SCOPE(HEAP);
+    auto &proc = process(pid);
+    HeapCounters before = proc.heap_counters();
+
+    auto addr = proc.heap_alloc(size, tid);
+
+    account_heap(before, proc.heap_counters());
+    return addr;
+}
+
+uint64_t MMU::heap_free(uint32_t pid, uint64_t addr, uint64_t now, uint32_t tid) {
+    SIM_PROFILE_SCOPE(HEAP);
+    auto &proc = process(pid);
+    HeapCounters before = proc.heap_counters();
+
+    freed_scratch_.clear();
+    proc.heap_free(addr, tid, freed_scratch_);
+
+    account_heap(before, proc.heap_counters());
+    return release_freed(pid, now);
+}
+
+HeapReallocResult MMU::heap_realloc(uint32_t pid, uint64_t addr, uint64_t size,
+                                    uint32_t tid) {
+    SIM_PROFILE_SCOPE(HEAP);
+    auto &proc = process(pid);
+    HeapCounters before = proc.heap_counters();
+
+    auto res = proc.heap_realloc(addr, size, tid);
+
+    account_heap(before, proc.heap_counters());
+    if (res.addr)
+        metrics_.record_realloc(res.moved, res.copy_bytes);
+    return res;
+}
+
+CallocResult MMU::heap_calloc(uint32_t pid, uint64_t size, uint32_t tid) {
+    CallocResult res;
+    res.addr = heap_alloc(pid, size, tid);
+    if (!res.addr)
+        return res;
+
+    auto &proc = process(pid);
+    uint64_t first_vpn = vpn_from_vaddr(*res.addr);
+    uint64_t end_vpn = vpn_from_vaddr(*res.addr + size - 1) + 1;
+
+    // A fresh mapping is all zero pages already
+    if (!proc.is_mmapped(*res.addr)) {
+        SIM_PROFILE_SCOPE(HEAP);
+        res.zero_vpns = proc.dirty_pages_in(first_vpn, end_vpn);
+    }
+
+    metrics_.record_calloc(res.zero_vpns.size(),
+                           (end_vpn - first_vpn) - res.zero_vpns.size());
+    return res;
+}
+
+// ---------------- Heap page release ----------------
+
+void MMU::set_heap_release_policy(HeapReleasePolicy policy) noexcept {
+    release_policy_ = policy;
+}
+
+HeapReleasePolicy MMU::heap_release_policy() const noexcept {
+    return release_policy_;
 }
 
+uint64_t MMU::release_heap_range(uint32_t pid, uint64_t start, uint64_t end,
+                                uint64_t now) {
+    if (release_policy_ == HeapReleasePolicy::NONE)
+        return 0;
+
+    auto &proc = process(pid);
+
+    // Only pages lying entirely inside the free range
+    uint64_t first_vpn = (start + page_size_ - 1) / page_size_;
+    uint64_t end_vpn = end / page_size_;
+
+    if (release_policy_ == HeapReleasePolicy::DONTNEED) {
+        zswap_.drop_range(pid, first_vpn, end_vpn);
+        swap_.drop_range(pid, first_vpn, end_vpn);
+    }
+
+    uint64_t released = 0;
+    for (const auto &m : proc.mappings_in(first_vpn, end_vpn)) {
+        if (release_policy_ == HeapReleasePolicy::DONTNEED) {
+            proc.release_page(m.first);
+            shootdown(pid, m.first, proc.core(), true);
+            free_frame(m.second);
+        } else {
+            if (pmem_.frame(m.second).lazy_free)
+                continue;
+            pmem_.mark_lazy_free(m.second);
+        }
+        ++released;
+    }
+
+    if (released) {
+        note_rss(proc);
+        metrics_.record_pages_released(released);
+        metrics_.update_resident(pmem_.used_frames(), now);
+    }
+    return released;
+}
+
+uint64_t MMU::unmap_range(uint32_t pid, uint64_t start, uint64_t end,
+                          uint64_t now) {
+    auto &proc = process(pid);
+
+    uint64_t first_vpn = vpn_from_vaddr(start);
+    uint64_t end_vpn = vpn_from_vaddr(end + page_size_ - 1);
+    zswap_.drop_range(pid, first_vpn, end_vpn);
+    swap_.drop_range(pid, first_vpn, end_vpn);
+
+    uint64_t unmapped = 0;
+    for (const auto &m : proc.mappings_in(first_vpn, end_vpn)) {
+        proc.drop_page(m.first);
+        shootdown(pid, m.first, proc.core(), true);
+        free_frame(m.second);
+        ++unmapped;
+    }
+
+    if (unmapped) {
+        note_rss(proc);
+        metrics_.update_resident(pmem_.used_frames(), now);
+    }
+    return unmapped;
+}
+
+
+// ---------------- Checkpoint ----------------
+
+void MMU::save(SnapshotWriter &w) const {
+    w.section("mmu");
+    w.u64(tlbs_.size());
+    for (uint32_t c = 0; c < tlbs_.size(); ++c) {
+        tlbs_[c].save(w);
+        w.u64(stall_[c]);
+        w.u64(received_[c]);
+    }
+    w.u64(numa_accesses_);
+
+    caches_.save(w);
+    std::vector<uint32_t> pt_pids;
+    for (const auto &p : page_tables_)
+        pt_pids.push_back(p.first);
+    std::sort(pt_pids.begin(), pt_pids.end());
+    w.u64(pt_pids.size());
+    for (uint32_t pid : pt_pids) {
+        std::vector<std::pair<uint64_t, uint64_t>> tables(page_tables_.at(pid).begin(),
+                                                          page_tables_.at(pid).end());
+        std::sort(tables.begin(), tables.end());
+        w.u64(pid);
+        w.u64(tables.size());
+        for (const auto &t : tables) {
+            w.u64(t.first);
+            w.u64(t.second);
+        }
+    }
+    w.u64(free_tables_.size());
+    for (uint64_t t : free_tables_)
+        w.u64(t);
+    w.u64(next_table_);
+
+    std::vector<uint32_t> pids;
+    for (const auto &p : processes_)
+        pids.push_back(p.first);
+    std::sort(pids.begin(), pids.end());
+    w.u64(pids.size());
+    for (uint32_t pid : pids) {
+        processes_.at(pid).save(w);
+        w.u64(cgroup_of(pid));
+    }
+    cgroups_.save(w);
+    zswap_.save(w);
+    swap_.save(w);
+}
+
+void MMU::load(SnapshotReader &r) {
+    r.section("mmu");
+    if (r.u64() != tlbs_.size())
+        throw std::runtime_error("MMU: checkpoint has another number of cores");
+    for (uint32_t c = 0; c < tlbs_.size(); ++c) {
+        tlbs_[c].load(r);
+        stall_[c] = r.u64();
+        received_[c] = r.u64();
+    }
+    numa_accesses_ = r.u64();
+
+    caches_.load(r);
+    page_tables_.clear();
+    for (uint64_t n = r.u64(); n > 0; --n) {
+        auto &tables = page_tables_[static_cast<uint32_t>(r.u64())];
+        for (uint64_t k = r.u64(); k > 0; --k) {
+            uint64_t key = r.u64();
+            tables[key] = r.u64();
+        }
+    }
+    free_tables_.clear();
+    for (uint64_t n = r.u64(); n > 0; --n)
+        free_tables_.push_back(r.u64());
+    next_table_ = r.u64();
+
+    processes_.clear();
+    cgroup_of_.clear();
+    for (uint64_t n = r.u64(); n > 0; --n) {
+        Process p = Process::load(r);
+        uint32_t pid = p.pid();
+        processes_.emplace(pid, std::move(p));
+        cgroup_of_[pid] = static_cast<uint32_t>(r.u64());
+    }
+    cgroups_.load(r);
+    zswap_.load(r);
+    swap_.load(r);
+}
 
 } // namespace sim
@@ -1,6 +1,8 @@
 #include "sim/TLB.h"
+#include "sim/snapshot.h"
 #include <deque>
 #include <algorithm>
+#include <stdexcept>
 
 namespace sim {
 
@@ -56,14 +58,14 @@ public:
         );
     }
 
-    void invalidate(uint32_t pid, uint64_t vpn) {
-        entries.erase(
-            std::remove_if(entries.begin(), entries.end(),
+    bool invalidate(uint32_t pid, uint64_t vpn) {
+        auto end = std::remove_if(entries.begin(), entries.end(),
                 [pid, vpn](const TLBEntry &e) {
                     return e.pid == pid && e.vpn == vpn;
-                }),
-            entries.end()
-        );
+                });
+        bool found = end != entries.end();
+        entries.erase(end, entries.end());
+        return found;
     }
 
     void flush_all() {
@@ -99,8 +101,8 @@ void TLB::flush_process(uint32_t pid) {
     impl_->flush_process(pid);
 }
 
-void TLB::invalidate(uint32_t pid, uint64_t vpn) {
-    impl_->invalidate(pid, vpn);
+bool TLB::invalidate(uint32_t pid, uint64_t vpn) {
+    return impl_->invalidate(pid, vpn);
 }
 
 void TLB::flush_all() {
@@ -121,5 +123,39 @@ double TLB::hit_rate() const noexcept {
     return static_cast<double>(hits_) / static_cast<double>(total);
 }
 
+// ---------------- Checkpoint ----------------
+
+void TLB::save(SnapshotWriter &w) const {
+    w.section("tlb");
+    w.u64(impl_->entries.size());
+    for (const auto &e : impl_->entries) {
+        w.u64(e.pid);
+        w.u64(e.vpn);
+        w.u64(static_cast<uint64_t>(e.frame_id));
+        w.boolean(e.referenced);
+    }
+    w.u64(hits_);
+    w.u64(misses_);
+}
+
+void TLB::load(SnapshotReader &r) {
+    r.section("tlb");
+    size_t n = r.u64();
+    if (n > capacity_)
+        throw std::runtime_error("TLB: checkpoint holds more entries than the TLB");
+
+    impl_->entries.clear();
+    for (size_t i = 0; i < n; ++i) {
+        TLBEntry e;
+        e.pid = static_cast<uint32_t>(r.u64());
+        e.vpn = r.u64();
+        e.frame_id = static_cast<int>(r.u64());
+        e.referenced = r.boolean();
+        impl_->entries.push_back(e);
+    }
+    hits_ = impl_->hits = r.u64();
+    misses_ = impl_->misses = r.u64();
+}
+
 } // namespace sim
 // this thing is frying me man
@@ -1,4 +1,5 @@
 #include "sim/allocator.h"
+#include "sim/snapshot.h"
 
 #include <algorithm>
 #include <stdexcept>
@@ -10,20 +11,213 @@ namespace sim {
 uint64_t HeapAllocator::align_up(uint64_t n) noexcept {
     return (n + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
 }
+
+uint64_t HeapAllocator::tag_size(uint32_t t) const noexcept {
+    return tags_[t].size & ~FREE_BIT;
+}
+
+bool HeapAllocator::tag_is_free(uint32_t t) const noexcept {
+    return (tags_[t].size & FREE_BIT) != 0;
+}
+
+// Take a tag slot from the recycle list, or grow the array.
+uint32_t HeapAllocator::new_tag(uint64_t start, uint64_t size) {
+    uint32_t t;
+    if (spare_slots_ != NIL) {
+        t = spare_slots_;
+        spare_slots_ = tags_[t].next_free;
+    } else {
+        t = static_cast<uint32_t>(tags_.size());
+        tags_.emplace_back();
+    }
+    tags_[t] = Tag{start, size, NIL, NIL, NIL, NIL, NIL, NIL};
+    return t;
+}
+
+void HeapAllocator::release_tag(uint32_t t) {
+    tags_[t].next_free = spare_slots_;
+    spare_slots_ = t;
+}
+
+// Remove t from the physical chain (its bytes must already belong to a neighbour).
+void HeapAllocator::unlink_phys(uint32_t t) {
+    Tag &tag = tags_[t];
+    if (tag.prev != NIL) tags_[tag.prev].next = tag.next;
+    if (tag.next != NIL) tags_[tag.next].prev = tag.prev;
+    else tail_ = tag.prev;
+}
+
+void HeapAllocator::unlink_free(uint32_t t) {
+    treap_erase(t);
+    Tag &tag = tags_[t];
+    if (tag.prev_free != NIL) tags_[tag.prev_free].next_free = tag.next_free;
+    else free_head_ = tag.next_free;
+    if (tag.next_free != NIL) tags_[tag.next_free].prev_free = tag.prev_free;
+    tag.prev_free = tag.next_free = NIL;
+}
+
+// Link t into the free list right after pred (NIL = at the head).
+void HeapAllocator::insert_free_after(uint32_t t, uint32_t pred) {
+    uint32_t succ = (pred == NIL) ? free_head_ : tags_[pred].next_free;
+    tags_[t].prev_free = pred;
+    tags_[t].next_free = succ;
+    if (pred != NIL) tags_[pred].next_free = t;
+    else free_head_ = t;
+    if (succ != NIL) tags_[succ].prev_free = t;
+    treap_insert(t);
+}
+
+// ----------- Free treap -----------
+
+uint64_t HeapAllocator::treap_priority(uint32_t t) noexcept {
+    uint64_t x = (t + 1) * 0x9E3779B97F4A7C15ull;
+    return x ^ (x >> 29);
+}
+
+// Nearest free block starting below addr: its free-list predecessor
+uint32_t HeapAllocator::free_below(uint64_t addr) const noexcept {
+    uint32_t best = NIL;
+    for (uint32_t n = free_root_; n != NIL;) {
+        if (tags_[n].start < addr) {
+            best = n;
+            n = tags_[n].right;
+        } else {
+            n = tags_[n].left;
+        }
+    }
+    return best;
+}
+
+// Every key under a is below every key under b
+uint32_t HeapAllocator::treap_merge(uint32_t a, uint32_t b) {
+    if (a == NIL) return b;
+    if (b == NIL) return a;
+    if (treap_priority(a) > treap_priority(b)) {
+        tags_[a].right = treap_merge(tags_[a].right, b);
+        return a;
+    }
+    tags_[b].left = treap_merge(a, tags_[b].left);
+    return b;
+}
+
+// Splits n's subtree into starts below addr (lo) and the rest (hi)
+void HeapAllocator::treap_split(uint32_t n, uint64_t addr, uint32_t &lo, uint32_t &hi) {
+    if (n == NIL) {
+        lo = hi = NIL;
+    } else if (tags_[n].start < addr) {
+        treap_split(tags_[n].right, addr, tags_[n].right, hi);
+        lo = n;
+    } else {
+        treap_split(tags_[n].left, addr, lo, tags_[n].left);
+        hi = n;
+    }
+}
+
+void HeapAllocator::treap_insert(uint32_t t) {
+    uint64_t key = tags_[t].start;
+    uint64_t prio = treap_priority(t);
+    uint32_t *link = &free_root_;
+    while (*link != NIL && treap_priority(*link) > prio)
+        link = key < tags_[*link].start ? &tags_[*link].left : &tags_[*link].right;
+    treap_split(*link, key, tags_[t].left, tags_[t].right);
+    *link = t;
+}
+
+void HeapAllocator::treap_erase(uint32_t t) {
+    uint64_t key = tags_[t].start;
+    uint32_t *link = &free_root_;
+    while (*link != t)
+        link = key < tags_[*link].start ? &tags_[*link].left : &tags_[*link].right;
+    *link = treap_merge(tags_[t].left, tags_[t].right);
+    tags_[t].left = tags_[t].right = NIL;
+}
+
+// ----------- Address index -----------
+// Fibonacci hashing on the aligned address; slots hold tag indices and the
+// key is read back from the tag, so each slot costs 4 bytes.
+
+size_t HeapAllocator::index_home(uint64_t addr) const noexcept {
+    return static_cast<size_t>(((addr / ALIGNMENT) * 0x9E3779B97F4A7C15ull) >> (64 - index_bits_));
+}
+
+uint32_t HeapAllocator::index_find(uint64_t addr) const noexcept {
+    size_t mask = index_.size() - 1;
+    for (size_t i = index_home(addr); index_[i] != NIL; i = (i + 1) & mask) {
+        if (tags_[index_[i]].start == addr)
+            return index_[i];
+    }
+    return NIL;
+}
+
+void HeapAllocator::index_insert(uint32_t t) {
+    // keep load factor <= 1/2
+    if ((index_count_ + 1) * 2 > index_.size())
+        index_grow();
+
+    size_t mask = index_.size() - 1;
+    size_t i = index_home(tags_[t].start);
+    while (index_[i] != NIL)
+        i = (i + 1) & mask;
+    index_[i] = t;
+    ++index_count_;
+}
+
+// Backward-shift deletion: no tombstones, probe chains stay short.
+void HeapAllocator::index_erase(uint64_t addr) {
+    size_t mask = index_.size() - 1;
+    size_t hole = index_home(addr);
+    while (tags_[index_[hole]].start != addr)
+        hole = (hole + 1) & mask;
+
+    for (size_t j = (hole + 1) & mask; index_[j] != NIL; j = (j + 1) & mask) {
+        size_t home = index_home(tags_[index_[j]].start);
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            index_[hole] = index_[j];
+            hole = j;
+        }
+    }
+    index_[hole] = NIL;
+    --index_count_;
+}
+
+void HeapAllocator::index_grow() {
+    std::vector<uint32_t> old;
+    old.swap(index_);
+    ++index_bits_;
+    index_.assign(size_t(1) << index_bits_, NIL);
+    index_count_ = 0;
+
+    size_t mask = index_.size() - 1;
+    for (uint32_t t : old) {
+        if (t == NIL) continue;
+        size_t i = index_home(tags_[t].start);
+        while (index_[i] != NIL)
+            i = (i + 1) & mask;
+        index_[i] = t;
+        ++index_count_;
+    }
+}
+
 // using first fit, can easily be changed into worst fit and best fit, but a lil harder to change into slab or buddy
 // ----------- Constructor -----------
 
 HeapAllocator::HeapAllocator(uint64_t heap_base, uint64_t heap_size)
     : heap_base_(heap_base),
       heap_size_(heap_size),
+      free_head_(NIL),
+      free_root_(NIL),
+      tail_(NIL),
+      spare_slots_(NIL),
+      index_count_(0),
+      index_bits_(6),
       allocated_bytes_(0),
       internal_frag_bytes_(0) {
 
-    Block initial;
-    initial.start = heap_base_;
-    initial.size  = heap_size_;
+    index_.assign(size_t(1) << index_bits_, NIL);
 
-    free_blocks_[heap_base_] = initial;
+    uint32_t initial = new_tag(heap_base_, heap_size_ | FREE_BIT);
+    insert_free_after(initial, NIL);
+    tail_ = initial;
 }
 
 // ----------- Allocation (First-Fit) -----------
@@ -35,28 +229,32 @@ std::optional<uint64_t> HeapAllocator::alloc(uint64_t size) {
     uint64_t aligned = align_up(size);
     uint64_t frag = aligned - size;
 
-    for (auto it = free_blocks_.begin(); it != free_blocks_.end(); ++it) {
-        Block free = it->second;
-
-        if (free.size >= aligned) {
-            uint64_t addr = free.start;
-
-            // Remove old free block
-            free_blocks_.erase(it);
-
-            // Insert remaining free block (if any)
-            if (free.size > aligned) {
-                Block remainder;
-                remainder.start = free.start + aligned;
-                remainder.size  = free.size - aligned;
-                free_blocks_[remainder.start] = remainder;
+    for (uint32_t t = free_head_; t != NIL; t = tags_[t].next_free) {
+        uint64_t free_size = tag_size(t);
+
+        if (free_size >= aligned) {
+            uint64_t addr = tags_[t].start;
+
+            uint32_t blk = t;
+            if (free_size > aligned) {
+                // Split: t stays free with the remainder, keeping its
+                // free list and treap place; a new tag below it is the block
+                blk = new_tag(addr, aligned);
+                Tag &r = tags_[t];
+                tags_[blk].prev = r.prev;
+                tags_[blk].next = t;
+                if (r.prev != NIL) tags_[r.prev].next = blk;
+                r.prev = blk;
+                r.start += aligned;
+                r.size = (free_size - aligned) | FREE_BIT;
+            } else {
+                unlink_free(t);
             }
 
             // Record allocated block
-            Block alloc_block;
-            alloc_block.start = addr;
-            alloc_block.size  = aligned;
-            allocated_blocks_[addr] = alloc_block;
+            tags_[blk].size = aligned;
+            tags_[blk].prev_free = 0;   // owner
+            index_insert(blk);
 
             allocated_bytes_ += aligned;
             internal_frag_bytes_ += frag;
@@ -70,47 +268,166 @@ std::optional<uint64_t> HeapAllocator::alloc(uint64_t size) {
 
 // ----------- Free -----------
 
-void HeapAllocator::free(uint64_t addr) {
-    auto it = allocated_blocks_.find(addr);
-    if (it == allocated_blocks_.end())
+HeapAllocator::Block HeapAllocator::free(uint64_t addr) {
+    uint32_t t = index_find(addr);
+    if (t == NIL)
         throw std::runtime_error("HeapAllocator::free invalid address");
 
-    Block blk = it->second;
+    uint64_t size = tag_size(t);
 
-    allocated_bytes_ -= blk.size;
+    allocated_bytes_ -= size;
 
     // Internal fragmentation is reclaimed
     // (we conservatively subtract full block size alignment waste)
     // This matches how we accounted it during alloc.
-    internal_frag_bytes_ -= (blk.size - align_up(blk.size));
-
-    allocated_blocks_.erase(it);
+    internal_frag_bytes_ -= (size - align_up(size));
 
-    // Insert block into free list
-    free_blocks_[blk.start] = blk;
+    index_erase(addr);
 
     // ----------- Coalescing -----------
-
-    auto curr = free_blocks_.find(blk.start);
-    // Coalesce with previous block
-    if (curr != free_blocks_.begin()) {
-        auto prev = std::prev(curr);
-        if (prev->second.start + prev->second.size == curr->second.start) {
-            prev->second.size += curr->second.size;
-            free_blocks_.erase(curr);
-            curr = prev;
+    // Tags tile the heap, so physical neighbours are always adjacent.
+
+    uint32_t prev = tags_[t].prev;
+    uint32_t next = tags_[t].next;
+    bool prev_free = prev != NIL && tag_is_free(prev);
+    bool next_free = next != NIL && tag_is_free(next);
+
+    if (prev_free) {
+        // Coalesce into previous block (keeps its free list position)
+        tags_[prev].size += size;
+        unlink_phys(t);
+        release_tag(t);
+
+        if (next_free) {
+            tags_[prev].size += tag_size(next);
+            unlink_free(next);
+            unlink_phys(next);
+            release_tag(next);
         }
+    } else if (next_free) {
+        // Next block grows down over this one, keeping its free list and
+        // treap place
+        tags_[next].start = addr;
+        tags_[next].size += size;
+        unlink_phys(t);
+        release_tag(t);
+    } else {
+        // No free neighbour: the nearest free block below keeps the free
+        // list in address order
+        tags_[t].size = size | FREE_BIT;
+        insert_free_after(t, free_below(addr));
     }
 
-    // Coalesce with next block
-    auto next = std::next(curr);
-    if (next != free_blocks_.end()) {
-        if (curr->second.start + curr->second.size == next->second.start) {
-            curr->second.size += next->second.size;
-            free_blocks_.erase(next);
+    uint32_t merged = prev_free ? prev : next_free ? next : t;
+    return Block{tags_[merged].start, tag_size(merged)};
+}
+// ----------- In-place resize -----------
+
+bool HeapAllocator::try_resize(uint64_t addr, uint64_t new_size) {
+    uint32_t t = index_find(addr);
+    if (t == NIL)
+        throw std::runtime_error("HeapAllocator::try_resize invalid address");
+    if (new_size == 0)
+        return false;
+
+    uint64_t size = tag_size(t);
+    uint64_t aligned = align_up(new_size);
+    uint32_t next = tags_[t].next;
+    bool next_free = next != NIL && tag_is_free(next);
+
+    if (aligned == size)
+        return true;
+
+    if (aligned < size) {
+        // Shrink: the tail joins the next free block, or becomes one
+        uint64_t tail = size - aligned;
+        if (next_free) {
+            tags_[next].start -= tail;
+            tags_[next].size += tail;
+        } else {
+            uint32_t rem = new_tag(addr + aligned, tail | FREE_BIT);
+            tags_[rem].prev = t;
+            tags_[rem].next = next;
+            if (next != NIL) tags_[next].prev = rem;
+            else tail_ = rem;
+            tags_[t].next = rem;
+
+            insert_free_after(rem, free_below(addr));
         }
+        tags_[t].size = aligned;
+        allocated_bytes_ -= tail;
+        return true;
     }
+
+    // Grow: only into the free block right after this one
+    uint64_t need = aligned - size;
+    if (!next_free || tag_size(next) < need)
+        return false;
+
+    if (tag_size(next) == need) {
+        unlink_free(next);
+        unlink_phys(next);
+        release_tag(next);
+    } else {
+        tags_[next].start += need;
+        tags_[next].size -= need;
+    }
+    tags_[t].size = aligned;
+    allocated_bytes_ += need;
+    return true;
+}
+
+uint64_t HeapAllocator::block_size(uint64_t addr) const {
+    uint32_t t = index_find(addr);
+    if (t == NIL)
+        throw std::runtime_error("HeapAllocator::block_size invalid address");
+    return tag_size(t);
+}
+
+void HeapAllocator::set_owner(uint64_t addr, uint32_t owner) {
+    uint32_t t = index_find(addr);
+    if (t == NIL)
+        throw std::runtime_error("HeapAllocator::set_owner invalid address");
+    tags_[t].prev_free = owner;
+}
+
+uint32_t HeapAllocator::owner(uint64_t addr) const {
+    uint32_t t = index_find(addr);
+    if (t == NIL)
+        throw std::runtime_error("HeapAllocator::owner invalid address");
+    return tags_[t].prev_free;
 }
+
+// ----------- Growth (brk) -----------
+
+void HeapAllocator::grow(uint64_t bytes) {
+    if (bytes == 0)
+        return;
+
+    uint64_t old_end = heap_base_ + heap_size_;
+    heap_size_ += bytes;
+
+    if (tail_ != NIL && tag_is_free(tail_)) {
+        tags_[tail_].size += bytes;
+        return;
+    }
+
+    uint32_t t = new_tag(old_end, bytes | FREE_BIT);
+    tags_[t].prev = tail_;
+    if (tail_ != NIL) tags_[tail_].next = t;
+
+    insert_free_after(t, free_below(old_end));
+    tail_ = t;
+}
+
+uint64_t HeapAllocator::heap_base() const noexcept {
+    return heap_base_;
+}
+
+uint64_t HeapAllocator::heap_end() const noexcept {
+    return heap_base_ + heap_size_;
+}
+
 // code is heavily unoptimized, there are instances where different features of c++ could be used, but this is a really basic C to C++ translation, cuz I got tired of writing C code
 // Forgot to mention most of the code is AI generated, but hey It works well.
 
@@ -130,8 +447,8 @@ uint64_t HeapAllocator::free_bytes() const noexcept {
 
 uint64_t HeapAllocator::largest_free_block() const noexcept {
     uint64_t max = 0;
-    for (const auto &kv : free_blocks_) {
-        max = std::max(max, kv.second.size);
+    for (uint32_t t = free_head_; t != NIL; t = tags_[t].next_free) {
+        max = std::max(max, tag_size(t));
     }
     return max;
 }
@@ -149,4 +466,64 @@ double HeapAllocator::external_fragmentation() const noexcept {
     return 1.0 - (largest / static_cast<double>(free));
 }
 
+// ----------- Checkpoint -----------
+
+// Links are stored off by one so NIL costs one byte
+static uint64_t link_out(uint32_t t) noexcept { return static_cast<uint32_t>(t + 1); }
+static uint32_t link_in(uint64_t v) noexcept { return static_cast<uint32_t>(v - 1); }
+
+void HeapAllocator::save(SnapshotWriter &w) const {
+    w.section("heap");
+    w.u64(heap_base_);
+    w.u64(heap_size_);
+    w.u64(tags_.size());
+    for (const Tag &t : tags_) {
+        w.u64(t.start);
+        w.u64(t.size);
+        w.u64(link_out(t.prev));
+        w.u64(link_out(t.next));
+        w.u64(link_out(t.prev_free));
+        w.u64(link_out(t.next_free));
+    }
+    w.u64(link_out(free_head_));
+    w.u64(link_out(tail_));
+    w.u64(link_out(spare_slots_));
+    w.u64(index_bits_);
+    w.u64(allocated_bytes_);
+    w.u64(internal_frag_bytes_);
+}
+
+// The address index is rebuilt from the allocated tags rather than stored
+void HeapAllocator::load(SnapshotReader &r) {
+    r.section("heap");
+    heap_base_ = r.u64();
+    heap_size_ = r.u64();
+    tags_.resize(r.u64());
+    for (Tag &t : tags_) {
+        t.start = r.u64();
+        t.size = r.u64();
+        t.prev = link_in(r.u64());
+        t.next = link_in(r.u64());
+        t.prev_free = link_in(r.u64());
+        t.next_free = link_in(r.u64());
+    }
+    free_head_ = link_in(r.u64());
+    tail_ = link_in(r.u64());
+    spare_slots_ = link_in(r.u64());
+    index_bits_ = static_cast<unsigned>(r.u64());
+    allocated_bytes_ = r.u64();
+    internal_frag_bytes_ = r.u64();
+
+    index_.assign(size_t(1) << index_bits_, NIL);
+    index_count_ = 0;
+    free_root_ = NIL;
+    for (uint32_t t = tail_; t != NIL; t = tags_[t].prev) {
+        tags_[t].left = tags_[t].right = NIL;
+        if (!tag_is_free(t))
+            index_insert(t);
+        else
+            treap_insert(t);
+    }
+}
+
 } // namespace sim
@@ -0,0 +1,233 @@
+#include "sim/cache.h"
+#include "sim/snapshot.h"
+
+#include <stdexcept>
+
+namespace sim {
+
+static unsigned log2_of(uint64_t v) noexcept {
+    unsigned n = 0;
+    while (v > 1) {
+        v >>= 1;
+        ++n;
+    }
+    return n;
+}
+
+// ---------------- Cache ----------------
+
+Cache::Cache(const CacheLevelConfig &cfg, uint64_t line, CacheReplacement policy)
+    : sets_(cfg.size / (line * cfg.ways)),
+      ways_(static_cast<uint32_t>(cfg.ways)),
+      line_shift_(log2_of(line)),
+      policy_(policy),
+      tags_(sets_ * ways_, EMPTY),
+      tick_(0) {
+    if (policy_ == CacheReplacement::LRU)
+        stamps_.assign(tags_.size(), 0);
+    else
+        tree_.assign(sets_, 0);
+}
+
+bool Cache::access(uint64_t paddr) {
+    uint64_t tag = paddr >> line_shift_;
+    uint64_t set = tag & (sets_ - 1);
+    uint64_t *ways = &tags_[set * ways_];
+
+    for (uint32_t w = 0; w < ways_; ++w) {
+        if (ways[w] == tag) {
+            touch(set, w);
+            return true;
+        }
+    }
+
+    uint32_t w = victim(set);
+    ways[w] = tag;
+    touch(set, w);
+    return false;
+}
+
+uint32_t Cache::victim(uint64_t set) const {
+    const uint64_t *ways = &tags_[set * ways_];
+    for (uint32_t w = 0; w < ways_; ++w) {
+        if (ways[w] == EMPTY)
+            return w;
+    }
+
+    if (policy_ == CacheReplacement::LRU) {
+        const uint64_t *stamps = &stamps_[set * ways_];
+        uint32_t oldest = 0;
+        for (uint32_t w = 1; w < ways_; ++w) {
+            if (stamps[w] < stamps[oldest])
+                oldest = w;
+        }
+        return oldest;
+    }
+
+    // Tree PLRU: nodes 1 .. ways-1 in heap order, each bit points
+    // toward the colder half
+    uint64_t bits = tree_[set];
+    uint32_t node = 1;
+    while (node < ways_)
+        node = 2 * node + static_cast<uint32_t>((bits >> node) & 1);
+    return node - ways_;
+}
+
+void Cache::touch(uint64_t set, uint32_t way) {
+    if (policy_ == CacheReplacement::LRU) {
+        stamps_[set * ways_ + way] = ++tick_;
+        return;
+    }
+
+    // Point every node on way's path away from it
+    uint64_t &bits = tree_[set];
+    uint32_t node = way + ways_;
+    while (node > 1) {
+        uint32_t parent = node / 2;
+        uint64_t away = (node & 1) ? 0 : 1;
+        bits = (bits & ~(uint64_t(1) << parent)) | (away << parent);
+        node = parent;
+    }
+}
+
+void Cache::save(SnapshotWriter &w) const {
+    w.section("cache");
+    w.u64(sets_);
+    w.u64(ways_);
+    for (uint64_t t : tags_)
+        w.u64(t == EMPTY ? 0 : t + 1);
+    for (uint64_t s : stamps_)
+        w.u64(s);
+    for (uint64_t b : tree_)
+        w.u64(b);
+    w.u64(tick_);
+}
+
+void Cache::load(SnapshotReader &r) {
+    r.section("cache");
+    if (r.u64() != sets_ || r.u64() != ways_)
+        throw std::runtime_error("Cache: checkpoint has another cache geometry");
+    for (auto &t : tags_) {
+        uint64_t v = r.u64();
+        t = v == 0 ? EMPTY : v - 1;
+    }
+    for (auto &s : stamps_)
+        s = r.u64();
+    for (auto &b : tree_)
+        b = r.u64();
+    tick_ = r.u64();
+}
+
+// ---------------- Hierarchy ----------------
+
+double CacheLevelStats::hit_rate() const noexcept {
+    uint64_t h = hits[0] + hits[1];
+    uint64_t total = h + misses[0] + misses[1];
+    if (total == 0) return 0.0;
+    return static_cast<double>(h) / static_cast<double>(total);
+}
+
+CacheHierarchy::CacheHierarchy(const SimConfig &cfg)
+    : mem_latency_(cfg.mem_latency),
+      memory_{ 0, 0 } {
+    const struct {
+        const char *name;
+        const CacheLevelConfig &geometry;
+        bool shared;
+    } levels[] = {
+        { "l1", cfg.l1, false },
+        { "l2", cfg.l2, false },
+        { "llc", cfg.llc, true },
+    };
+
+    for (const auto &l : levels) {
+        if (l.geometry.size == 0)
+            continue;
+        CacheLevelStats s;
+        s.name = l.name;
+        s.geometry = l.geometry;
+        s.shared = l.shared;
+        stats_.push_back(s);
+
+        caches_.emplace_back();
+        size_t copies = l.shared ? 1 : cfg.cores;
+        for (size_t c = 0; c < copies; ++c)
+            caches_.back().emplace_back(l.geometry, cfg.cache_line, cfg.cache_policy);
+    }
+}
+
+bool CacheHierarchy::enabled() const noexcept {
+    return !caches_.empty();
+}
+
+Cache &CacheHierarchy::cache(size_t level, uint32_t core) {
+    auto &copies = caches_[level];
+    return copies.size() == 1 ? copies[0] : copies[core];
+}
+
+uint64_t CacheHierarchy::access(uint32_t core, uint64_t paddr, CacheRef ref,
+                                bool &memory) {
+    size_t kind = static_cast<size_t>(ref);
+    for (size_t l = 0; l < caches_.size(); ++l) {
+        if (cache(l, core).access(paddr)) {
+            ++stats_[l].hits[kind];
+            memory = false;
+            return stats_[l].geometry.latency;
+        }
+        ++stats_[l].misses[kind];
+    }
+    ++memory_[kind];
+    memory = true;
+    return mem_latency_;
+}
+
+void CacheHierarchy::warm(uint32_t core, uint64_t paddr) {
+    for (size_t l = 0; l < caches_.size(); ++l) {
+        if (cache(l, core).access(paddr))
+            return;
+    }
+}
+
+const std::vector<CacheLevelStats> &CacheHierarchy::levels() const noexcept {
+    return stats_;
+}
+
+uint64_t CacheHierarchy::memory_refs(CacheRef ref) const noexcept {
+    return memory_[static_cast<size_t>(ref)];
+}
+
+void CacheHierarchy::save(SnapshotWriter &w) const {
+    w.section("caches");
+    w.u64(caches_.size());
+    for (size_t l = 0; l < caches_.size(); ++l) {
+        w.u64(caches_[l].size());
+        for (const auto &c : caches_[l])
+            c.save(w);
+        for (size_t k = 0; k < 2; ++k) {
+            w.u64(stats_[l].hits[k]);
+            w.u64(stats_[l].misses[k]);
+        }
+    }
+    w.u64(memory_[0]);
+    w.u64(memory_[1]);
+}
+
+void CacheHierarchy::load(SnapshotReader &r) {
+    r.section("caches");
+    if (r.u64() != caches_.size())
+        throw std::runtime_error("CacheHierarchy: checkpoint has other cache levels");
+    for (size_t l = 0; l < caches_.size(); ++l) {
+        if (r.u64() != caches_[l].size())
+            throw std::runtime_error("CacheHierarchy: checkpoint has other cache levels");
+        for (auto &c : caches_[l])
+            c.load(r);
+        for (size_t k = 0; k < 2; ++k) {
+            stats_[l].hits[k] = r.u64();
+            stats_[l].misses[k] = r.u64();
+        }
+    }
+    memory_[0] = r.u64();
+    memory_[1] = r.u64();
+}
+
+} // namespace sim
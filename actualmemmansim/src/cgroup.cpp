@@ -0,0 +1,176 @@
+#include "sim/cgroup.h"
+#include "sim/snapshot.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace sim {
+
+static std::string normalize(const std::string &path) {
+    size_t a = path.find_first_not_of('/');
+    if (a == std::string::npos)
+        return std::string();
+    size_t b = path.find_last_not_of('/');
+    return path.substr(a, b - a + 1);
+}
+
+double Cgroup::limit_fault_rate() const noexcept {
+    if (faults == 0) return 0.0;
+    return static_cast<double>(limit_faults) / static_cast<double>(faults);
+}
+
+CgroupTree::CgroupTree(const std::vector<CgroupConfig> &cfg)
+    : groups_(1),
+      limited_(false) {
+    for (const auto &c : cfg) {
+        Cgroup &g = groups_[find_or_create(c.path)];
+        g.max = c.max;
+        g.low = c.low;
+        limited_ = limited_ || c.max != 0 || c.low != 0;
+    }
+}
+
+std::optional<uint32_t> CgroupTree::find(const std::string &path) const {
+    for (uint32_t i = 0; i < groups_.size(); ++i) {
+        if (groups_[i].path == path)
+            return i;
+    }
+    return std::nullopt;
+}
+
+uint32_t CgroupTree::find_or_create(const std::string &path) {
+    std::string p = normalize(path);
+    if (auto id = find(p))
+        return *id;
+
+    size_t slash = p.rfind('/');
+    uint32_t parent = slash == std::string::npos ? ROOT : find_or_create(p.substr(0, slash));
+    Cgroup g;
+    g.path = p;
+    g.parent = parent;
+    groups_.push_back(g);
+    return static_cast<uint32_t>(groups_.size() - 1);
+}
+
+bool CgroupTree::limited() const noexcept {
+    return limited_;
+}
+
+void CgroupTree::charge(uint32_t id) {
+    for (;;) {
+        Cgroup &g = groups_.at(id);
+        g.peak = std::max(g.peak, ++g.usage);
+        if (id == ROOT)
+            return;
+        id = g.parent;
+    }
+}
+
+void CgroupTree::uncharge(uint32_t id) {
+    for (;;) {
+        Cgroup &g = groups_.at(id);
+        if (g.usage == 0)
+            throw std::runtime_error("CgroupTree: uncharging an empty group");
+        --g.usage;
+        if (id == ROOT)
+            return;
+        id = g.parent;
+    }
+}
+
+std::optional<uint32_t> CgroupTree::over_limit(uint32_t id) const {
+    for (;;) {
+        const Cgroup &g = groups_.at(id);
+        if (g.max != 0 && g.usage >= g.max)
+            return id;
+        if (id == ROOT)
+            return std::nullopt;
+        id = g.parent;
+    }
+}
+
+bool CgroupTree::in_subtree(uint32_t id, uint32_t ancestor) const {
+    for (;;) {
+        if (id == ancestor)
+            return true;
+        if (id == ROOT)
+            return false;
+        id = groups_.at(id).parent;
+    }
+}
+
+bool CgroupTree::is_protected(uint32_t id, uint32_t scope) const {
+    for (; id != scope && id != ROOT; id = groups_.at(id).parent) {
+        const Cgroup &g = groups_.at(id);
+        if (g.low != 0 && g.usage <= g.low)
+            return true;
+    }
+    return false;
+}
+
+void CgroupTree::record_fault(uint32_t id, bool limit) {
+    Cgroup &g = groups_.at(id);
+    ++g.faults;
+    if (limit)
+        ++g.limit_faults;
+}
+
+void CgroupTree::record_reclaim(std::optional<uint32_t> limited, uint32_t victim,
+                                bool breach) {
+    if (limited)
+        ++groups_.at(*limited).reclaimed;
+    Cgroup &v = groups_.at(victim);
+    ++v.evicted;
+    if (breach)
+        ++v.low_breaches;
+}
+
+const std::vector<Cgroup> &CgroupTree::groups() const noexcept {
+    return groups_;
+}
+
+void CgroupTree::save(SnapshotWriter &w) const {
+    w.section("cgroups");
+    w.u64(groups_.size());
+    for (const auto &g : groups_) {
+        w.str(g.path);
+        w.u64(g.parent);
+        w.u64(g.max);
+        w.u64(g.low);
+        w.u64(g.usage);
+        w.u64(g.peak);
+        w.u64(g.faults);
+        w.u64(g.limit_faults);
+        w.u64(g.reclaimed);
+        w.u64(g.evicted);
+        w.u64(g.low_breaches);
+    }
+}
+
+// Limits stay as configured here, by path
+void CgroupTree::load(SnapshotReader &r) {
+    r.section("cgroups");
+    std::vector<Cgroup> groups(r.u64());
+    for (auto &g : groups) {
+        g.path = r.str();
+        g.parent = static_cast<uint32_t>(r.u64());
+        r.u64();
+        r.u64();
+        g.usage = r.u64();
+        g.peak = r.u64();
+        g.faults = r.u64();
+        g.limit_faults = r.u64();
+        g.reclaimed = r.u64();
+        g.evicted = r.u64();
+        g.low_breaches = r.u64();
+        if (auto id = find(g.path)) {
+            g.max = groups_[*id].max;
+            g.low = groups_[*id].low;
+        }
+    }
+    if (groups.empty() || !groups[0].path.empty())
+        throw std::runtime_error("CgroupTree: checkpoint has no root group");
+    groups_ = std::move(groups);
+}
+
+} // namespace sim
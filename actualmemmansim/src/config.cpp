@@ -0,0 +1,551 @@
+#include "sim/config.h"
+
+#include <fstream>
+#include <stdexcept>
+
+namespace sim {
+
+// Decimal or 0x-prefixed hex, nothing else
+static uint64_t parse_number(const std::string &key, const std::string &s) {
+    try {
+        size_t used = 0;
+        uint64_t v;
+        if (s.size() > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X'))
+            v = std::stoull(s, &used, 16);
+        else
+            v = std::stoull(s, &used, 10);
+        if (used == s.size() && s[0] != '-')
+            return v;
+    } catch (const std::exception &) {
+    }
+    throw std::invalid_argument("SimConfig: bad value for " + key + ": " + s);
+}
+
+static std::string trim(const std::string &s) {
+    size_t a = s.find_first_not_of(" \t\r");
+    if (a == std::string::npos)
+        return std::string();
+    size_t b = s.find_last_not_of(" \t\r");
+    return s.substr(a, b - a + 1);
+}
+
+const char *heap_release_name(HeapReleasePolicy policy) noexcept {
+    switch (policy) {
+        case HeapReleasePolicy::DONTNEED:  return "dontneed";
+        case HeapReleasePolicy::LAZY_FREE: return "free";
+        default:                           return "none";
+    }
+}
+
+const char *sched_policy_name(SchedPolicy policy) noexcept {
+    switch (policy) {
+        case SchedPolicy::RR:  return "rr";
+        case SchedPolicy::CFS: return "cfs";
+        default:               return "fifo";
+    }
+}
+
+const char *tlb_switch_name(TlbSwitchPolicy policy) noexcept {
+    return policy == TlbSwitchPolicy::FLUSH ? "flush" : "asid";
+}
+
+const char *numa_policy_name(NumaPolicy policy) noexcept {
+    switch (policy) {
+        case NumaPolicy::INTERLEAVE: return "interleave";
+        case NumaPolicy::BIND:       return "bind";
+        default:                     return "first-touch";
+    }
+}
+
+const char *frame_policy_name(FramePolicy policy) noexcept {
+    switch (policy) {
+        case FramePolicy::LOCAL: return "local";
+        case FramePolicy::WS:    return "ws";
+        case FramePolicy::PFF:   return "pff";
+        default:                 return "global";
+    }
+}
+
+const char *cache_policy_name(CacheReplacement policy) noexcept {
+    return policy == CacheReplacement::PLRU ? "plru" : "lru";
+}
+
+// A byte count with an optional K/M/G suffix
+static uint64_t parse_size(const std::string &key, std::string s) {
+    uint64_t scale = 1;
+    if (!s.empty()) {
+        switch (s.back()) {
+            case 'K': case 'k': scale = uint64_t(1) << 10; break;
+            case 'M': case 'm': scale = uint64_t(1) << 20; break;
+            case 'G': case 'g': scale = uint64_t(1) << 30; break;
+        }
+        if (scale != 1)
+            s.pop_back();
+    }
+    return parse_number(key, s) * scale;
+}
+
+// "32K,8,4": size (K/M/G suffix allowed), ways, hit latency; "off" = none
+static CacheLevelConfig parse_cache_level(const std::string &key, const std::string &s) {
+    CacheLevelConfig c;
+    if (s == "off")
+        return c;
+
+    std::vector<std::string> parts(1);
+    for (char ch : s) {
+        if (ch == ',')
+            parts.emplace_back();
+        else
+            parts.back() += ch;
+    }
+    if (parts.size() != 3)
+        throw std::invalid_argument("SimConfig: " + key + " wants SIZE,WAYS,LATENCY or off");
+
+    c.size = parse_size(key, trim(parts[0]));
+    c.ways = parse_number(key, trim(parts[1]));
+    c.latency = parse_number(key, trim(parts[2]));
+    if (c.size == 0)
+        throw std::invalid_argument("SimConfig: " + key + " size must be at least 1");
+    return c;
+}
+
+static void write_cache_level(std::ostream &os, const char *key, const CacheLevelConfig &c) {
+    os << key << " = ";
+    if (c.size == 0)
+        os << "off\n";
+    else
+        os << c.size << "," << c.ways << "," << c.latency << "\n";
+}
+
+// "a:max=32,low=8;a/b:max=16": groups split by ';', limits in frames.
+// Leading and trailing '/' of a path are dropped.
+static std::vector<CgroupConfig> parse_cgroups(const std::string &key, const std::string &s) {
+    std::vector<CgroupConfig> out;
+    size_t start = 0;
+    while (start <= s.size()) {
+        size_t end = s.find(';', start);
+        if (end == std::string::npos)
+            end = s.size();
+        std::string group = trim(s.substr(start, end - start));
+        start = end + 1;
+        if (group.empty())
+            continue;
+
+        CgroupConfig c;
+        size_t colon = group.find(':');
+        c.path = trim(group.substr(0, colon));
+        while (!c.path.empty() && c.path.front() == '/')
+            c.path.erase(0, 1);
+        while (!c.path.empty() && c.path.back() == '/')
+            c.path.pop_back();
+        if (c.path.empty())
+            throw std::invalid_argument("SimConfig: " + key + " can not limit the root group");
+
+        std::string limits = colon == std::string::npos ? "" : group.substr(colon + 1);
+        size_t at = 0;
+        while (at < limits.size()) {
+            size_t comma = limits.find(',', at);
+            if (comma == std::string::npos)
+                comma = limits.size();
+            std::string limit = trim(limits.substr(at, comma - at));
+            at = comma + 1;
+            size_t eq = limit.find('=');
+            std::string name = trim(limit.substr(0, eq));
+            if (eq == std::string::npos || (name != "max" && name != "low"))
+                throw std::invalid_argument("SimConfig: " + key + " wants PATH:max=N,low=N");
+            uint64_t v = parse_number(key, trim(limit.substr(eq + 1)));
+            (name == "max" ? c.max : c.low) = v;
+        }
+        out.push_back(c);
+    }
+    return out;
+}
+
+static void write_cgroups(std::ostream &os, const std::vector<CgroupConfig> &groups) {
+    os << "cgroups = ";
+    for (size_t i = 0; i < groups.size(); ++i) {
+        os << (i ? ";" : "") << groups[i].path << ":max=" << groups[i].max
+           << ",low=" << groups[i].low;
+    }
+    os << "\n";
+}
+
+// "3" or "1:10,2.5:60,4:30": compression ratios, each with a weight
+static std::vector<ZswapRatio> parse_zswap_ratio(const std::string &key, const std::string &s) {
+    std::vector<ZswapRatio> out;
+    size_t at = 0;
+    while (at <= s.size()) {
+        size_t comma = s.find(',', at);
+        if (comma == std::string::npos)
+            comma = s.size();
+        std::string bucket = trim(s.substr(at, comma - at));
+        at = comma + 1;
+
+        size_t colon = bucket.find(':');
+        std::string ratio = trim(bucket.substr(0, colon));
+        ZswapRatio r;
+        try {
+            size_t used = 0;
+            r.ratio = std::stod(ratio, &used);
+            if (used != ratio.size())
+                throw std::invalid_argument(ratio);
+        } catch (const std::exception &) {
+            throw std::invalid_argument("SimConfig: " + key + " wants RATIO[:WEIGHT],...");
+        }
+        if (colon != std::string::npos)
+            r.weight = parse_number(key, trim(bucket.substr(colon + 1)));
+        out.push_back(r);
+    }
+    return out;
+}
+
+static void write_zswap_ratio(std::ostream &os, const std::vector<ZswapRatio> &ratios) {
+    os << "zswap-ratio = ";
+    for (size_t i = 0; i < ratios.size(); ++i)
+        os << (i ? "," : "") << ratios[i].ratio << ":" << ratios[i].weight;
+    os << "\n";
+}
+
+// "10,20;20,10": rows split by ';', entries by ','
+static std::vector<uint64_t> parse_matrix(const std::string &key, const std::string &s) {
+    std::vector<uint64_t> out;
+    std::string cell;
+    for (size_t i = 0; i <= s.size(); ++i) {
+        if (i == s.size() || s[i] == ',' || s[i] == ';') {
+            out.push_back(parse_number(key, trim(cell)));
+            cell.clear();
+        } else {
+            cell += s[i];
+        }
+    }
+    return out;
+}
+
+uint64_t SimConfig::distance(size_t from, size_t to) const noexcept {
+    if (numa_distance.empty())
+        return from == to ? 10 : 20;
+    return numa_distance[from * numa_nodes + to];
+}
+
+bool SimConfig::caches() const noexcept {
+    return l1.size != 0 || l2.size != 0 || llc.size != 0;
+}
+
+bool SimConfig::set(const std::string &key, const std::string &value) {
+    if (key == "page-size")
+        page_size = parse_number(key, value);
+    else if (key == "frames")
+        num_frames = static_cast<size_t>(parse_number(key, value));
+    else if (key == "tlb-size")
+        tlb_size = static_cast<size_t>(parse_number(key, value));
+    else if (key == "tlb-hit-latency")
+        tlb_hit_latency = parse_number(key, value);
+    else if (key == "pt-hit-latency")
+        pt_hit_latency = parse_number(key, value);
+    else if (key == "fault-latency")
+        fault_latency = parse_number(key, value);
+    else if (key == "pagein-latency")
+        pagein_latency = parse_number(key, value);
+    else if (key == "cores")
+        cores = parse_number(key, value);
+    else if (key == "shootdown-latency")
+        shootdown_latency = parse_number(key, value);
+    else if (key == "heap-release") {
+        if (value == "none")
+            heap_release = HeapReleasePolicy::NONE;
+        else if (value == "dontneed")
+            heap_release = HeapReleasePolicy::DONTNEED;
+        else if (value == "free")
+            heap_release = HeapReleasePolicy::LAZY_FREE;
+        else
+            throw std::invalid_argument("SimConfig: bad value for heap-release: " + value);
+    }
+    else if (key == "brk-grow")
+        heap.brk_grow_step = parse_number(key, value);
+    else if (key == "mmap-threshold")
+        heap.mmap_threshold = parse_number(key, value);
+    else if (key == "tcache-batch")
+        heap.tcache_batch = parse_number(key, value);
+    else if (key == "sched") {
+        if (value == "fifo")
+            sched = SchedPolicy::FIFO;
+        else if (value == "rr")
+            sched = SchedPolicy::RR;
+        else if (value == "cfs")
+            sched = SchedPolicy::CFS;
+        else
+            throw std::invalid_argument("SimConfig: bad value for sched: " + value);
+    }
+    else if (key == "quantum")
+        quantum = parse_number(key, value);
+    else if (key == "ctx-switch-latency")
+        ctx_switch_latency = parse_number(key, value);
+    else if (key == "tlb-switch") {
+        if (value == "asid")
+            tlb_switch = TlbSwitchPolicy::ASID;
+        else if (value == "flush")
+            tlb_switch = TlbSwitchPolicy::FLUSH;
+        else
+            throw std::invalid_argument("SimConfig: bad value for tlb-switch: " + value);
+    }
+    else if (key == "numa-nodes")
+        numa_nodes = static_cast<size_t>(parse_number(key, value));
+    else if (key == "numa-distance")
+        numa_distance = value.empty() ? std::vector<uint64_t>() : parse_matrix(key, value);
+    else if (key == "numa-policy") {
+        if (value == "first-touch")
+            numa_policy = NumaPolicy::FIRST_TOUCH;
+        else if (value == "interleave")
+            numa_policy = NumaPolicy::INTERLEAVE;
+        else if (value == "bind")
+            numa_policy = NumaPolicy::BIND;
+        else
+            throw std::invalid_argument("SimConfig: bad value for numa-policy: " + value);
+    }
+    else if (key == "numa-bind")
+        numa_bind = static_cast<uint32_t>(parse_number(key, value));
+    else if (key == "numa-latency")
+        numa_latency = parse_number(key, value);
+    else if (key == "numa-sample")
+        numa_sample = parse_number(key, value);
+    else if (key == "numa-migrate-latency")
+        numa_migrate_latency = parse_number(key, value);
+    else if (key == "frame-policy") {
+        if (value == "global")
+            frame_policy = FramePolicy::GLOBAL;
+        else if (value == "local")
+            frame_policy = FramePolicy::LOCAL;
+        else if (value == "ws")
+            frame_policy = FramePolicy::WS;
+        else if (value == "pff")
+            frame_policy = FramePolicy::PFF;
+        else
+            throw std::invalid_argument("SimConfig: bad value for frame-policy: " + value);
+    }
+    else if (key == "frame-budget")
+        frame_budget = parse_number(key, value);
+    else if (key == "ws-window")
+        ws_window = parse_number(key, value);
+    else if (key == "pff-interval")
+        pff_interval = parse_number(key, value);
+    else if (key == "watermark-low")
+        watermark_low = parse_number(key, value);
+    else if (key == "watermark-high")
+        watermark_high = parse_number(key, value);
+    else if (key == "kswapd-batch")
+        kswapd_batch = parse_number(key, value);
+    else if (key == "reclaim-latency")
+        reclaim_latency = parse_number(key, value);
+    else if (key == "cgroups")
+        cgroups = parse_cgroups(key, value);
+    else if (key == "zswap-pool")
+        zswap_pool = parse_size(key, value);
+    else if (key == "zswap-ratio")
+        zswap_ratio = parse_zswap_ratio(key, value);
+    else if (key == "zswap-compress-latency")
+        zswap_compress_latency = parse_number(key, value);
+    else if (key == "zswap-decompress-latency")
+        zswap_decompress_latency = parse_number(key, value);
+    else if (key == "swap-slots")
+        swap_slots = parse_number(key, value);
+    else if (key == "swap-cluster")
+        swap_cluster = parse_number(key, value);
+    else if (key == "swap-readahead")
+        swap_readahead = parse_number(key, value);
+    else if (key == "swap-cache")
+        swap_cache = parse_number(key, value);
+    else if (key == "swap-cache-latency")
+        swap_cache_latency = parse_number(key, value);
+    else if (key == "l1")
+        l1 = parse_cache_level(key, value);
+    else if (key == "l2")
+        l2 = parse_cache_level(key, value);
+    else if (key == "llc")
+        llc = parse_cache_level(key, value);
+    else if (key == "cache-line")
+        cache_line = parse_number(key, value);
+    else if (key == "cache-policy") {
+        if (value == "lru")
+            cache_policy = CacheReplacement::LRU;
+        else if (value == "plru")
+            cache_policy = CacheReplacement::PLRU;
+        else
+            throw std::invalid_argument("SimConfig: bad value for cache-policy: " + value);
+    }
+    else if (key == "mem-latency")
+        mem_latency = parse_number(key, value);
+    else if (key == "walk-levels")
+        walk_levels = parse_number(key, value);
+    else
+        return false;
+    return true;
+}
+
+// Sets must come out a power of two
+static void validate_cache_level(const char *key, const CacheLevelConfig &c,
+                                 uint64_t line, CacheReplacement policy) {
+    if (c.size == 0)
+        return;
+    std::string k = key;
+    if (c.ways == 0 || c.ways > 64)
+        throw std::invalid_argument("SimConfig: " + k + " ways must be 1 to 64");
+    if (policy == CacheReplacement::PLRU && (c.ways & (c.ways - 1)) != 0)
+        throw std::invalid_argument("SimConfig: " + k + " ways must be a power of two for plru");
+    uint64_t sets = c.size / (line * c.ways);
+    if (sets == 0 || sets * line * c.ways != c.size || (sets & (sets - 1)) != 0)
+        throw std::invalid_argument("SimConfig: " + k + " size / (cache-line x ways) "
+                                    "must be a power of two");
+}
+
+void SimConfig::validate() const {
+    if (page_size == 0 || (page_size & (page_size - 1)) != 0)
+        throw std::invalid_argument("SimConfig: page-size must be a power of two");
+    if (num_frames == 0)
+        throw std::invalid_argument("SimConfig: frames must be at least 1");
+    if (tlb_size == 0)
+        throw std::invalid_argument("SimConfig: tlb-size must be at least 1");
+    if (quantum == 0)
+        throw std::invalid_argument("SimConfig: quantum must be at least 1");
+    if (cores == 0 || cores > 1024)
+        throw std::invalid_argument("SimConfig: cores must be 1 to 1024");
+    if (numa_nodes == 0 || numa_nodes > 64)
+        throw std::invalid_argument("SimConfig: numa-nodes must be 1 to 64");
+    if (num_frames < numa_nodes)
+        throw std::invalid_argument("SimConfig: every NUMA node needs a frame");
+    if (numa_bind >= numa_nodes)
+        throw std::invalid_argument("SimConfig: numa-bind names no node");
+    if (!numa_distance.empty()) {
+        if (numa_distance.size() != numa_nodes * numa_nodes)
+            throw std::invalid_argument("SimConfig: numa-distance must be numa-nodes x numa-nodes");
+        for (size_t a = 0; a < numa_nodes; ++a) {
+            for (size_t b = 0; b < numa_nodes; ++b) {
+                if (a == b ? distance(a, b) != 10 : distance(a, b) < 10)
+                    throw std::invalid_argument("SimConfig: numa-distance is 10 on the "
+                                                "diagonal and at least 10 elsewhere");
+            }
+        }
+    }
+    if (ws_window == 0)
+        throw std::invalid_argument("SimConfig: ws-window must be at least 1");
+    if (pff_interval == 0)
+        throw std::invalid_argument("SimConfig: pff-interval must be at least 1");
+    if (watermark_high < watermark_low || watermark_high > num_frames)
+        throw std::invalid_argument("SimConfig: watermarks must be low <= high <= frames");
+    if (kswapd_batch == 0)
+        throw std::invalid_argument("SimConfig: kswapd-batch must be at least 1");
+    for (size_t i = 0; i < cgroups.size(); ++i) {
+        for (size_t j = 0; j < i; ++j) {
+            if (cgroups[j].path == cgroups[i].path)
+                throw std::invalid_argument("SimConfig: cgroups lists " + cgroups[i].path + " twice");
+        }
+    }
+    uint64_t ratio_weight = 0;
+    for (const auto &r : zswap_ratio) {
+        if (!(r.ratio >= 1.0))
+            throw std::invalid_argument("SimConfig: zswap-ratio values must be at least 1");
+        ratio_weight += r.weight;
+    }
+    if (ratio_weight == 0)
+        throw std::invalid_argument("SimConfig: zswap-ratio needs a positive weight");
+    if (swap_cluster == 0)
+        throw std::invalid_argument("SimConfig: swap-cluster must be at least 1");
+    if (cache_line < 8 || (cache_line & (cache_line - 1)) != 0)
+        throw std::invalid_argument("SimConfig: cache-line must be a power of two, at least 8");
+    if (caches() && cache_line > page_size)
+        throw std::invalid_argument("SimConfig: cache-line must not exceed page-size");
+    if (walk_levels == 0 || walk_levels > 5)
+        throw std::invalid_argument("SimConfig: walk-levels must be 1 to 5");
+    validate_cache_level("l1", l1, cache_line, cache_policy);
+    validate_cache_level("l2", l2, cache_line, cache_policy);
+    validate_cache_level("llc", llc, cache_line, cache_policy);
+}
+
+void load_config_file(const std::string &path, SimConfig &cfg) {
+    std::ifstream in(path);
+    if (!in)
+        throw std::runtime_error("SimConfig: cannot open " + path);
+
+    std::string line;
+    size_t lineno = 0;
+    while (std::getline(in, line)) {
+        ++lineno;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos)
+            line.erase(hash);
+        line = trim(line);
+        if (line.empty())
+            continue;
+
+        std::string where = path + ":" + std::to_string(lineno) + ": ";
+        size_t eq = line.find('=');
+        if (eq == std::string::npos)
+            throw std::runtime_error(where + "expected key = value");
+
+        std::string key = trim(line.substr(0, eq));
+        try {
+            if (!cfg.set(key, trim(line.substr(eq + 1))))
+                throw std::runtime_error(where + "unknown key " + key);
+        } catch (const std::invalid_argument &e) {
+            throw std::runtime_error(where + e.what());
+        }
+    }
+}
+
+void write_config(std::ostream &os, const SimConfig &cfg) {
+    os << "page-size = " << cfg.page_size << "\n"
+       << "frames = " << cfg.num_frames << "\n"
+       << "tlb-size = " << cfg.tlb_size << "\n"
+       << "tlb-hit-latency = " << cfg.tlb_hit_latency << "\n"
+       << "pt-hit-latency = " << cfg.pt_hit_latency << "\n"
+       << "fault-latency = " << cfg.fault_latency << "\n"
+       << "pagein-latency = " << cfg.pagein_latency << "\n"
+       << "cores = " << cfg.cores << "\n"
+       << "shootdown-latency = " << cfg.shootdown_latency << "\n"
+       << "heap-release = " << heap_release_name(cfg.heap_release) << "\n"
+       << "brk-grow = " << cfg.heap.brk_grow_step << "\n"
+       << "mmap-threshold = " << cfg.heap.mmap_threshold << "\n"
+       << "tcache-batch = " << cfg.heap.tcache_batch << "\n"
+       << "sched = " << sched_policy_name(cfg.sched) << "\n"
+       << "quantum = " << cfg.quantum << "\n"
+       << "ctx-switch-latency = " << cfg.ctx_switch_latency << "\n"
+       << "tlb-switch = " << tlb_switch_name(cfg.tlb_switch) << "\n"
+       << "numa-nodes = " << cfg.numa_nodes << "\n"
+       << "numa-distance = ";
+    for (size_t a = 0; a < cfg.numa_nodes; ++a) {
+        for (size_t b = 0; b < cfg.numa_nodes; ++b)
+            os << (b ? "," : a ? ";" : "") << cfg.distance(a, b);
+    }
+    os << "\n"
+       << "numa-policy = " << numa_policy_name(cfg.numa_policy) << "\n"
+       << "numa-bind = " << cfg.numa_bind << "\n"
+       << "numa-latency = " << cfg.numa_latency << "\n"
+       << "numa-sample = " << cfg.numa_sample << "\n"
+       << "numa-migrate-latency = " << cfg.numa_migrate_latency << "\n";
+    os << "frame-policy = " << frame_policy_name(cfg.frame_policy) << "\n"
+       << "frame-budget = " << cfg.frame_budget << "\n"
+       << "ws-window = " << cfg.ws_window << "\n"
+       << "pff-interval = " << cfg.pff_interval << "\n";
+    os << "watermark-low = " << cfg.watermark_low << "\n"
+       << "watermark-high = " << cfg.watermark_high << "\n"
+       << "kswapd-batch = " << cfg.kswapd_batch << "\n"
+       << "reclaim-latency = " << cfg.reclaim_latency << "\n";
+    write_cgroups(os, cfg.cgroups);
+    os << "zswap-pool = " << cfg.zswap_pool << "\n";
+    write_zswap_ratio(os, cfg.zswap_ratio);
+    os << "zswap-compress-latency = " << cfg.zswap_compress_latency << "\n"
+       << "zswap-decompress-latency = " << cfg.zswap_decompress_latency << "\n"
+       << "swap-slots = " << cfg.swap_slots << "\n"
+       << "swap-cluster = " << cfg.swap_cluster << "\n"
+       << "swap-readahead = " << cfg.swap_readahead << "\n"
+       << "swap-cache = " << cfg.swap_cache << "\n"
+       << "swap-cache-latency = " << cfg.swap_cache_latency << "\n";
+    write_cache_level(os, "l1", cfg.l1);
+    write_cache_level(os, "l2", cfg.l2);
+    write_cache_level(os, "llc", cfg.llc);
+    os << "cache-line = " << cfg.cache_line << "\n"
+       << "cache-policy = " << cache_policy_name(cfg.cache_policy) << "\n"
+       << "mem-latency = " << cfg.mem_latency << "\n"
+       << "walk-levels = " << cfg.walk_levels << "\n";
+}
+
+} // namespace sim
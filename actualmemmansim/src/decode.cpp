@@ -0,0 +1,39 @@
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "sim/eventlog.h"
+
+// memsim_decode: print a binary event log (--event-log) as the text trace
+
+using namespace sim;
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        std::cerr << "usage: memsim_decode <events.bin>\n";
+        return 1;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        std::cerr << "cannot open " << argv[1] << "\n";
+        return 1;
+    }
+
+    try {
+        EventLogReader reader(in);
+        LogRecord rec;
+        std::string line;
+        while (reader.next(rec)) {
+            format_record(rec, line);
+            line += '\n';
+            std::cout.write(line.data(), static_cast<std::streamsize>(line.size()));
+        }
+    } catch (const std::exception &e) {
+        std::cout.flush();
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
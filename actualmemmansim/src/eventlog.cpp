@@ -0,0 +1,340 @@
+#include "sim/eventlog.h"
+
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+namespace sim {
+
+// Binary layout: MAGIC, then per record
+//   kind (1 byte), zigzag time delta, pid, tid, kind's fields
+// with every integer as an LEB128 varint.
+static const char MAGIC[8] = { 'M', 'S', 'I', 'M', 'L', 'O', 'G', '1' };
+
+static constexpr size_t FLUSH_AT = 64 * 1024;
+
+// Number of a/b/c/d fields each kind carries
+static int field_count(LogKind kind) {
+    switch (kind) {
+        case LogKind::THREAD_EXIT:     return 1;
+        case LogKind::MALLOC:          return 2;
+        case LogKind::FREE:            return 2;
+        case LogKind::REALLOC:         return 4;
+        case LogKind::CALLOC:          return 3;
+        case LogKind::ACCESS_HIT:      return 1;
+        case LogKind::PAGE_FAULT:      return 1;
+        case LogKind::PAGEIN_COMPLETE: return 1;
+        case LogKind::SUSPEND:         return 1;
+        case LogKind::KSWAPD:          return 2;
+        default:                       return 0;
+    }
+}
+
+bool is_failure(LogKind kind) noexcept {
+    return kind == LogKind::MALLOC_FAILED ||
+           kind == LogKind::REALLOC_FAILED ||
+           kind == LogKind::CALLOC_FAILED;
+}
+
+// ---------------- Text ----------------
+
+static void append_u64(std::string &out, uint64_t v) {
+    char buf[24];
+    auto r = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, r.ptr);
+}
+
+static void append_hex(std::string &out, uint64_t v) {
+    char buf[24];
+    auto r = std::to_chars(buf, buf + sizeof(buf), v, 16);
+    out += "0x";
+    out.append(buf, r.ptr);
+}
+
+static void append_head(std::string &out, const LogRecord &rec, const char *name,
+                        bool with_tid) {
+    out += "[t=";
+    append_u64(out, rec.time);
+    out += "] ";
+    out += name;
+    out += " pid=";
+    append_u64(out, rec.pid);
+    if (with_tid && rec.tid) {
+        out += " tid=";
+        append_u64(out, rec.tid);
+    }
+}
+
+void format_record(const LogRecord &rec, std::string &out) {
+    out.clear();
+    switch (rec.kind) {
+        case LogKind::PROC_START:
+            append_head(out, rec, "PROC_START", false);
+            break;
+        case LogKind::PROC_EXIT:
+            append_head(out, rec, "PROC_EXIT", false);
+            break;
+        case LogKind::THREAD_START:
+            append_head(out, rec, "THREAD_START", true);
+            break;
+        case LogKind::THREAD_EXIT:
+            append_head(out, rec, "THREAD_EXIT", true);
+            if (rec.a) {
+                out += " released_pages=";
+                append_u64(out, rec.a);
+            }
+            break;
+        case LogKind::MALLOC:
+            append_head(out, rec, "MALLOC", true);
+            out += " size=";
+            append_u64(out, rec.a);
+            out += " → addr=";
+            append_hex(out, rec.b);
+            break;
+        case LogKind::FREE:
+            append_head(out, rec, "FREE", true);
+            out += " addr=";
+            append_hex(out, rec.a);
+            if (rec.b) {
+                out += " released_pages=";
+                append_u64(out, rec.b);
+            }
+            break;
+        case LogKind::REALLOC:
+            append_head(out, rec, "REALLOC", true);
+            out += " addr=";
+            append_hex(out, rec.a);
+            out += " size=";
+            append_u64(out, rec.b);
+            out += " → addr=";
+            append_hex(out, rec.c);
+            if (rec.moved) {
+                out += " (moved, copy=";
+                append_u64(out, rec.d);
+                out += ")";
+            } else {
+                out += " (in place)";
+            }
+            break;
+        case LogKind::CALLOC:
+            append_head(out, rec, "CALLOC", true);
+            out += " size=";
+            append_u64(out, rec.a);
+            out += " → addr=";
+            append_hex(out, rec.b);
+            out += " zeroed_pages=";
+            append_u64(out, rec.c);
+            break;
+        case LogKind::ACCESS_HIT:
+            append_head(out, rec, "ACCESS", true);
+            out += " vaddr=";
+            append_hex(out, rec.a);
+            out += " (hit)";
+            break;
+        case LogKind::PAGE_FAULT:
+            append_head(out, rec, "PAGE_FAULT", false);
+            out += " vpn=";
+            append_u64(out, rec.a);
+            out += " → BLOCKED";
+            break;
+        case LogKind::PAGEIN_COMPLETE:
+            append_head(out, rec, "PAGEIN_COMPLETE", false);
+            out += " vpn=";
+            append_u64(out, rec.a);
+            out += " → READY";
+            break;
+        case LogKind::PREEMPT:
+            append_head(out, rec, "PREEMPT", false);
+            out += " → READY";
+            break;
+        case LogKind::SUSPEND:
+            append_head(out, rec, "SUSPEND", false);
+            out += " swapped_out=";
+            append_u64(out, rec.a);
+            break;
+        case LogKind::RESUME:
+            append_head(out, rec, "RESUME", false);
+            break;
+        case LogKind::KSWAPD:
+            out += "[t=";
+            append_u64(out, rec.time);
+            out += "] KSWAPD reclaimed=";
+            append_u64(out, rec.a);
+            out += " free=";
+            append_u64(out, rec.b);
+            break;
+        case LogKind::MALLOC_FAILED:
+        case LogKind::REALLOC_FAILED:
+        case LogKind::CALLOC_FAILED:
+            out += rec.kind == LogKind::MALLOC_FAILED  ? "MALLOC"
+                 : rec.kind == LogKind::REALLOC_FAILED ? "REALLOC" : "CALLOC";
+            out += " failed pid=";
+            append_u64(out, rec.pid);
+            break;
+        default:
+            throw std::runtime_error("EventLog: unknown record kind");
+    }
+}
+
+// ---------------- Writer ----------------
+
+EventLog::EventLog(std::ostream &text, std::ostream &errors, LogLevel level)
+    : text_(text), errors_(errors), level_(level), last_time_(0) {
+    text_buf_.reserve(FLUSH_AT + 256);
+}
+
+EventLog::~EventLog() {
+    flush();
+}
+
+bool EventLog::open_binary(const std::string &path) {
+    bin_.open(path, std::ios::binary | std::ios::trunc);
+    if (!bin_)
+        return false;
+    bin_.write(MAGIC, sizeof(MAGIC));
+    bin_buf_.reserve(FLUSH_AT + 64);
+    return true;
+}
+
+LogLevel EventLog::level() const noexcept {
+    return level_;
+}
+
+bool EventLog::wants_text(LogKind kind) const noexcept {
+    switch (level_) {
+        case LogLevel::OFF:
+            return false;
+        case LogLevel::SUMMARY:
+            return is_failure(kind);
+        case LogLevel::FAULTS:
+            return is_failure(kind) || kind == LogKind::PAGE_FAULT ||
+                   kind == LogKind::PAGEIN_COMPLETE || kind == LogKind::SUSPEND ||
+                   kind == LogKind::RESUME || kind == LogKind::KSWAPD;
+        default:
+            return true;
+    }
+}
+
+void EventLog::record(const LogRecord &rec) {
+    if (bin_.is_open())
+        encode(rec);
+
+    if (!wants_text(rec.kind))
+        return;
+
+    format_record(rec, line_);
+    line_ += '\n';
+    if (is_failure(rec.kind)) {
+        // Keep stdout / stderr interleaving as it happened
+        flush();
+        errors_ << line_;
+        return;
+    }
+    text_buf_ += line_;
+    if (text_buf_.size() >= FLUSH_AT) {
+        text_.write(text_buf_.data(), static_cast<std::streamsize>(text_buf_.size()));
+        text_buf_.clear();
+    }
+}
+
+void EventLog::flush() {
+    if (!text_buf_.empty()) {
+        text_.write(text_buf_.data(), static_cast<std::streamsize>(text_buf_.size()));
+        text_buf_.clear();
+    }
+    text_.flush();
+    if (bin_.is_open() && !bin_buf_.empty()) {
+        bin_.write(bin_buf_.data(), static_cast<std::streamsize>(bin_buf_.size()));
+        bin_buf_.clear();
+        bin_.flush();
+    }
+}
+
+static void put_varint(std::string &out, uint64_t v) {
+    while (v >= 0x80) {
+        out += static_cast<char>((v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    out += static_cast<char>(v);
+}
+
+void EventLog::encode(const LogRecord &rec) {
+    int64_t delta = static_cast<int64_t>(rec.time - last_time_);
+    last_time_ = rec.time;
+
+    bin_buf_ += static_cast<char>(rec.kind);
+    put_varint(bin_buf_, (static_cast<uint64_t>(delta) << 1) ^
+                         static_cast<uint64_t>(delta >> 63));
+    put_varint(bin_buf_, rec.pid);
+    put_varint(bin_buf_, rec.tid);
+
+    const uint64_t fields[4] = { rec.a, rec.b, rec.c, rec.d };
+    int n = field_count(rec.kind);
+    for (int i = 0; i < n; ++i)
+        put_varint(bin_buf_, fields[i]);
+    if (rec.kind == LogKind::REALLOC)
+        put_varint(bin_buf_, rec.moved ? 1 : 0);
+
+    if (bin_buf_.size() >= FLUSH_AT) {
+        bin_.write(bin_buf_.data(), static_cast<std::streamsize>(bin_buf_.size()));
+        bin_buf_.clear();
+    }
+}
+
+// ---------------- Reader ----------------
+
+EventLogReader::EventLogReader(std::istream &in) : in_(in), last_time_(0) {
+    char magic[sizeof(MAGIC)];
+    if (!in_.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+        throw std::runtime_error("EventLogReader: not a memsim event log");
+}
+
+bool EventLogReader::read_varint(uint64_t &v, bool at_record_start) {
+    v = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        int c = in_.get();
+        if (c == std::char_traits<char>::eof()) {
+            if (at_record_start && shift == 0)
+                return false;
+            throw std::runtime_error("EventLogReader: truncated record");
+        }
+        v |= static_cast<uint64_t>(c & 0x7f) << shift;
+        if (!(c & 0x80))
+            return true;
+    }
+    throw std::runtime_error("EventLogReader: bad varint");
+}
+
+bool EventLogReader::next(LogRecord &rec) {
+    int k = in_.get();
+    if (k == std::char_traits<char>::eof())
+        return false;
+    if (k >= static_cast<int>(LogKind::NUM_KINDS))
+        throw std::runtime_error("EventLogReader: unknown record kind");
+
+    rec = LogRecord{};
+    rec.kind = static_cast<LogKind>(k);
+
+    uint64_t zz, v;
+    read_varint(zz, false);
+    int64_t delta = static_cast<int64_t>(zz >> 1) ^ -static_cast<int64_t>(zz & 1);
+    last_time_ += static_cast<uint64_t>(delta);
+    rec.time = last_time_;
+
+    read_varint(v, false);
+    rec.pid = static_cast<uint32_t>(v);
+    read_varint(v, false);
+    rec.tid = static_cast<uint32_t>(v);
+
+    uint64_t *fields[4] = { &rec.a, &rec.b, &rec.c, &rec.d };
+    int n = field_count(rec.kind);
+    for (int i = 0; i < n; ++i)
+        read_varint(*fields[i], false);
+    if (rec.kind == LogKind::REALLOC) {
+        read_varint(v, false);
+        rec.moved = v != 0;
+    }
+    return true;
+}
+
+} // namespace sim
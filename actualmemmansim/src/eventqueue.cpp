@@ -1,4 +1,5 @@
 #include "sim/event.h"
+#include "sim/snapshot.h"
 #include <stdexcept>
 // even though its labeled event queue, its all just trace driven, not event driven, we parse the traces through the parser(workload)
 // then the events get into the event queue via their prioritized sequence.
@@ -13,6 +14,8 @@ bool EventCompare::operator()(const Event &a, const Event &b) const {
 
 EventQueue::EventQueue() : seq_counter_(1) {}
 
+EventQueue::EventQueue(uint64_t first_seq) : seq_counter_(first_seq) {}
+
 void EventQueue::push(Event ev) {
     if (ev.key.seq == 0) ev.key.seq = seq_counter_++;
     pq_.push(std::move(ev));
@@ -60,4 +63,47 @@ uint64_t EventQueue::next_seq() const noexcept {
     return seq_counter_;
 }
 
+// Events come out in pop order, so load() gets the same queue back
+void EventQueue::save(SnapshotWriter &w) const {
+    w.section("queue");
+    w.u64(seq_counter_);
+    w.u64(pq_.size());
+
+    auto copy = pq_;
+    while (!copy.empty()) {
+        const Event &ev = copy.top();
+        w.u64(ev.key.time);
+        w.i64(ev.key.priority);
+        w.u64(ev.key.pid);
+        w.u64(ev.key.seq);
+        w.u64(ev.tid);
+        w.str(ev.type);
+        w.u64(ev.args.size());
+        for (const auto &a : ev.args)
+            w.str(a);
+        w.str(ev.raw_line);
+        copy.pop();
+    }
+}
+
+void EventQueue::load(SnapshotReader &r) {
+    r.section("queue");
+    clear();
+    seq_counter_ = r.u64();
+    for (uint64_t n = r.u64(); n > 0; --n) {
+        Event ev;
+        ev.key.time = r.u64();
+        ev.key.priority = static_cast<int>(r.i64());
+        ev.key.pid = static_cast<uint32_t>(r.u64());
+        ev.key.seq = r.u64();
+        ev.tid = static_cast<uint32_t>(r.u64());
+        ev.type = r.str();
+        ev.args.resize(r.u64());
+        for (auto &a : ev.args)
+            a = r.str();
+        ev.raw_line = r.str();
+        pq_.push(std::move(ev));
+    }
+}
+
 } // namespace sim
@@ -0,0 +1,172 @@
+#include "sim/histogram.h"
+#include "sim/snapshot.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace sim {
+
+static unsigned msb_index(uint64_t v) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - static_cast<unsigned>(__builtin_clzll(v));
+#else
+    unsigned n = 0;
+    while (v >>= 1)
+        ++n;
+    return n;
+#endif
+}
+
+// Bucket layout for S = precision_bits, H = 2^(S-1):
+//   [0, 2^S)            one bucket per value
+//   shift e = 1..64-S   H buckets covering [H << e, H << (e+1))
+
+LatencyHistogram::LatencyHistogram(unsigned precision_bits)
+    : sub_bits_(precision_bits) {
+    if (precision_bits < 2 || precision_bits > 16)
+        throw std::out_of_range("LatencyHistogram: precision_bits must be in [2, 16]");
+
+    uint64_t half = 1ull << (sub_bits_ - 1);
+    counts_.assign((1ull << sub_bits_) + (64 - sub_bits_) * half, 0);
+    reset();
+}
+
+void LatencyHistogram::reset() {
+    std::fill(counts_.begin(), counts_.end(), 0);
+    total_ = 0;
+    min_ = std::numeric_limits<uint64_t>::max();
+    max_ = 0;
+    sum_ = 0;
+}
+
+size_t LatencyHistogram::bucket_of(uint64_t value) const noexcept {
+    uint64_t exact = 1ull << sub_bits_;
+    if (value < exact)
+        return static_cast<size_t>(value);
+
+    unsigned msb = msb_index(value);
+    unsigned shift = msb - sub_bits_ + 1;
+    uint64_t half = exact >> 1;
+    return static_cast<size_t>(exact + (shift - 1) * half + ((value >> shift) - half));
+}
+
+uint64_t LatencyHistogram::bucket_high(size_t idx) const noexcept {
+    uint64_t exact = 1ull << sub_bits_;
+    if (idx < exact)
+        return idx;
+
+    uint64_t half = exact >> 1;
+    uint64_t j = idx - exact;
+    unsigned shift = static_cast<unsigned>(j / half) + 1;
+    uint64_t low = (half + j % half) << shift;
+    return low + ((1ull << shift) - 1);
+}
+
+void LatencyHistogram::record(uint64_t value, uint64_t count) {
+    if (count == 0)
+        return;
+
+    counts_[bucket_of(value)] += count;
+    total_ += count;
+    if (value < min_) min_ = value;
+    if (value > max_) max_ = value;
+    sum_ += static_cast<long double>(value) * count;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other) {
+    if (other.sub_bits_ != sub_bits_)
+        throw std::runtime_error("LatencyHistogram: merge with different precision");
+    if (other.total_ == 0)
+        return;
+
+    for (size_t i = 0; i < counts_.size(); ++i)
+        counts_[i] += other.counts_[i];
+    total_ += other.total_;
+    if (other.min_ < min_) min_ = other.min_;
+    if (other.max_ > max_) max_ = other.max_;
+    sum_ += other.sum_;
+}
+
+uint64_t LatencyHistogram::count() const noexcept {
+    return total_;
+}
+
+uint64_t LatencyHistogram::min() const noexcept {
+    return total_ == 0 ? 0 : min_;
+}
+
+uint64_t LatencyHistogram::max() const noexcept {
+    return max_;
+}
+
+double LatencyHistogram::mean() const noexcept {
+    if (total_ == 0)
+        return 0.0;
+    return static_cast<double>(sum_ / total_);
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    if (total_ == 0)
+        return 0;
+    if (p < 0.0) p = 0.0;
+    if (p > 1.0) p = 1.0;
+
+    uint64_t rank = static_cast<uint64_t>(p * (total_ - 1));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        seen += counts_[i];
+        if (seen > rank) {
+            uint64_t v = bucket_high(i);
+            if (v > max_) v = max_;
+            if (v < min_) v = min_;
+            return v;
+        }
+    }
+    return max_;
+}
+
+unsigned LatencyHistogram::precision_bits() const noexcept {
+    return sub_bits_;
+}
+
+size_t LatencyHistogram::num_buckets() const noexcept {
+    return counts_.size();
+}
+
+// Only non-empty buckets are written
+void LatencyHistogram::save(SnapshotWriter &w) const {
+    w.section("hist");
+    w.u64(sub_bits_);
+    size_t used = counts_.size() - std::count(counts_.begin(), counts_.end(), 0);
+    w.u64(used);
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        if (counts_[i]) {
+            w.u64(i);
+            w.u64(counts_[i]);
+        }
+    }
+    w.u64(total_);
+    w.u64(min_);
+    w.u64(max_);
+    w.real(sum_);
+}
+
+void LatencyHistogram::load(SnapshotReader &r) {
+    r.section("hist");
+    if (r.u64() != sub_bits_)
+        throw std::runtime_error("LatencyHistogram: checkpoint has another precision");
+    std::fill(counts_.begin(), counts_.end(), 0);
+    for (uint64_t n = r.u64(); n > 0; --n) {
+        uint64_t i = r.u64();
+        if (i >= counts_.size())
+            throw std::runtime_error("LatencyHistogram: bad bucket in checkpoint");
+        counts_[i] = r.u64();
+    }
+    total_ = r.u64();
+    min_ = r.u64();
+    max_ = r.u64();
+    sum_ = r.real();
+}
+
+} // namespace sim
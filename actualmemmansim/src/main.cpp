@@ -1,13 +1,20 @@
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <map>
 #include <string>
+#include <thread>
 
-#include "sim/clock.h"
-#include "sim/event.h"
-#include "sim/workload.h"
-#include "sim/MMU.h"
-#include "sim/physicalmem.h"
-#include "sim/scheduler.h"
+#include "sim/config.h"
+#include "sim/eventlog.h"
 #include "sim/metrics.h"
+#include "sim/profile.h"
+#include "sim/sampling.h"
+#include "sim/scheduler.h"
+#include "sim/simulator.h"
+#include "sim/sweep.h"
+#include "sim/timeseries.h"
+#include "sim/workload.h"
 
 using namespace sim;
 
@@ -19,170 +26,593 @@ static uint64_t parse_u64(const std::string &s) {
     return std::stoull(s);
 }
 
-int main(int argc, char **argv) {
-    if (argc < 2) {
-        std::cerr << "usage: memsim <trace.csv>\n";
-        return 1;
+// End-of-run report
+static void print_summary(std::ostream &os, const Metrics &metrics,
+                          const SimConfig &cfg, uint64_t now) {
+    os << "\nSimulation complete\n";
+    os << "Total page faults: " << metrics.page_faults() << "\n";
+
+    os << "\nFinal heap metrics:\n";
+    os << "  allocated_bytes = " << metrics.allocated_bytes() << "\n";
+    os << "  free_bytes      = " << metrics.free_bytes() << "\n";
+    os << "  largest_free    = " << metrics.largest_free_block() << "\n";
+    os << "  internal_frag   = " << metrics.internal_fragmentation() << "\n";
+    os << "  external_frag   = " << metrics.external_fragmentation() << "\n";
+
+    if (cfg.heap_release != HeapReleasePolicy::NONE) {
+        os << "\nHeap page release:\n";
+        os << "  pages_released  = " << metrics.pages_released() << "\n";
+        os << "  lazy_reclaimed  = " << metrics.lazy_reclaims() << "\n";
+        os << "  refaults        = " << metrics.refaults() << "\n";
+        os << "  refault_cycles  = " << metrics.refaults() * cfg.pagein_latency << "\n";
     }
 
-    // ---------------- Core ----------------
-    Clock clock;
-    EventQueue eq;
-    Workload wl(argv[1]);
+    if (metrics.reallocs_in_place() + metrics.realloc_moves() + metrics.callocs() != 0) {
+        os << "\nRealloc / calloc:\n";
+        os << "  in_place        = " << metrics.reallocs_in_place() << "\n";
+        os << "  moved           = " << metrics.realloc_moves() << "\n";
+        os << "  copy_bytes      = " << metrics.realloc_copy_bytes() << "\n";
+        os << "  callocs         = " << metrics.callocs() << "\n";
+        os << "  zeroed_pages    = " << metrics.calloc_zeroed_pages() << "\n";
+        os << "  zero_fill_pages = " << metrics.calloc_zero_fill_pages() << "\n";
+    }
 
-    if (!wl.parse_into(eq)) {
-        std::cerr << "Trace parse failed\n";
-        return 1;
+    if (cfg.heap.tcache_batch != 0) {
+        os << "\nThread caches:\n";
+        os << "  hits            = " << metrics.tcache_hits() << "\n";
+        os << "  misses          = " << metrics.tcache_misses() << "\n";
+        os << "  hit_rate        = " << metrics.tcache_hit_rate() << "\n";
+        os << "  central_ops     = " << metrics.central_ops() << "\n";
+        os << "  cross_frees     = " << metrics.cross_thread_frees() << "\n";
+        os << "  stranded_bytes  = " << metrics.stranded_bytes() << "\n";
+        os << "  peak_stranded   = " << metrics.peak_stranded_bytes() << "\n";
     }
 
-    constexpr uint64_t PAGE_SIZE = 4096;
-    constexpr size_t   NUM_FRAMES = 4;
-    constexpr uint64_t PAGEIN_LATENCY = 10;
+    if (cfg.heap.brk_grow_step != 0 || cfg.heap.mmap_threshold != 0) {
+        os << "\nHeap growth:\n";
+        os << "  brk_grows       = " << metrics.brk_grows() << "\n";
+        os << "  mmaps           = " << metrics.mmaps() << "\n";
+        os << "  munmaps         = " << metrics.munmaps() << "\n";
+        os << "  peak_mmap_bytes = " << metrics.peak_mmap_bytes() << "\n";
+    }
 
-    PhysicalMemory pmem(NUM_FRAMES);
-    constexpr size_t TLB_SIZE = 16;
-    Metrics metrics;
-    MMU mmu(pmem, PAGE_SIZE, TLB_SIZE, metrics);
-    Scheduler sched;
+    if (metrics.num_slots() > 1) {
+        os << "\nPer process:\n";
+        for (uint32_t i = 0; i < metrics.num_slots(); ++i) {
+            const auto &s = metrics.slot(i);
+            os << "  pid=" << s.pid
+                      << " faults=" << s.page_faults
+                      << " (heap=" << s.faults_by_region[REGION_HEAP]
+                      << " mmap=" << s.faults_by_region[REGION_MMAP]
+                      << " other=" << s.faults_by_region[REGION_OTHER] << ")"
+                      << " evicted=" << s.evictions
+                      << " tlb_hit_rate=" << s.tlb_hit_rate()
+                      << " heap_allocated=" << s.allocated_bytes
+                      << " external_frag=" << s.external_fragmentation()
+                      << " peak_rss=" << s.peak_rss
+                      << " steady_rss=" << s.steady_rss(now)
+                      << "\n";
+        }
+    }
 
-    size_t page_faults = 0;
+    // Accesses queue per process and wait for the CPU and for page-ins
+    if (metrics.stream_accesses() != 0) {
+        uint64_t n = metrics.stream_accesses();
+        uint64_t span = metrics.stream_makespan();
+        os << "\nAccess streams:\n";
+        os << "  accesses        = " << n << "\n";
+        os << "  stall_cycles    = " << metrics.stall_cycles()
+           << " (mean " << double(metrics.stall_cycles()) / double(n) << ")\n";
+        os << "  service_cycles  = " << metrics.service_cycles()
+           << " (mean " << double(metrics.service_cycles()) / double(n) << ")\n";
+        os << "  makespan        = " << span << "\n";
+        os << "  throughput      = " << (span ? 1000.0 * double(n) / double(span) : 0.0)
+           << " per 1000 cycles\n";
+        for (uint32_t i = 0; i < metrics.num_slots(); ++i) {
+            const auto &s = metrics.slot(i);
+            if (s.stream_accesses == 0)
+                continue;
+            os << "  pid=" << s.pid
+               << " accesses=" << s.stream_accesses
+               << " stall=" << s.stall_cycles
+               << " service=" << s.service_cycles
+               << " finish=" << s.finish
+               << " slowdown=" << s.slowdown()
+               << "\n";
+        }
+    }
 
-    std::cout << "\nStarting simulation\n\n";
+    const auto &lat = metrics.latency();
+    os << "\nAccess latency (cycles):\n";
+    os << "  samples         = " << lat.count() << "\n";
+    os << "  mean            = " << lat.mean() << "\n";
+    os << "  p50             = " << metrics.latency_p50() << "\n";
+    os << "  p90             = " << metrics.latency_p90() << "\n";
+    os << "  p99             = " << metrics.latency_p99() << "\n";
+    os << "  max             = " << lat.max() << "\n";
+
+    os << "\nResident set (frames):\n";
+    os << "  peak            = " << metrics.peak_resident_frames() << "\n";
+    os << "  steady_state    = " << metrics.avg_resident_frames(now) << "\n";
+    os << "  final           = " << metrics.resident_frames() << "\n";
+}
 
-    // ---------------- Event loop ----------------
-    while (!eq.empty()) {
-        Event ev = eq.pop();
+// Where CPU time went, when the policy or switch costs make it matter
+static void print_scheduler(std::ostream &os, const Scheduler &sched,
+                            const SimConfig &cfg, uint64_t now) {
+    os << "\nScheduler (" << sched_policy_name(cfg.sched);
+    if (cfg.sched != SchedPolicy::FIFO)
+        os << ", quantum=" << cfg.quantum;
+    os << ", tlb=" << tlb_switch_name(cfg.tlb_switch) << "):\n";
+    os << "  switches        = " << sched.switches() << "\n";
+    os << "  switch_cycles   = " << sched.switch_cycles() << "\n";
+    os << "  preemptions     = " << sched.preemptions() << "\n";
+    for (const auto &p : sched.stats(now)) {
+        os << "  pid=" << p.first
+           << " cpu=" << p.second.cpu
+           << " wait=" << p.second.wait
+           << " blocked=" << p.second.blocked
+           << " idle=" << p.second.idle
+           << " switches=" << p.second.switches
+           << " preempted=" << p.second.preemptions;
+        if (cfg.cores > 1)
+            os << " migrated=" << p.second.migrations;
+        os << "\n";
+    }
+}
 
-        if (ev.key.time > clock.now())
-            clock.set(ev.key.time);
+// Per-core TLBs and what shootdowns cost them
+static void print_cores(std::ostream &os, const MMU &mmu, const Scheduler &sched,
+                        const Metrics &metrics, const SimConfig &cfg) {
+    os << "\nCores (" << cfg.cores << ", shootdown_latency=" << cfg.shootdown_latency << "):\n";
+    os << "  shootdowns      = " << metrics.shootdowns() << "\n";
+    os << "  ipis            = " << metrics.shootdown_ipis() << "\n";
+    os << "  stall_cycles    = " << metrics.shootdown_stall_cycles() << "\n";
+    os << "  migrations      = " << sched.migrations() << "\n";
+    for (uint32_t c = 0; c < cfg.cores; ++c) {
+        os << "  core=" << c
+           << " tlb_hit_rate=" << mmu.tlb(c).hit_rate()
+           << " ipis_received=" << mmu.shootdowns_received(c)
+           << "\n";
+    }
+}
 
-        uint32_t pid = ev.key.pid;
+// Where accesses found their pages, per node of the accessing core
+static void print_numa(std::ostream &os, const PhysicalMemory &pmem,
+                       const Metrics &metrics, const SimConfig &cfg) {
+    os << "\nNUMA (" << cfg.numa_nodes << " nodes, " << numa_policy_name(cfg.numa_policy);
+    if (cfg.numa_policy == NumaPolicy::BIND)
+        os << " " << cfg.numa_bind;
+    os << "):\n";
+    uint64_t local = 0, remote = 0;
+    for (uint32_t n = 0; n < cfg.numa_nodes; ++n) {
+        local += metrics.numa_local(n);
+        remote += metrics.numa_remote(n);
+    }
+    os << "  local_accesses  = " << local << "\n";
+    os << "  remote_accesses = " << remote << "\n";
+    os << "  migrations      = " << metrics.numa_migrations() << "\n";
+    os << "  migrate_failed  = " << metrics.numa_migrate_failed() << "\n";
+    for (uint32_t n = 0; n < cfg.numa_nodes; ++n) {
+        os << "  node=" << n
+           << " frames=" << pmem.node_frames(n)
+           << " used=" << pmem.used_frames(n)
+           << " local=" << metrics.numa_local(n)
+           << " remote=" << metrics.numa_remote(n)
+           << "\n";
+    }
+}
 
-        // ---------- PROCESS START ----------
-        if (ev.type == "PROC_START") {
-            uint64_t heap_base = parse_u64(ev.args[0]);
-            uint64_t heap_top  = parse_u64(ev.args[1]);
-            uint64_t heap_size = heap_top - heap_base;
+// Per cache level: data references and page-walk PTE reads
+static void print_caches(std::ostream &os, const CacheHierarchy &caches,
+                         const SimConfig &cfg) {
+    os << "\nCaches (line=" << cfg.cache_line << ", " << cache_policy_name(cfg.cache_policy)
+       << ", walk_levels=" << cfg.walk_levels << ", mem_latency=" << cfg.mem_latency << "):\n";
+    for (const auto &l : caches.levels()) {
+        os << "  " << l.name
+           << " size=" << l.geometry.size
+           << " ways=" << l.geometry.ways
+           << " latency=" << l.geometry.latency
+           << (l.shared ? " shared" : " per-core")
+           << " data=" << l.hits[0] << "/" << l.hits[0] + l.misses[0]
+           << " walk=" << l.hits[1] << "/" << l.hits[1] + l.misses[1]
+           << " hit_rate=" << l.hit_rate()
+           << "\n";
+    }
+    os << "  memory_data     = " << caches.memory_refs(CacheRef::DATA) << "\n";
+    os << "  memory_walk     = " << caches.memory_refs(CacheRef::WALK) << "\n";
+}
 
-            mmu.register_process(pid, heap_base, heap_size);
-            sched.add_process(pid);
+// Frames each process held on to, and what load control did about it
+static void print_resident_sets(std::ostream &os, const Metrics &metrics,
+                                const Scheduler &sched, const SimConfig &cfg,
+                                uint64_t now) {
+    os << "\nResident sets (" << frame_policy_name(cfg.frame_policy);
+    if (cfg.frame_policy == FramePolicy::LOCAL) {
+        if (cfg.frame_budget)
+            os << ", budget=" << cfg.frame_budget;
+        else
+            os << ", budget=share";
+    } else if (cfg.frame_policy == FramePolicy::WS) {
+        os << ", window=" << cfg.ws_window;
+    } else {
+        os << ", interval=" << cfg.pff_interval;
+    }
+    os << "):\n";
+    os << "  trimmed         = " << metrics.trimmed_pages() << "\n";
+    os << "  suspensions     = " << metrics.suspensions() << "\n";
+    os << "  swapped_out     = " << metrics.swapped_out_pages() << "\n";
+    os << "  resumes         = " << metrics.resumes() << "\n";
+
+    std::map<uint32_t, uint64_t> suspended;
+    for (const auto &p : sched.stats(now))
+        suspended[p.first] = p.second.suspended;
+    for (uint32_t i = 0; i < metrics.num_slots(); ++i) {
+        const auto &s = metrics.slot(i);
+        os << "  pid=" << s.pid
+           << " faults=" << s.page_faults
+           << " evicted=" << s.evictions
+           << " trimmed=" << s.trimmed
+           << " suspended=" << s.suspensions
+           << " swapped_out=" << s.swapped_out
+           << " suspended_cycles=" << suspended[s.pid]
+           << "\n";
+    }
+}
 
-            std::cout << "[t=" << clock.now()
-                      << "] PROC_START pid=" << pid << "\n";
-        }
+// Eviction inline at faults against kswapd's background passes
+static void print_reclaim(std::ostream &os, const Metrics &metrics, const SimConfig &cfg) {
+    os << "\nReclaim (watermarks ";
+    if (cfg.watermark_low)
+        os << cfg.watermark_low << "/" << cfg.watermark_high << ", batch=" << cfg.kswapd_batch;
+    else
+        os << "off";
+    os << ", reclaim_latency=" << cfg.reclaim_latency << "):\n";
+    os << "  direct_reclaims = " << metrics.direct_reclaims() << "\n";
+    os << "  direct_stall    = " << metrics.direct_reclaim_stall() << "\n";
+    os << "  kswapd_wakeups  = " << metrics.kswapd_wakeups() << "\n";
+    os << "  kswapd_passes   = " << metrics.kswapd_batches() << "\n";
+    os << "  kswapd_pages    = " << metrics.kswapd_pages() << "\n";
+    os << "  fault_service   = " << metrics.mean_fault_service() << " (mean cycles)\n";
+}
 
-        // ---------- PROCESS EXIT ----------
-        else if (ev.type == "PROC_EXIT") {
-            mmu.unregister_process(pid);
-            sched.terminate_process(pid);
+// Compressed pool against swap: where page-ins came from, and how much
+// memory the pool's compression bought at its fullest
+static void print_zswap(std::ostream &os, const ZswapPool &pool, const Metrics &metrics,
+                        const SimConfig &cfg) {
+    double frames = static_cast<double>(cfg.num_frames);
+    double pool_frames = static_cast<double>(pool.peak_bytes()) /
+                         static_cast<double>(cfg.page_size);
+    double expansion = (frames + static_cast<double>(pool.peak_pages())) /
+                       (frames + pool_frames);
+
+    os << "\nZswap (pool=" << pool.capacity() << " bytes, compress="
+       << cfg.zswap_compress_latency << ", decompress=" << cfg.zswap_decompress_latency
+       << ", swap=" << cfg.pagein_latency << "):\n";
+    os << "  stores          = " << pool.stores() << "\n";
+    os << "  rejects_full    = " << pool.rejects_full() << "\n";
+    os << "  rejects_incomp  = " << pool.rejects_incompressible() << "\n";
+    os << "  pool_ratio      = " << pool.mean_ratio() << "\n";
+    os << "  peak_pages      = " << pool.peak_pages() << " (" << pool.peak_bytes() << " bytes)\n";
+    os << "  expansion       = " << expansion << "x\n";
+    os << "  pageins_zswap   = " << metrics.pageins(PAGEIN_ZSWAP) << "\n";
+    os << "  pageins_swap    = " << metrics.pageins(PAGEIN_SWAP) << "\n";
+    os << "  pageins_zero    = " << metrics.pageins(PAGEIN_ZERO) << "\n";
+}
 
-            std::cout << "[t=" << clock.now()
-                      << "] PROC_EXIT pid=" << pid << "\n";
-        }
+// Swap layout: how clustered the slots stayed and how many swap-ins the
+// swap cache and readahead saved
+static void print_swap(std::ostream &os, const SwapArea &swap, const Metrics &metrics,
+                       const SimConfig &cfg) {
+    uint64_t swapins = metrics.pageins(PAGEIN_SWAP) + metrics.pageins(PAGEIN_SWAP_CACHE);
+    double hit_rate = swapins ? static_cast<double>(metrics.pageins(PAGEIN_SWAP_CACHE)) /
+                                static_cast<double>(swapins) : 0.0;
+    double ra_accuracy = swap.readahead_pages()
+                       ? static_cast<double>(swap.readahead_hits()) /
+                         static_cast<double>(swap.readahead_pages()) : 0.0;
+
+    os << "\nSwap area (slots=" << swap.slots() << ", cluster=" << cfg.swap_cluster
+       << ", readahead=" << cfg.swap_readahead << ", cache=" << cfg.swap_cache << "):\n";
+    os << "  writes          = " << swap.writes() << "\n";
+    os << "  new_clusters    = " << swap.new_clusters() << "\n";
+    os << "  fragmented      = " << swap.fragmented() << "\n";
+    os << "  no_slot         = " << swap.full() << "\n";
+    os << "  peak_used       = " << swap.peak_used() << "\n";
+    os << "  swapins         = " << swapins << "\n";
+    os << "  swapin_io       = " << swap.reads() << "\n";
+    os << "  cache_hits      = " << swap.cache_hits() << " (rate " << hit_rate << ")\n";
+    os << "  readahead_pages = " << swap.readahead_pages() << "\n";
+    os << "  readahead_hits  = " << swap.readahead_hits() << " (accuracy " << ra_accuracy << ")\n";
+}
 
-        // ---------- MALLOC ----------
-        else if (ev.type == "MALLOC") {
-            auto &proc = mmu.process(pid);
-            uint64_t size = parse_u64(ev.args[0]);
+// Per memory cgroup: frames charged, limits and what reclaim took
+static void print_cgroups(std::ostream &os, const CgroupTree &cgroups) {
+    os << "\nCgroups (frames; max/low 0 = none):\n";
+    for (const auto &g : cgroups.groups()) {
+        os << "  " << (g.path.empty() ? "/" : g.path)
+           << " usage=" << g.usage
+           << " peak=" << g.peak
+           << " max=" << g.max
+           << " low=" << g.low
+           << " faults=" << g.faults
+           << " limit_faults=" << g.limit_faults
+           << " limit_fault_rate=" << g.limit_fault_rate()
+           << " reclaimed=" << g.reclaimed
+           << " evicted=" << g.evicted
+           << " low_breaches=" << g.low_breaches
+           << "\n";
+    }
+}
 
-            auto addr = proc.heap_alloc(size);
-            if (!addr) {
-                std::cerr << "MALLOC failed pid=" << pid << "\n";
-                continue;
-            }
+static void usage() {
+    std::cerr << "usage: memsim <trace.csv> [--config=FILE] [--dump-config]\n"
+              << "                          [--page-size=N] [--frames=N] [--tlb-size=N]\n"
+              << "                          [--tlb-hit-latency=N] [--pt-hit-latency=N]\n"
+              << "                          [--fault-latency=N] [--pagein-latency=N]\n"
+              << "                          [--heap-release=none|dontneed|free]\n"
+              << "                          [--brk-grow=BYTES] [--mmap-threshold=BYTES]\n"
+              << "                          [--tcache-batch=N]\n"
+              << "                          [--sched=fifo|rr|cfs] [--quantum=N]\n"
+              << "                          [--ctx-switch-latency=N] [--tlb-switch=asid|flush]\n"
+              << "                          [--cores=N] [--shootdown-latency=N]\n"
+              << "                          [--numa-nodes=N] [--numa-distance=10,20;20,10]\n"
+              << "                          [--numa-policy=first-touch|interleave|bind]\n"
+              << "                          [--numa-bind=NODE] [--numa-latency=N]\n"
+              << "                          [--numa-sample=N] [--numa-migrate-latency=N]\n"
+              << "                          [--l1=SIZE,WAYS,LAT] [--l2=...] [--llc=...]\n"
+              << "                          [--cache-line=N] [--cache-policy=lru|plru]\n"
+              << "                          [--mem-latency=N] [--walk-levels=N]\n"
+              << "                          [--frame-policy=global|local|ws|pff] [--frame-budget=N]\n"
+              << "                          [--ws-window=N] [--pff-interval=N]\n"
+              << "                          [--watermark-low=N --watermark-high=N] [--kswapd-batch=N]\n"
+              << "                          [--reclaim-latency=N]\n"
+              << "                          [--cgroups=PATH:max=N,low=N;...]\n"
+              << "                          [--zswap-pool=BYTES] [--zswap-ratio=R:W,...]\n"
+              << "                          [--zswap-compress-latency=N]\n"
+              << "                          [--zswap-decompress-latency=N]\n"
+              << "                          [--swap-slots=N] [--swap-cluster=N]\n"
+              << "                          [--swap-readahead=N] [--swap-cache=N]\n"
+              << "                          [--swap-cache-latency=N]\n"
+              << "                          [--timeseries=FILE --interval-cycles=N|--interval-events=N]\n"
+              << "                          [--profile[=hw]] [--log=off|summary|faults|all]\n"
+              << "                          [--event-log=FILE]\n"
+              << "                          [--sweep=KEY=V1,V2,... ...] [--jobs=N]\n"
+              << "                          [--checkpoint=FILE --checkpoint-at=CYCLES|--checkpoint-events=N\n"
+              << "                           [--checkpoint-stop]] [--restore=FILE]\n"
+              << "                          [--sample-period=N --sample-window=N [--sample-warmup=N]]\n";
+}
 
-            metrics.update_heap(
-                proc.heap().total_heap_size(),
-                proc.heap().allocated_bytes(),
-                proc.heap().free_bytes(),
-                proc.heap().largest_free_block(),
-                proc.heap().internal_fragmentation()
-            );
-
-            std::cout << "[t=" << clock.now()
-                      << "] MALLOC pid=" << pid
-                      << " size=" << size
-                      << " → addr=0x" << std::hex << *addr << std::dec
-                      << "\n";
+// "--name=value" → value, if opt starts with "--name="
+static bool option_value(const std::string &opt, const std::string &name,
+                         std::string &value) {
+    std::string prefix = "--" + name + "=";
+    if (opt.compare(0, prefix.size(), prefix) != 0)
+        return false;
+    value = opt.substr(prefix.size());
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+
+    SimConfig cfg;
+    bool dump_config = false;
+    TimeSeriesConfig ts_cfg;
+    std::string ts_path;
+    LogLevel log_level = LogLevel::ALL;
+    std::string event_log_path;
+    std::vector<SweepAxis> sweep_axes;
+    unsigned jobs = std::thread::hardware_concurrency();
+    CheckpointConfig ckpt;
+    std::string restore_path;
+    SampleConfig sample_cfg;
+    for (int i = 2; i < argc; ++i) {
+        std::string opt = argv[i];
+        std::string val;
+        try {
+            if (option_value(opt, "config", val))
+                load_config_file(val, cfg);
+            else if (opt == "--dump-config")
+                dump_config = true;
+            else if (opt == "--log=off")
+                log_level = LogLevel::OFF;
+            else if (opt == "--log=summary")
+                log_level = LogLevel::SUMMARY;
+            else if (opt == "--log=faults")
+                log_level = LogLevel::FAULTS;
+            else if (opt == "--log=all")
+                log_level = LogLevel::ALL;
+            else if (option_value(opt, "event-log", val))
+                event_log_path = val;
+            else if (option_value(opt, "sweep", val))
+                sweep_axes.push_back(parse_sweep_axis(val));
+            else if (option_value(opt, "jobs", val))
+                jobs = static_cast<unsigned>(parse_u64(val));
+            else if (option_value(opt, "checkpoint", val))
+                ckpt.path = val;
+            else if (option_value(opt, "checkpoint-at", val))
+                ckpt.at_cycles = parse_u64(val);
+            else if (option_value(opt, "checkpoint-events", val))
+                ckpt.at_events = parse_u64(val);
+            else if (opt == "--checkpoint-stop")
+                ckpt.stop = true;
+            else if (option_value(opt, "restore", val))
+                restore_path = val;
+            else if (option_value(opt, "sample-period", val))
+                sample_cfg.period = parse_u64(val);
+            else if (option_value(opt, "sample-window", val))
+                sample_cfg.window = parse_u64(val);
+            else if (option_value(opt, "sample-warmup", val))
+                sample_cfg.warmup = parse_u64(val);
+            else if (opt == "--profile")
+                Profiler::enable(false);
+            else if (opt == "--profile=hw")
+                Profiler::enable(true);
+            else if (option_value(opt, "timeseries", val))
+                ts_path = val;
+            else if (option_value(opt, "interval-cycles", val))
+                ts_cfg.every_cycles = parse_u64(val);
+            else if (option_value(opt, "interval-events", val))
+                ts_cfg.every_events = parse_u64(val);
+            else if (opt.compare(0, 2, "--") != 0 || opt.find('=') == std::string::npos ||
+                     !cfg.set(opt.substr(2, opt.find('=') - 2), opt.substr(opt.find('=') + 1))) {
+                std::cerr << "unknown option: " << opt << "\n";
+                usage();
+                return 1;
+            }
+        } catch (const std::runtime_error &e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        } catch (const std::invalid_argument &e) {
+            // Our own messages name the module; std::stoull's do not
+            std::string what = e.what();
+            if (what.find(':') == std::string::npos)
+                what = "bad value in option: " + opt;
+            std::cerr << what << "\n";
+            return 1;
+        } catch (...) {
+            std::cerr << "bad value in option: " << opt << "\n";
+            return 1;
         }
+    }
 
-        // ---------- FREE ----------
-        else if (ev.type == "FREE") {
-            auto &proc = mmu.process(pid);
-            uint64_t addr = parse_u64(ev.args[0]);
+    try {
+        cfg.validate();
+        sample_cfg.validate();
+    } catch (const std::invalid_argument &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    if (dump_config)
+        write_config(std::cerr, cfg);
 
-            proc.heap_free(addr);
+    // A sweep prints only its table; per-run outputs would collide
+    if (!sweep_axes.empty() &&
+        (!ts_path.empty() || !event_log_path.empty() || Profiler::enabled())) {
+        std::cerr << "--sweep cannot be combined with --timeseries, --event-log or --profile\n";
+        return 1;
+    }
+    // Sampling changes what the summary means; a sweep table has no room
+    // for intervals
+    if (sample_cfg.period != 0 && !sweep_axes.empty()) {
+        std::cerr << "--sample-period cannot be combined with --sweep\n";
+        return 1;
+    }
+    if (!ckpt.path.empty() && !sweep_axes.empty()) {
+        std::cerr << "--checkpoint cannot be combined with --sweep\n";
+        return 1;
+    }
+    if (!restore_path.empty() && !ts_path.empty()) {
+        std::cerr << "--restore cannot be combined with --timeseries\n";
+        return 1;
+    }
 
-            metrics.update_heap(
-                proc.heap().total_heap_size(),
-                proc.heap().allocated_bytes(),
-                proc.heap().free_bytes(),
-                proc.heap().largest_free_block(),
-                proc.heap().internal_fragmentation()
-            );
+    std::string snapshot;
+    if (!restore_path.empty()) {
+        std::ifstream in(restore_path, std::ios::binary);
+        if (!in) {
+            std::cerr << "cannot open " << restore_path << "\n";
+            return 1;
+        }
+        snapshot.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
 
-            std::cout << "[t=" << clock.now()
-                      << "] FREE pid=" << pid
-                      << " addr=0x" << std::hex << addr << std::dec
-                      << "\n";
+    if (ts_path.empty() != (ts_cfg.every_cycles == 0 && ts_cfg.every_events == 0)) {
+        std::cerr << "--timeseries needs --interval-cycles or --interval-events (and vice versa)\n";
+        return 1;
+    }
+    std::ofstream ts_out;
+    if (!ts_path.empty()) {
+        ts_out.open(ts_path);
+        if (!ts_out) {
+            std::cerr << "cannot open " << ts_path << "\n";
+            return 1;
         }
+    }
 
-        // ---------- ACCESS ----------
-        else if (ev.type == "ACCESS") {
-            auto running = sched.schedule_next();
-            if (!running)
-                continue;
+    EventLog log(std::cout, std::cerr, log_level);
+    if (!event_log_path.empty() && !log.open_binary(event_log_path)) {
+        std::cerr << "cannot open " << event_log_path << "\n";
+        return 1;
+    }
 
-            uint64_t vaddr = parse_u64(ev.args[0]);
-            auto res = mmu.access(*running, vaddr);
-
-            if (res == MMUAccessResult::HIT) {
-                std::cout << "[t=" << clock.now()
-                          << "] ACCESS pid=" << *running
-                          << " vaddr=0x" << std::hex << vaddr << std::dec
-                          << " (hit)\n";
-            } else {
-                ++page_faults;
-                sched.block_current();
-
-                uint64_t vpn = mmu.vpn_from_vaddr(vaddr);
-                eq.push(clock.now() + PAGEIN_LATENCY,
-                        0,
-                        *running,
-                        "PAGEIN_COMPLETE",
-                        { std::to_string(vpn) });
-
-                std::cout << "[t=" << clock.now()
-                          << "] PAGE_FAULT pid=" << *running
-                          << " vpn=" << vpn
-                          << " → BLOCKED\n";
-            }
-        }
+    // ---------------- Core ----------------
+    Trace trace;
+    Workload wl(argv[1]);
 
-        // ---------- PAGEIN COMPLETE ----------
-        else if (ev.type == "PAGEIN_COMPLETE") {
-            uint64_t vpn = std::stoull(ev.args[0]);
+    if (!wl.parse_into(trace)) {
+        std::cerr << "Trace parse failed\n";
+        return 1;
+    }
 
-            mmu.complete_pagein(pid, vpn, clock.now());
-            sched.wake_process(pid);
+    // ---------------- Sweep ----------------
+    if (!sweep_axes.empty()) {
+        try {
+            auto points = expand_sweep(cfg, sweep_axes);
+            run_sweep(trace, sweep_axes, points, jobs, std::cout, snapshot);
+        } catch (const std::invalid_argument &e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+        return 0;
+    }
 
-            std::cout << "[t=" << clock.now()
-                      << "] PAGEIN_COMPLETE pid=" << pid
-                      << " vpn=" << vpn
-                      << " → READY\n";
+    Simulator sim(cfg, trace, log);
+    if (!ts_path.empty())
+        sim.enable_timeseries(ts_out, ts_cfg);
+    if (sample_cfg.period != 0)
+        sim.enable_sampling(sample_cfg);
+    sim.set_checkpoint(ckpt);
+    if (!snapshot.empty()) {
+        try {
+            sim.restore(snapshot);
+        } catch (const std::runtime_error &e) {
+            std::cerr << restore_path << ": " << e.what() << "\n";
+            return 1;
         }
     }
 
+    if (log_level >= LogLevel::SUMMARY)
+        std::cout << "\nStarting simulation\n\n";
+
+    sim.run();
+
     // ---------------- Summary ----------------
-    std::cout << "\nSimulation complete\n";
-    std::cout << "Total page faults: " << page_faults << "\n";
-
-    std::cout << "\nFinal heap metrics:\n";
-    std::cout << "  allocated_bytes = " << metrics.allocated_bytes() << "\n";
-    std::cout << "  free_bytes      = " << metrics.free_bytes() << "\n";
-    std::cout << "  largest_free    = " << metrics.largest_free_block() << "\n";
-    std::cout << "  internal_frag   = " << metrics.internal_fragmentation() << "\n";
-    std::cout << "  external_frag   = " << metrics.external_fragmentation() << "\n";
+    log.flush();
+    if (sim.checkpoint_pending())
+        std::cerr << "warning: trace ended before the checkpoint point, "
+                  << ckpt.path << " not written\n";
+    if (log_level >= LogLevel::SUMMARY) {
+        print_summary(std::cout, sim.metrics(), cfg, sim.now());
+        if (cfg.sched != SchedPolicy::FIFO || cfg.ctx_switch_latency != 0 ||
+            cfg.tlb_switch == TlbSwitchPolicy::FLUSH || cfg.cores > 1)
+            print_scheduler(std::cout, sim.scheduler(), cfg, sim.now());
+        if (cfg.cores > 1)
+            print_cores(std::cout, sim.mmu(), sim.scheduler(), sim.metrics(), cfg);
+        if (cfg.numa_nodes > 1)
+            print_numa(std::cout, sim.memory(), sim.metrics(), cfg);
+        if (cfg.caches())
+            print_caches(std::cout, sim.mmu().caches(), cfg);
+        if (cfg.watermark_low != 0 || cfg.reclaim_latency != 0)
+            print_reclaim(std::cout, sim.metrics(), cfg);
+        if (sim.mmu().zswap().enabled())
+            print_zswap(std::cout, sim.mmu().zswap(), sim.metrics(), cfg);
+        if (sim.mmu().swap().enabled())
+            print_swap(std::cout, sim.mmu().swap(), sim.metrics(), cfg);
+        if (sim.mmu().cgroups().groups().size() > 1)
+            print_cgroups(std::cout, sim.mmu().cgroups());
+        if (cfg.frame_policy != FramePolicy::GLOBAL)
+            print_resident_sets(std::cout, sim.metrics(), sim.scheduler(), cfg, sim.now());
+        if (sim.sampler())
+            sim.sampler()->report(std::cout);
+    }
+
+    std::cout.flush();
+    Profiler::set_events(sim.events_handled());
+    Profiler::report(std::cerr);
 
     return 0;
 }
@@ -1,6 +1,8 @@
 #include "sim/metrics.h"
+#include "sim/snapshot.h"
 
 #include <algorithm>
+#include <stdexcept>
 // calculates the metrics.
 namespace sim {
 
@@ -9,96 +11,638 @@ Metrics::Metrics() {
 }
 
 void Metrics::reset() {
-    total_heap_ = 0;
-    allocated_bytes_ = 0;
-    free_bytes_ = 0;
-    largest_free_block_ = 0;
-    internal_frag_bytes_ = 0;
+    slots_.clear();
 
-    tlb_hits_ = 0;
-    tlb_misses_ = 0;
+    reallocs_in_place_ = 0;
+    realloc_moves_ = 0;
+    realloc_copy_bytes_ = 0;
+    callocs_ = 0;
+    calloc_zeroed_pages_ = 0;
+    calloc_zero_fill_pages_ = 0;
 
-    latencies_.clear();
+    tcache_hits_ = 0;
+    tcache_misses_ = 0;
+    central_ops_ = 0;
+    cross_thread_frees_ = 0;
+    stranded_bytes_ = 0;
+    peak_stranded_bytes_ = 0;
+
+    shootdowns_ = 0;
+    shootdown_ipis_ = 0;
+    shootdown_stall_cycles_ = 0;
+
+    numa_local_.clear();
+    numa_remote_.clear();
+    numa_migrations_ = 0;
+    numa_migrate_failed_ = 0;
+
+    pages_released_ = 0;
+    lazy_reclaims_ = 0;
+    refaults_ = 0;
+    resident_frames_ = 0;
+    peak_resident_frames_ = 0;
+    resident_since_ = 0;
+    resident_area_ = 0;
+    rss_dirty_.clear();
+
+    direct_reclaims_ = 0;
+    direct_reclaim_stall_ = 0;
+    kswapd_wakeups_ = 0;
+    kswapd_batches_ = 0;
+    kswapd_pages_ = 0;
+    fault_services_ = 0;
+    fault_service_cycles_ = 0;
+    pageins_zero_ = 0;
+    pageins_zswap_ = 0;
+    pageins_swap_ = 0;
+    pageins_swap_cache_ = 0;
+
+    brk_grows_ = 0;
+    mmaps_ = 0;
+    munmaps_ = 0;
+    mmap_bytes_ = 0;
+    peak_mmap_bytes_ = 0;
+
+    latency_.reset();
+}
+
+// ---------------- Per-process slots ----------------
+
+double ProcessMetrics::external_fragmentation() const noexcept {
+    if (free_bytes == 0) return 0.0;
+    return 1.0 - (double(largest_free_block) / double(free_bytes));
+}
+
+double ProcessMetrics::tlb_hit_rate() const noexcept {
+    uint64_t total = tlb_hits + tlb_misses;
+    if (total == 0) return 0.0;
+    return double(tlb_hits) / double(total);
+}
+
+uint32_t Metrics::open_slot(uint32_t pid) {
+    slots_.emplace_back();
+    slots_.back().pid = pid;
+    return static_cast<uint32_t>(slots_.size() - 1);
+}
+
+void Metrics::close_slot(uint32_t slot) {
+    slots_.at(slot).live = false;
+}
+
+size_t Metrics::num_slots() const noexcept {
+    return slots_.size();
+}
+
+const ProcessMetrics& Metrics::slot(uint32_t slot) const {
+    if (slot >= slots_.size())
+        throw std::out_of_range("Metrics: bad process slot");
+    return slots_[slot];
 }
 
 // ---------------- Heap ----------------
 
-void Metrics::update_heap(uint64_t total_heap,
+void Metrics::update_heap(uint32_t slot,
+                          uint64_t total_heap,
                           uint64_t allocated,
                           uint64_t free,
                           uint64_t largest_free,
                           uint64_t internal_frag) {
-    total_heap_ = total_heap;
-    allocated_bytes_ = allocated;
-    free_bytes_ = free;
-    largest_free_block_ = largest_free;
-    internal_frag_bytes_ = internal_frag;
+    auto &s = slots_[slot];
+    s.total_heap = total_heap;
+    s.allocated_bytes = allocated;
+    s.free_bytes = free;
+    s.largest_free_block = largest_free;
+    s.internal_frag_bytes = internal_frag;
 }
 
 uint64_t Metrics::total_heap_size() const noexcept {
-    return total_heap_;
+    uint64_t sum = 0;
+    for (const auto &s : slots_)
+        sum += s.total_heap;
+    return sum;
 }
 
 uint64_t Metrics::allocated_bytes() const noexcept {
-    return allocated_bytes_;
+    uint64_t sum = 0;
+    for (const auto &s : slots_)
+        sum += s.allocated_bytes;
+    return sum;
 }
 
 uint64_t Metrics::free_bytes() const noexcept {
-    return free_bytes_;
+    uint64_t sum = 0;
+    for (const auto &s : slots_)
+        sum += s.free_bytes;
+    return sum;
 }
 
 uint64_t Metrics::largest_free_block() const noexcept {
-    return largest_free_block_;
+    uint64_t best = 0;
+    for (const auto &s : slots_)
+        best = std::max(best, s.largest_free_block);
+    return best;
 }
 
 uint64_t Metrics::internal_fragmentation() const noexcept {
-    return internal_frag_bytes_;
+    uint64_t sum = 0;
+    for (const auto &s : slots_)
+        sum += s.internal_frag_bytes;
+    return sum;
 }
 
 double Metrics::external_fragmentation() const noexcept {
-    if (free_bytes_ == 0) return 0.0;
-    return 1.0 - (double(largest_free_block_) / double(free_bytes_));
+    uint64_t free = 0, largest = 0;
+    for (const auto &s : slots_) {
+        free += s.free_bytes;
+        largest += s.largest_free_block;
+    }
+    if (free == 0) return 0.0;
+    return 1.0 - (double(largest) / double(free));
+}
+
+// ---------------- Realloc / calloc ----------------
+
+void Metrics::record_realloc(bool moved, uint64_t copy_bytes) {
+    if (moved) {
+        ++realloc_moves_;
+        realloc_copy_bytes_ += copy_bytes;
+    } else {
+        ++reallocs_in_place_;
+    }
+}
+
+void Metrics::record_calloc(uint64_t zeroed_pages, uint64_t zero_fill_pages) {
+    ++callocs_;
+    calloc_zeroed_pages_ += zeroed_pages;
+    calloc_zero_fill_pages_ += zero_fill_pages;
+}
+
+uint64_t Metrics::reallocs_in_place() const noexcept {
+    return reallocs_in_place_;
+}
+
+uint64_t Metrics::realloc_moves() const noexcept {
+    return realloc_moves_;
+}
+
+uint64_t Metrics::realloc_copy_bytes() const noexcept {
+    return realloc_copy_bytes_;
+}
+
+uint64_t Metrics::callocs() const noexcept {
+    return callocs_;
+}
+
+uint64_t Metrics::calloc_zeroed_pages() const noexcept {
+    return calloc_zeroed_pages_;
+}
+
+uint64_t Metrics::calloc_zero_fill_pages() const noexcept {
+    return calloc_zero_fill_pages_;
+}
+
+// ---------------- Thread caches ----------------
+
+void Metrics::record_tcache(uint64_t hits, uint64_t misses,
+                            uint64_t central_ops, uint64_t cross_thread_frees) {
+    tcache_hits_ += hits;
+    tcache_misses_ += misses;
+    central_ops_ += central_ops;
+    cross_thread_frees_ += cross_thread_frees;
+}
+
+void Metrics::add_stranded_bytes(int64_t delta) {
+    stranded_bytes_ = static_cast<uint64_t>(static_cast<int64_t>(stranded_bytes_) + delta);
+    if (stranded_bytes_ > peak_stranded_bytes_)
+        peak_stranded_bytes_ = stranded_bytes_;
+}
+
+uint64_t Metrics::tcache_hits() const noexcept {
+    return tcache_hits_;
+}
+
+uint64_t Metrics::tcache_misses() const noexcept {
+    return tcache_misses_;
+}
+
+double Metrics::tcache_hit_rate() const noexcept {
+    uint64_t total = tcache_hits_ + tcache_misses_;
+    if (total == 0) return 0.0;
+    return double(tcache_hits_) / double(total);
+}
+
+uint64_t Metrics::central_ops() const noexcept {
+    return central_ops_;
+}
+
+uint64_t Metrics::cross_thread_frees() const noexcept {
+    return cross_thread_frees_;
+}
+
+uint64_t Metrics::stranded_bytes() const noexcept {
+    return stranded_bytes_;
+}
+
+uint64_t Metrics::peak_stranded_bytes() const noexcept {
+    return peak_stranded_bytes_;
 }
 
 // ---------------- TLB ----------------
 
-void Metrics::record_tlb_hit() {
-    ++tlb_hits_;
+void Metrics::record_tlb_hit(uint32_t slot) {
+    ++slots_[slot].tlb_hits;
 }
 
-void Metrics::record_tlb_miss() {
-    ++tlb_misses_;
+void Metrics::record_tlb_miss(uint32_t slot) {
+    ++slots_[slot].tlb_misses;
 }
 
 uint64_t Metrics::tlb_hits() const noexcept {
-    return tlb_hits_;
+    uint64_t sum = 0;
+    for (const auto &s : slots_)
+        sum += s.tlb_hits;
+    return sum;
 }
 
 uint64_t Metrics::tlb_misses() const noexcept {
-    return tlb_misses_;
+    uint64_t sum = 0;
+    for (const auto &s : slots_)
+        sum += s.tlb_misses;
+    return sum;
 }
 
 double Metrics::tlb_hit_rate() const noexcept {
-    uint64_t total = tlb_hits_ + tlb_misses_;
+    uint64_t hits = tlb_hits();
+    uint64_t total = hits + tlb_misses();
     if (total == 0) return 0.0;
-    return double(tlb_hits_) / double(total);
+    return double(hits) / double(total);
+}
+
+// ---------------- Page faults ----------------
+
+void Metrics::record_page_fault(uint32_t slot, FaultRegion region) {
+    auto &s = slots_[slot];
+    ++s.page_faults;
+    ++s.faults_by_region[region];
+}
+
+void Metrics::record_eviction(uint32_t slot) {
+    ++slots_[slot].evictions;
+}
+
+uint64_t Metrics::page_faults() const noexcept {
+    uint64_t sum = 0;
+    for (const auto &s : slots_)
+        sum += s.page_faults;
+    return sum;
+}
+
+// ---------------- Resident-set control ----------------
+
+void Metrics::record_trim(uint32_t slot, uint64_t pages) {
+    slots_[slot].trimmed += pages;
+}
+
+void Metrics::record_suspend(uint32_t slot, uint64_t pages) {
+    ++slots_[slot].suspensions;
+    slots_[slot].swapped_out += pages;
+}
+
+void Metrics::record_resume(uint32_t slot) {
+    ++slots_[slot].resumes;
+}
+
+uint64_t Metrics::trimmed_pages() const noexcept {
+    uint64_t sum = 0;
+    for (const auto &s : slots_)
+        sum += s.trimmed;
+    return sum;
+}
+
+uint64_t Metrics::suspensions() const noexcept {
+    uint64_t sum = 0;
+    for (const auto &s : slots_)
+        sum += s.suspensions;
+    return sum;
+}
+
+uint64_t Metrics::swapped_out_pages() const noexcept {
+    uint64_t sum = 0;
+    for (const auto &s : slots_)
+        sum += s.swapped_out;
+    return sum;
+}
+
+uint64_t Metrics::resumes() const noexcept {
+    uint64_t sum = 0;
+    for (const auto &s : slots_)
+        sum += s.resumes;
+    return sum;
+}
+
+// ---------------- Access streams ----------------
+
+double ProcessMetrics::slowdown() const noexcept {
+    if (service_cycles == 0)
+        return 0.0;
+    return double(stall_cycles + service_cycles) / double(service_cycles);
+}
+
+void Metrics::record_stream_access(uint32_t slot, uint64_t arrival,
+                                   uint64_t start, uint64_t done) {
+    auto &s = slots_[slot];
+    if (s.stream_accesses++ == 0)
+        s.first_arrival = arrival;
+    s.stall_cycles += start - arrival;
+    s.service_cycles += done - start;
+    s.finish = std::max(s.finish, done);
+}
+
+uint64_t Metrics::stream_accesses() const noexcept {
+    uint64_t sum = 0;
+    for (const auto &s : slots_)
+        sum += s.stream_accesses;
+    return sum;
+}
+
+uint64_t Metrics::stall_cycles() const noexcept {
+    uint64_t sum = 0;
+    for (const auto &s : slots_)
+        sum += s.stall_cycles;
+    return sum;
+}
+
+uint64_t Metrics::service_cycles() const noexcept {
+    uint64_t sum = 0;
+    for (const auto &s : slots_)
+        sum += s.service_cycles;
+    return sum;
+}
+
+uint64_t Metrics::stream_makespan() const noexcept {
+    uint64_t first = UINT64_MAX, finish = 0;
+    for (const auto &s : slots_) {
+        if (s.stream_accesses == 0)
+            continue;
+        first = std::min(first, s.first_arrival);
+        finish = std::max(finish, s.finish);
+    }
+    return finish > first ? finish - first : 0;
+}
+
+// ---------------- TLB shootdowns ----------------
+
+void Metrics::record_shootdown(uint64_t ipis, uint64_t stall_cycles) {
+    ++shootdowns_;
+    shootdown_ipis_ += ipis;
+    shootdown_stall_cycles_ += stall_cycles;
+}
+
+uint64_t Metrics::shootdowns() const noexcept {
+    return shootdowns_;
+}
+
+uint64_t Metrics::shootdown_ipis() const noexcept {
+    return shootdown_ipis_;
+}
+
+uint64_t Metrics::shootdown_stall_cycles() const noexcept {
+    return shootdown_stall_cycles_;
+}
+
+// ---------------- NUMA ----------------
+
+void Metrics::record_numa_access(uint32_t node, bool local) {
+    if (node >= numa_local_.size()) {
+        numa_local_.resize(node + 1, 0);
+        numa_remote_.resize(node + 1, 0);
+    }
+    ++(local ? numa_local_ : numa_remote_)[node];
+}
+
+void Metrics::record_numa_migration(bool done) {
+    ++(done ? numa_migrations_ : numa_migrate_failed_);
+}
+
+uint64_t Metrics::numa_local(uint32_t node) const noexcept {
+    return node < numa_local_.size() ? numa_local_[node] : 0;
+}
+
+uint64_t Metrics::numa_remote(uint32_t node) const noexcept {
+    return node < numa_remote_.size() ? numa_remote_[node] : 0;
+}
+
+uint64_t Metrics::numa_migrations() const noexcept {
+    return numa_migrations_;
+}
+
+uint64_t Metrics::numa_migrate_failed() const noexcept {
+    return numa_migrate_failed_;
+}
+
+// ---------------- Reclaim ----------------
+
+void Metrics::record_direct_reclaim(uint64_t stall) {
+    ++direct_reclaims_;
+    direct_reclaim_stall_ += stall;
+}
+
+void Metrics::record_kswapd_wakeup() {
+    ++kswapd_wakeups_;
+}
+
+void Metrics::record_kswapd_batch(uint64_t pages) {
+    ++kswapd_batches_;
+    kswapd_pages_ += pages;
+}
+
+void Metrics::record_fault_service(uint64_t cycles) {
+    ++fault_services_;
+    fault_service_cycles_ += cycles;
+}
+
+uint64_t Metrics::direct_reclaims() const noexcept {
+    return direct_reclaims_;
+}
+
+uint64_t Metrics::direct_reclaim_stall() const noexcept {
+    return direct_reclaim_stall_;
+}
+
+uint64_t Metrics::kswapd_wakeups() const noexcept {
+    return kswapd_wakeups_;
+}
+
+uint64_t Metrics::kswapd_batches() const noexcept {
+    return kswapd_batches_;
+}
+
+uint64_t Metrics::kswapd_pages() const noexcept {
+    return kswapd_pages_;
+}
+
+double Metrics::mean_fault_service() const noexcept {
+    if (fault_services_ == 0) return 0.0;
+    return static_cast<double>(fault_service_cycles_) / static_cast<double>(fault_services_);
+}
+
+// ---------------- Page-in tiers ----------------
+
+void Metrics::record_pagein_source(PageinSource source) {
+    switch (source) {
+        case PAGEIN_ZSWAP:      ++pageins_zswap_;      break;
+        case PAGEIN_SWAP:       ++pageins_swap_;       break;
+        case PAGEIN_SWAP_CACHE: ++pageins_swap_cache_; break;
+        default:                ++pageins_zero_;       break;
+    }
+}
+
+uint64_t Metrics::pageins(PageinSource source) const noexcept {
+    switch (source) {
+        case PAGEIN_ZSWAP:      return pageins_zswap_;
+        case PAGEIN_SWAP:       return pageins_swap_;
+        case PAGEIN_SWAP_CACHE: return pageins_swap_cache_;
+        default:                return pageins_zero_;
+    }
+}
+
+// ---------------- Page release / residency ----------------
+
+void Metrics::record_pages_released(uint64_t pages) {
+    pages_released_ += pages;
+}
+
+void Metrics::record_lazy_reclaim() {
+    ++lazy_reclaims_;
+}
+
+void Metrics::record_refault() {
+    ++refaults_;
+}
+
+void Metrics::update_resident(uint64_t frames, uint64_t now) {
+    if (now > resident_since_) {
+        resident_area_ += resident_frames_ * (now - resident_since_);
+        resident_since_ = now;
+    }
+    resident_frames_ = frames;
+    if (frames > peak_resident_frames_)
+        peak_resident_frames_ = frames;
+
+    for (uint32_t slot : rss_dirty_) {
+        auto &s = slots_[slot];
+        if (s.peak_rss == 0) {
+            s.rss_first = now;
+            s.rss_since = now;
+        } else if (now > s.rss_since) {
+            s.rss_area += s.rss * (now - s.rss_since);
+            s.rss_since = now;
+        }
+        s.rss = s.rss_pending;
+        s.peak_rss = std::max(s.peak_rss, s.rss);
+        s.rss_dirty = false;
+    }
+    rss_dirty_.clear();
+}
+
+void Metrics::record_process_resident(uint32_t slot, uint64_t pages) {
+    auto &s = slots_[slot];
+    s.rss_pending = pages;
+    if (!s.rss_dirty) {
+        s.rss_dirty = true;
+        rss_dirty_.push_back(slot);
+    }
+}
+
+double ProcessMetrics::steady_rss(uint64_t now) const noexcept {
+    if (peak_rss == 0)
+        return 0.0;
+    // An exited process last changed to 0 pages at its exit
+    uint64_t end = live ? std::max(now, rss_since) : rss_since;
+    uint64_t area = rss_area + rss * (end - rss_since);
+    if (end == rss_first)
+        return double(rss);
+    return double(area) / double(end - rss_first);
+}
+
+uint64_t Metrics::pages_released() const noexcept {
+    return pages_released_;
+}
+
+uint64_t Metrics::lazy_reclaims() const noexcept {
+    return lazy_reclaims_;
+}
+
+uint64_t Metrics::refaults() const noexcept {
+    return refaults_;
+}
+
+uint64_t Metrics::resident_frames() const noexcept {
+    return resident_frames_;
+}
+
+uint64_t Metrics::peak_resident_frames() const noexcept {
+    return peak_resident_frames_;
+}
+
+double Metrics::avg_resident_frames(uint64_t now) const noexcept {
+    if (now == 0) return double(resident_frames_);
+    uint64_t area = resident_area_;
+    if (now > resident_since_)
+        area += resident_frames_ * (now - resident_since_);
+    return double(area) / double(now);
+}
+
+// ---------------- Heap growth ----------------
+
+void Metrics::record_brk_grow(uint64_t count) {
+    brk_grows_ += count;
+}
+
+void Metrics::record_mmap(uint64_t bytes) {
+    ++mmaps_;
+    mmap_bytes_ += bytes;
+    if (mmap_bytes_ > peak_mmap_bytes_)
+        peak_mmap_bytes_ = mmap_bytes_;
+}
+
+void Metrics::record_munmap(uint64_t bytes) {
+    ++munmaps_;
+    mmap_bytes_ -= bytes;
+}
+
+uint64_t Metrics::brk_grows() const noexcept {
+    return brk_grows_;
+}
+
+uint64_t Metrics::mmaps() const noexcept {
+    return mmaps_;
+}
+
+uint64_t Metrics::munmaps() const noexcept {
+    return munmaps_;
+}
+
+uint64_t Metrics::mmap_bytes() const noexcept {
+    return mmap_bytes_;
+}
+
+uint64_t Metrics::peak_mmap_bytes() const noexcept {
+    return peak_mmap_bytes_;
 }
 
 // ---------------- Latency ----------------
 
 void Metrics::record_access_latency(uint64_t cycles) {
-    latencies_.push_back(cycles);
+    latency_.record(cycles);
 }
 
-uint64_t Metrics::percentile(double p) const {
-    if (latencies_.empty())
-        return 0;
-
-    std::vector<uint64_t> sorted = latencies_;
-    std::sort(sorted.begin(), sorted.end());
+void Metrics::merge_latency(const LatencyHistogram &other) {
+    latency_.merge(other);
+}
 
-    size_t idx = static_cast<size_t>(p * (sorted.size() - 1));
-    return sorted[idx];
+uint64_t Metrics::percentile(double p) const {
+    return latency_.percentile(p);
 }
 
 uint64_t Metrics::latency_p50() const {
@@ -113,4 +657,133 @@ uint64_t Metrics::latency_p99() const {
     return percentile(0.99);
 }
 
+const LatencyHistogram& Metrics::latency() const noexcept {
+    return latency_;
+}
+
+// ---------------- Checkpoint ----------------
+
+const std::vector<uint64_t Metrics::*> &Metrics::counter_fields() {
+    static const std::vector<uint64_t Metrics::*> fields = {
+        &Metrics::reallocs_in_place_, &Metrics::realloc_moves_,
+        &Metrics::realloc_copy_bytes_, &Metrics::callocs_,
+        &Metrics::calloc_zeroed_pages_, &Metrics::calloc_zero_fill_pages_,
+        &Metrics::tcache_hits_, &Metrics::tcache_misses_,
+        &Metrics::central_ops_, &Metrics::cross_thread_frees_,
+        &Metrics::stranded_bytes_, &Metrics::peak_stranded_bytes_,
+        &Metrics::pages_released_, &Metrics::lazy_reclaims_,
+        &Metrics::refaults_, &Metrics::resident_frames_,
+        &Metrics::peak_resident_frames_, &Metrics::resident_since_,
+        &Metrics::resident_area_,
+        &Metrics::brk_grows_, &Metrics::mmaps_, &Metrics::munmaps_,
+        &Metrics::mmap_bytes_, &Metrics::peak_mmap_bytes_,
+        &Metrics::shootdowns_, &Metrics::shootdown_ipis_,
+        &Metrics::shootdown_stall_cycles_,
+        &Metrics::numa_migrations_, &Metrics::numa_migrate_failed_,
+        &Metrics::direct_reclaims_, &Metrics::direct_reclaim_stall_,
+        &Metrics::kswapd_wakeups_, &Metrics::kswapd_batches_,
+        &Metrics::kswapd_pages_, &Metrics::fault_services_,
+        &Metrics::fault_service_cycles_,
+        &Metrics::pageins_zero_, &Metrics::pageins_zswap_, &Metrics::pageins_swap_,
+        &Metrics::pageins_swap_cache_,
+    };
+    return fields;
+}
+
+void Metrics::save(SnapshotWriter &w) const {
+    w.section("metrics");
+    w.u64(slots_.size());
+    for (const auto &s : slots_) {
+        w.u64(s.pid);
+        w.boolean(s.live);
+        w.u64(s.total_heap);
+        w.u64(s.allocated_bytes);
+        w.u64(s.free_bytes);
+        w.u64(s.largest_free_block);
+        w.u64(s.internal_frag_bytes);
+        w.u64(s.tlb_hits);
+        w.u64(s.tlb_misses);
+        w.u64(s.page_faults);
+        for (uint64_t f : s.faults_by_region)
+            w.u64(f);
+        w.u64(s.evictions);
+        w.u64(s.trimmed);
+        w.u64(s.suspensions);
+        w.u64(s.swapped_out);
+        w.u64(s.resumes);
+        w.u64(s.stream_accesses);
+        w.u64(s.stall_cycles);
+        w.u64(s.service_cycles);
+        w.u64(s.first_arrival);
+        w.u64(s.finish);
+        w.u64(s.rss);
+        w.u64(s.rss_pending);
+        w.boolean(s.rss_dirty);
+        w.u64(s.peak_rss);
+        w.u64(s.rss_first);
+        w.u64(s.rss_since);
+        w.u64(s.rss_area);
+    }
+
+    for (auto field : counter_fields())
+        w.u64(this->*field);
+    w.u64(numa_local_.size());
+    for (size_t n = 0; n < numa_local_.size(); ++n) {
+        w.u64(numa_local_[n]);
+        w.u64(numa_remote_[n]);
+    }
+    latency_.save(w);
+}
+
+void Metrics::load(SnapshotReader &r) {
+    r.section("metrics");
+    slots_.resize(r.u64());
+    for (auto &s : slots_) {
+        s.pid = static_cast<uint32_t>(r.u64());
+        s.live = r.boolean();
+        s.total_heap = r.u64();
+        s.allocated_bytes = r.u64();
+        s.free_bytes = r.u64();
+        s.largest_free_block = r.u64();
+        s.internal_frag_bytes = r.u64();
+        s.tlb_hits = r.u64();
+        s.tlb_misses = r.u64();
+        s.page_faults = r.u64();
+        for (uint64_t &f : s.faults_by_region)
+            f = r.u64();
+        s.evictions = r.u64();
+        s.trimmed = r.u64();
+        s.suspensions = r.u64();
+        s.swapped_out = r.u64();
+        s.resumes = r.u64();
+        s.stream_accesses = r.u64();
+        s.stall_cycles = r.u64();
+        s.service_cycles = r.u64();
+        s.first_arrival = r.u64();
+        s.finish = r.u64();
+        s.rss = r.u64();
+        s.rss_pending = r.u64();
+        s.rss_dirty = r.boolean();
+        s.peak_rss = r.u64();
+        s.rss_first = r.u64();
+        s.rss_since = r.u64();
+        s.rss_area = r.u64();
+    }
+    rss_dirty_.clear();
+    for (uint32_t i = 0; i < slots_.size(); ++i) {
+        if (slots_[i].rss_dirty)
+            rss_dirty_.push_back(i);
+    }
+
+    for (auto field : counter_fields())
+        this->*field = r.u64();
+    numa_local_.resize(r.u64());
+    numa_remote_.resize(numa_local_.size());
+    for (size_t n = 0; n < numa_local_.size(); ++n) {
+        numa_local_[n] = r.u64();
+        numa_remote_[n] = r.u64();
+    }
+    latency_.load(r);
+}
+
 } // namespace sim
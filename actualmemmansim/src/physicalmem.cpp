@@ -1,33 +1,91 @@
 #include "sim/physicalmem.h"
+#include "sim/profile.h"
+#include "sim/snapshot.h"
 
+#include <algorithm>
 #include <stdexcept>
 // u da real frame
 // LRU to find unused frames, which can be removed from the table. 
 namespace sim {
 
-PhysicalMemory::PhysicalMemory(size_t num_frames)
-    : frames_(num_frames) {}
+PhysicalMemory::PhysicalMemory(size_t num_frames, size_t nodes)
+    : frames_(num_frames),
+      node_used_(nodes, 0),
+      used_frames_(0),
+      lazy_frames_(0) {
+    for (size_t n = 0; n <= nodes; ++n)
+        node_start_.push_back(n * num_frames / nodes);
+}
 
 size_t PhysicalMemory::num_frames() const noexcept {
     return frames_.size();
 }
 
-FrameAllocResult PhysicalMemory::allocate(uint32_t pid, uint64_t vpn, uint64_t now) {
-    // 1. Try free frame first
-    int frame_id = find_free_frame();
+size_t PhysicalMemory::used_frames() const noexcept {
+    return used_frames_;
+}
+
+// ---------------- NUMA nodes ----------------
+
+size_t PhysicalMemory::nodes() const noexcept {
+    return node_used_.size();
+}
+
+uint32_t PhysicalMemory::node_of(int frame_id) const {
+    auto it = std::upper_bound(node_start_.begin(), node_start_.end(),
+                               static_cast<size_t>(frame_id));
+    return static_cast<uint32_t>(it - node_start_.begin() - 1);
+}
+
+size_t PhysicalMemory::node_frames(uint32_t node) const {
+    return node_start_.at(node + 1) - node_start_.at(node);
+}
+
+size_t PhysicalMemory::used_frames(uint32_t node) const {
+    return node_used_.at(node);
+}
+
+// ---------------- Allocation ----------------
+
+FrameAllocResult PhysicalMemory::allocate(uint32_t pid, uint64_t vpn, uint64_t now,
+                                          const std::vector<uint32_t> &order) {
+    SIM_PROFILE_SCOPE(FRAME_ALLOC);
+    // 1. Try free frame first, node by node
+    int frame_id = -1;
+    if (order.empty()) {
+        frame_id = find_free_frame(0, frames_.size());
+    } else {
+        for (uint32_t n : order) {
+            frame_id = find_free_frame(node_start_[n], node_start_[n + 1]);
+            if (frame_id != -1)
+                break;
+        }
+    }
     bool evicted = false;
     uint32_t old_pid = 0;
     uint64_t old_vpn = 0;
+    bool old_lazy = false;
 
-    // 2. If none free, evict LRU
+    // 2. If none free, reclaim a lazily freed page, else evict LRU
     if (frame_id == -1) {
-        frame_id = find_lru_frame();
+        size_t begin = order.empty() ? 0 : node_start_[order[0]];
+        size_t end = order.empty() ? frames_.size() : node_start_[order[0] + 1];
+        if (lazy_frames_ > 0)
+            frame_id = find_lazy_frame(begin, end);
+        if (frame_id == -1)
+            frame_id = find_lru_frame(begin, end);
         if (frame_id == -1) {
             throw std::runtime_error("PhysicalMemory: no frame available for eviction");
         }
         evicted = true;
         old_pid = frames_[frame_id].pid;
         old_vpn = frames_[frame_id].vpn;
+        old_lazy = frames_[frame_id].lazy_free;
+        if (old_lazy)
+            --lazy_frames_;
+    } else {
+        ++used_frames_;
+        ++node_used_[node_of(frame_id)];
     }
 
     // 3. Assign frame
@@ -35,15 +93,63 @@ FrameAllocResult PhysicalMemory::allocate(uint32_t pid, uint64_t vpn, uint64_t n
     frames_[frame_id].pid = pid;
     frames_[frame_id].vpn = vpn;
     frames_[frame_id].last_used = now;
+    frames_[frame_id].lazy_free = false;
+    frames_[frame_id].hint_node = Frame::NO_NODE;
 
     return FrameAllocResult{
         frame_id,
         evicted,
         old_pid,
-        old_vpn
+        old_vpn,
+        old_lazy
     };
 }
 
+FrameAllocResult PhysicalMemory::replace(int frame_id, uint32_t pid, uint64_t vpn,
+                                         uint64_t now) {
+    if (frame_id < 0 || static_cast<size_t>(frame_id) >= frames_.size()) {
+        throw std::out_of_range("PhysicalMemory::replace invalid frame_id");
+    }
+    Frame &f = frames_[frame_id];
+    if (!f.occupied)
+        throw std::runtime_error("PhysicalMemory: replacing a free frame");
+
+    FrameAllocResult res{ frame_id, true, f.pid, f.vpn, f.lazy_free };
+    if (f.lazy_free)
+        --lazy_frames_;
+    f.pid = pid;
+    f.vpn = vpn;
+    f.last_used = now;
+    f.lazy_free = false;
+    f.hint_node = Frame::NO_NODE;
+    return res;
+}
+
+int PhysicalMemory::find_victim(const std::function<bool(const Frame &)> &eligible,
+                                uint32_t node) const {
+    size_t begin = node == Frame::NO_NODE ? 0 : node_start_.at(node);
+    size_t end = node == Frame::NO_NODE ? frames_.size() : node_start_.at(node + 1);
+
+    int lazy = -1;
+    int lru = -1;
+    uint64_t oldest_lazy = UINT64_MAX;
+    uint64_t oldest = UINT64_MAX;
+    for (size_t i = begin; i < end; ++i) {
+        const Frame &f = frames_[i];
+        if (!f.occupied || !eligible(f))
+            continue;
+        if (f.lazy_free && f.last_used < oldest_lazy) {
+            oldest_lazy = f.last_used;
+            lazy = static_cast<int>(i);
+        }
+        if (f.last_used < oldest) {
+            oldest = f.last_used;
+            lru = static_cast<int>(i);
+        }
+    }
+    return lazy != -1 ? lazy : lru;
+}
+
 void PhysicalMemory::touch(int frame_id, uint64_t now) {
     if (frame_id < 0 || static_cast<size_t>(frame_id) >= frames_.size()) {
         throw std::out_of_range("PhysicalMemory::touch invalid frame_id");
@@ -55,7 +161,58 @@ void PhysicalMemory::free(int frame_id) {
     if (frame_id < 0 || static_cast<size_t>(frame_id) >= frames_.size()) {
         throw std::out_of_range("PhysicalMemory::free invalid frame_id");
     }
+    if (frames_[frame_id].occupied) {
+        --used_frames_;
+        --node_used_[node_of(frame_id)];
+    }
+    if (frames_[frame_id].lazy_free)
+        --lazy_frames_;
+    frames_[frame_id] = Frame{};
+}
+
+std::optional<int> PhysicalMemory::migrate(int frame_id, uint32_t node) {
+    if (frame_id < 0 || static_cast<size_t>(frame_id) >= frames_.size()) {
+        throw std::out_of_range("PhysicalMemory::migrate invalid frame_id");
+    }
+    int to = find_free_frame(node_start_.at(node), node_start_.at(node + 1));
+    if (to == -1)
+        return std::nullopt;
+
+    frames_[to] = frames_[frame_id];
+    frames_[to].hint_node = Frame::NO_NODE;
     frames_[frame_id] = Frame{};
+    --node_used_[node_of(frame_id)];
+    ++node_used_[node];
+    return to;
+}
+
+void PhysicalMemory::set_hint_node(int frame_id, uint32_t node) {
+    if (frame_id < 0 || static_cast<size_t>(frame_id) >= frames_.size()) {
+        throw std::out_of_range("PhysicalMemory::set_hint_node invalid frame_id");
+    }
+    frames_[frame_id].hint_node = node;
+}
+
+void PhysicalMemory::mark_lazy_free(int frame_id) {
+    if (frame_id < 0 || static_cast<size_t>(frame_id) >= frames_.size()) {
+        throw std::out_of_range("PhysicalMemory::mark_lazy_free invalid frame_id");
+    }
+    Frame &f = frames_[frame_id];
+    if (f.occupied && !f.lazy_free) {
+        f.lazy_free = true;
+        ++lazy_frames_;
+    }
+}
+
+void PhysicalMemory::clear_lazy_free(int frame_id) {
+    if (frame_id < 0 || static_cast<size_t>(frame_id) >= frames_.size()) {
+        throw std::out_of_range("PhysicalMemory::clear_lazy_free invalid frame_id");
+    }
+    Frame &f = frames_[frame_id];
+    if (f.lazy_free) {
+        f.lazy_free = false;
+        --lazy_frames_;
+    }
 }
 
 const Frame& PhysicalMemory::frame(int frame_id) const {
@@ -65,8 +222,8 @@ const Frame& PhysicalMemory::frame(int frame_id) const {
     return frames_[frame_id];
 }
 
-int PhysicalMemory::find_free_frame() const {
-    for (size_t i = 0; i < frames_.size(); ++i) {
+int PhysicalMemory::find_free_frame(size_t begin, size_t end) const {
+    for (size_t i = begin; i < end; ++i) {
         if (!frames_[i].occupied) {
             return static_cast<int>(i);
         }
@@ -74,11 +231,25 @@ int PhysicalMemory::find_free_frame() const {
     return -1;
 }
 
-int PhysicalMemory::find_lru_frame() const {
+// Oldest lazily freed frame
+int PhysicalMemory::find_lazy_frame(size_t begin, size_t end) const {
     int lru = -1;
     uint64_t oldest = UINT64_MAX;
 
-    for (size_t i = 0; i < frames_.size(); ++i) {
+    for (size_t i = begin; i < end; ++i) {
+        if (frames_[i].lazy_free && frames_[i].last_used < oldest) {
+            oldest = frames_[i].last_used;
+            lru = static_cast<int>(i);
+        }
+    }
+    return lru;
+}
+
+int PhysicalMemory::find_lru_frame(size_t begin, size_t end) const {
+    int lru = -1;
+    uint64_t oldest = UINT64_MAX;
+
+    for (size_t i = begin; i < end; ++i) {
         if (frames_[i].occupied && frames_[i].last_used < oldest) {
             oldest = frames_[i].last_used;
             lru = static_cast<int>(i);
@@ -87,4 +258,45 @@ int PhysicalMemory::find_lru_frame() const {
     return lru;
 }
 
+// ---------------- Checkpoint ----------------
+
+void PhysicalMemory::save(SnapshotWriter &w) const {
+    w.section("pmem");
+    w.u64(frames_.size());
+    for (const Frame &f : frames_) {
+        w.boolean(f.occupied);
+        if (!f.occupied)
+            continue;
+        w.u64(f.pid);
+        w.u64(f.vpn);
+        w.u64(f.last_used);
+        w.boolean(f.lazy_free);
+        w.u64(f.hint_node);
+    }
+    w.u64(used_frames_);
+    w.u64(lazy_frames_);
+}
+
+void PhysicalMemory::load(SnapshotReader &r) {
+    r.section("pmem");
+    if (r.u64() != frames_.size())
+        throw std::runtime_error("PhysicalMemory: checkpoint has another number of frames");
+    std::fill(node_used_.begin(), node_used_.end(), 0);
+    for (size_t i = 0; i < frames_.size(); ++i) {
+        Frame &f = frames_[i];
+        f = Frame{};
+        f.occupied = r.boolean();
+        if (!f.occupied)
+            continue;
+        f.pid = static_cast<uint32_t>(r.u64());
+        f.vpn = r.u64();
+        f.last_used = r.u64();
+        f.lazy_free = r.boolean();
+        f.hint_node = static_cast<uint32_t>(r.u64());
+        ++node_used_[node_of(static_cast<int>(i))];
+    }
+    used_frames_ = r.u64();
+    lazy_frames_ = r.u64();
+}
+
 } // namespace sim
@@ -1,18 +1,50 @@
 #include "sim/process.h"
+#include "sim/snapshot.h"
 
+#include <algorithm>
 #include <stdexcept>
 
 namespace sim {
 
-Process::Process(uint32_t pid, uint64_t heap_base, uint64_t heap_size)
+// Owner tag bit for blocks sitting in a thread cache (free to the program)
+static constexpr uint32_t CACHED_OWNER = 1u << 31;
+
+Process::Process(uint32_t pid, uint64_t heap_base, uint64_t heap_size,
+                 uint64_t page_size, const HeapLayout &layout)
     : pid_(pid),
+      metrics_slot_(0),
+      core_(0),
       state_(ProcessState::NEW),
-      heap_(std::make_unique<HeapAllocator>(heap_base, heap_size)) {}
+      heap_(std::make_unique<HeapAllocator>(heap_base, heap_size)),
+      page_size_(page_size),
+      layout_(layout),
+      resident_pages_(0),
+      vtime_(0),
+      last_fault_(0) {
+    vmas_[heap_base] = VMA{heap_base, heap_base + heap_size, VmaKind::HEAP};
+    threads_.emplace(0, ThreadCache(layout_.tcache_batch));
+}
 
 uint32_t Process::pid() const noexcept {
     return pid_;
 }
 
+uint32_t Process::metrics_slot() const noexcept {
+    return metrics_slot_;
+}
+
+void Process::set_metrics_slot(uint32_t slot) noexcept {
+    metrics_slot_ = slot;
+}
+
+uint32_t Process::core() const noexcept {
+    return core_;
+}
+
+void Process::set_core(uint32_t core) noexcept {
+    core_ = core;
+}
+
 // ---------------- State ----------------
 
 ProcessState Process::state() const noexcept {
@@ -30,6 +62,11 @@ bool Process::has_mapping(uint64_t vpn) const {
     return it != page_table_.end() && it->second.valid;
 }
 
+bool Process::is_swapped(uint64_t vpn) const {
+    auto it = page_table_.find(vpn);
+    return it != page_table_.end() && !it->second.valid && !it->second.released;
+}
+
 PageTableEntry Process::get_pte(uint64_t vpn) const {
     auto it = page_table_.find(vpn);
     if (it != page_table_.end())
@@ -38,19 +75,78 @@ PageTableEntry Process::get_pte(uint64_t vpn) const {
 }
 
 void Process::map_page(uint64_t vpn, int frame_id) {
-    page_table_[vpn] = PageTableEntry{true, frame_id};
+    auto &pte = page_table_[vpn];
+    if (!pte.valid)
+        ++resident_pages_;
+    pte = PageTableEntry{true, frame_id, false, vtime_};
 }
 
 void Process::unmap_page(uint64_t vpn) {
     auto it = page_table_.find(vpn);
     if (it != page_table_.end()) {
+        if (it->second.valid)
+            --resident_pages_;
+        it->second.valid = false;
+        it->second.frame_id = -1;
+    }
+}
+
+void Process::release_page(uint64_t vpn) {
+    auto it = page_table_.find(vpn);
+    if (it != page_table_.end()) {
+        if (it->second.valid)
+            --resident_pages_;
         it->second.valid = false;
         it->second.frame_id = -1;
+        it->second.released = true;
+    }
+}
+
+std::vector<uint64_t>
+Process::dirty_pages_in(uint64_t first_vpn, uint64_t end_vpn) const {
+    std::vector<uint64_t> out;
+    for (uint64_t vpn = first_vpn; vpn < end_vpn; ++vpn) {
+        auto it = page_table_.find(vpn);
+        if (it != page_table_.end() && (it->second.valid || !it->second.released))
+            out.push_back(vpn);
+    }
+    return out;
+}
+
+std::vector<std::pair<uint64_t, int>>
+Process::mappings_in(uint64_t first_vpn, uint64_t end_vpn) const {
+    std::vector<std::pair<uint64_t, int>> out;
+    if (end_vpn <= first_vpn)
+        return out;
+
+    // Walk whichever is smaller: the range or the page table
+    if (end_vpn - first_vpn <= page_table_.size()) {
+        for (uint64_t vpn = first_vpn; vpn < end_vpn; ++vpn) {
+            auto it = page_table_.find(vpn);
+            if (it != page_table_.end() && it->second.valid)
+                out.emplace_back(vpn, it->second.frame_id);
+        }
+    } else {
+        for (const auto &kv : page_table_) {
+            if (kv.second.valid && kv.first >= first_vpn && kv.first < end_vpn)
+                out.emplace_back(kv.first, kv.second.frame_id);
+        }
+    }
+    return out;
+}
+
+void Process::drop_page(uint64_t vpn) {
+    auto it = page_table_.find(vpn);
+    if (it != page_table_.end()) {
+        if (it->second.valid)
+            --resident_pages_;
+        page_table_.erase(it);
     }
 }
 
 void Process::clear_page_table() {
     page_table_.clear();
+    resident_pages_ = 0;
 }
 
 // ---------------- Blocking ----------------
@@ -74,16 +170,413 @@ std::optional<uint64_t> Process::blocked_vpn() const noexcept {
 
 // ---------------- Heap ----------------
 
-std::optional<uint64_t> Process::heap_alloc(uint64_t size) {
-    return heap_->alloc(size);
+uint64_t Process::page_align(uint64_t n) const noexcept {
+    return (n + page_size_ - 1) / page_size_ * page_size_;
+}
+
+// ---------------- Threads ----------------
+
+void Process::start_thread(uint32_t tid) {
+    if (!threads_.emplace(tid, ThreadCache(layout_.tcache_batch)).second)
+        throw std::runtime_error("Process: thread already exists");
+}
+
+void Process::exit_thread(uint32_t tid, std::vector<HeapFreeResult> &freed) {
+    auto &tc = thread(tid);
+
+    counters_.stranded_bytes -= tc.cached_bytes();
+    flush_scratch_.clear();
+    tc.take_all(flush_scratch_);
+    if (!flush_scratch_.empty())
+        ++counters_.central_ops;
+    for (uint64_t addr : flush_scratch_)
+        central_free(addr, freed);
+
+    if (tid != 0)
+        threads_.erase(tid);
+}
+
+size_t Process::num_threads() const noexcept {
+    return threads_.size();
+}
+
+ThreadCache &Process::thread(uint32_t tid) {
+    auto it = threads_.find(tid);
+    if (it == threads_.end())
+        throw std::runtime_error("Process: unknown thread");
+    return it->second;
+}
+
+// ---------------- Heap ----------------
+
+std::optional<uint64_t> Process::central_alloc(uint64_t size) {
+    auto addr = heap_->alloc(size);
+    if (!addr && size != 0 && layout_.brk_grow_step != 0 && grow_heap(size))
+        addr = heap_->alloc(size);
+    return addr;
+}
+
+void Process::central_free(uint64_t addr, std::vector<HeapFreeResult> &freed) {
+    auto blk = heap_->free(addr);
+    freed.push_back(HeapFreeResult{blk.start, blk.start + blk.size, false});
+}
+
+std::optional<uint64_t> Process::heap_alloc(uint64_t size, uint32_t tid) {
+    if (layout_.mmap_threshold != 0 && size >= layout_.mmap_threshold)
+        return mmap_alloc(size);
+
+    auto &tc = thread(tid);
+    int cls = (tc.batch() != 0 && size != 0) ? ThreadCache::size_class(size)
+                                             : ThreadCache::NO_CLASS;
+    if (cls == ThreadCache::NO_CLASS) {
+        ++counters_.central_ops;
+        return central_alloc(size);
+    }
+
+    uint64_t csize = ThreadCache::class_size(cls);
+    if (auto addr = tc.pop(cls)) {
+        ++counters_.tcache_hits;
+        counters_.stranded_bytes -= csize;
+        heap_->set_owner(*addr, tid);
+        return addr;
+    }
+
+    // Miss: refill a whole batch under one central trip
+    ++counters_.tcache_misses;
+    ++counters_.central_ops;
+    flush_scratch_.clear();
+    for (size_t i = 0; i < tc.batch(); ++i) {
+        auto addr = central_alloc(csize);
+        if (!addr)
+            break;
+        flush_scratch_.push_back(*addr);
+    }
+    // Lowest address ends up on the hot end
+    for (auto it = flush_scratch_.rbegin(); it != flush_scratch_.rend(); ++it) {
+        heap_->set_owner(*it, tid | CACHED_OWNER);
+        tc.push(cls, *it);
+        counters_.stranded_bytes += csize;
+    }
+
+    auto addr = tc.pop(cls);
+    if (addr) {
+        counters_.stranded_bytes -= csize;
+        heap_->set_owner(*addr, tid);
+    }
+    return addr;
 }
 
-void Process::heap_free(uint64_t addr) {
-    heap_->free(addr);
+void Process::heap_free(uint64_t addr, uint32_t tid,
+                        std::vector<HeapFreeResult> &freed) {
+    auto it = vmas_.find(addr);
+    if (it != vmas_.end() && it->second.kind == VmaKind::MMAP) {
+        freed.push_back(HeapFreeResult{it->second.start, it->second.end, true});
+        counters_.mmap_bytes -= it->second.end - it->second.start;
+        vmas_.erase(it);
+        return;
+    }
+
+    auto &tc = thread(tid);
+    int cls = (tc.batch() != 0) ? ThreadCache::exact_class(heap_->block_size(addr))
+                                : ThreadCache::NO_CLASS;
+    if (cls == ThreadCache::NO_CLASS) {
+        ++counters_.central_ops;
+        central_free(addr, freed);
+        return;
+    }
+
+    uint32_t owner = heap_->owner(addr);
+    if (owner & CACHED_OWNER)
+        throw std::runtime_error("Process: double free of a cached block");
+
+    // Frees land in the freeing thread's cache, whoever allocated the block
+    if (owner != tid)
+        ++counters_.cross_thread_frees;
+    heap_->set_owner(addr, tid | CACHED_OWNER);
+    tc.push(cls, addr);
+    counters_.stranded_bytes += ThreadCache::class_size(cls);
+
+    if (tc.count(cls) > tc.limit()) {
+        ++counters_.central_ops;
+        flush_scratch_.clear();
+        tc.take_cold(cls, tc.batch(), flush_scratch_);
+        counters_.stranded_bytes -= flush_scratch_.size() * ThreadCache::class_size(cls);
+        for (uint64_t a : flush_scratch_)
+            central_free(a, freed);
+    }
+}
+
+HeapReallocResult Process::heap_realloc(uint64_t addr, uint64_t size, uint32_t tid) {
+    HeapReallocResult res;
+    bool big = layout_.mmap_threshold != 0 && size >= layout_.mmap_threshold;
+    uint64_t old_size;
+
+    auto it = vmas_.find(addr);
+    if (it != vmas_.end() && it->second.kind == VmaKind::MMAP) {
+        // Still fits the mapping: nothing to do (no partial munmap)
+        old_size = it->second.end - it->second.start;
+        if (big && size <= old_size) {
+            res.addr = addr;
+            return res;
+        }
+    } else {
+        // A block sitting in a thread cache is already freed
+        if (heap_->owner(addr) & CACHED_OWNER)
+            throw std::runtime_error("Process: realloc of a cached block");
+        old_size = heap_->block_size(addr);
+        if (!big && heap_->try_resize(addr, size)) {
+            res.addr = addr;
+            return res;
+        }
+    }
+
+    res.addr = heap_alloc(size, tid);
+    if (res.addr) {
+        res.moved = true;
+        res.copy_bytes = std::min(old_size, size);
+    }
+    return res;
+}
+
+bool Process::is_mmapped(uint64_t addr) const {
+    auto it = vmas_.find(addr);
+    return it != vmas_.end() && it->second.kind == VmaKind::MMAP;
+}
+
+const VMA* Process::vma_at(uint64_t addr) const {
+    auto it = vmas_.upper_bound(addr);
+    if (it == vmas_.begin())
+        return nullptr;
+    --it;
+    return addr < it->second.end ? &it->second : nullptr;
+}
+
+// Move brk up by at least `need` bytes, without running into the next VMA
+bool Process::grow_heap(uint64_t need) {
+    auto heap_it = vmas_.find(heap_->heap_base());
+    auto above = std::next(heap_it);
+    uint64_t limit = (above != vmas_.end()) ? above->second.start : layout_.mmap_base;
+
+    uint64_t end = heap_->heap_end();
+    uint64_t step = std::max(page_align(need), layout_.brk_grow_step);
+    if (end + step > limit) {
+        step = page_align(need);
+        if (end + step > limit)
+            return false;
+    }
+
+    heap_->grow(step);
+    heap_it->second.end = end + step;
+    ++counters_.brk_grows;
+    return true;
+}
+
+// Top-down first fit in the gaps between mmap_base and the heap
+std::optional<uint64_t> Process::mmap_alloc(uint64_t size) {
+    uint64_t len = page_align(size);
+    uint64_t hi = layout_.mmap_base;
+
+    for (auto it = vmas_.rbegin(); it != vmas_.rend(); ++it) {
+        const VMA &v = it->second;
+        if (v.start >= hi)
+            continue;
+        if (v.end <= hi && hi - v.end >= len) {
+            uint64_t start = hi - len;
+            vmas_[start] = VMA{start, hi, VmaKind::MMAP};
+            counters_.mmap_bytes += len;
+            return start;
+        }
+        if (v.kind == VmaKind::HEAP)
+            break;
+        hi = v.start;
+    }
+    return std::nullopt;
 }
 
 const HeapAllocator& Process::heap() const noexcept {
     return *heap_;
 }
 
+const std::map<uint64_t, VMA>& Process::vmas() const noexcept {
+    return vmas_;
+}
+
+const HeapCounters& Process::heap_counters() const noexcept {
+    return counters_;
+}
+
+// ---------------- Residency ----------------
+
+uint64_t Process::resident_pages() const noexcept {
+    return resident_pages_;
+}
+
+// ---------------- References ----------------
+
+void Process::reference(uint64_t vpn) {
+    ++vtime_;
+    auto it = page_table_.find(vpn);
+    if (it != page_table_.end() && it->second.valid)
+        it->second.last_ref = vtime_;
+}
+
+uint64_t Process::virtual_time() const noexcept {
+    return vtime_;
+}
+
+std::vector<std::pair<uint64_t, int>> Process::pages_idle_since(uint64_t vt) const {
+    std::vector<std::pair<uint64_t, int>> out;
+    for (const auto &kv : page_table_) {
+        if (kv.second.valid && kv.second.last_ref < vt)
+            out.emplace_back(kv.first, kv.second.frame_id);
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+std::optional<std::pair<uint64_t, int>> Process::lru_page() const {
+    const std::pair<const uint64_t, PageTableEntry> *best = nullptr;
+    for (const auto &kv : page_table_) {
+        if (!kv.second.valid)
+            continue;
+        if (!best || kv.second.last_ref < best->second.last_ref ||
+            (kv.second.last_ref == best->second.last_ref && kv.first < best->first))
+            best = &kv;
+    }
+    if (!best)
+        return std::nullopt;
+    return std::make_pair(best->first, best->second.frame_id);
+}
+
+uint64_t Process::last_fault() const noexcept {
+    return last_fault_;
+}
+
+void Process::set_last_fault(uint64_t vt) noexcept {
+    last_fault_ = vt;
+}
+
+// ---------------- Checkpoint ----------------
+
+// Hash maps are written in key order so equal processes give equal bytes
+void Process::save(SnapshotWriter &w) const {
+    w.section("proc");
+    w.u64(pid_);
+    w.u64(page_size_);
+    w.u64(layout_.brk_grow_step);
+    w.u64(layout_.mmap_threshold);
+    w.u64(layout_.mmap_base);
+    w.u64(layout_.tcache_batch);
+    w.u64(metrics_slot_);
+    w.u64(core_);
+    w.u64(static_cast<uint64_t>(state_));
+
+    std::vector<std::pair<uint64_t, PageTableEntry>> ptes(page_table_.begin(), page_table_.end());
+    std::sort(ptes.begin(), ptes.end(),
+              [](const auto &a, const auto &b) { return a.first < b.first; });
+    w.u64(ptes.size());
+    for (const auto &p : ptes) {
+        w.u64(p.first);
+        w.boolean(p.second.valid);
+        w.i64(p.second.frame_id);
+        w.boolean(p.second.released);
+        w.u64(p.second.last_ref);
+    }
+
+    w.boolean(blocked_vpn_.has_value());
+    if (blocked_vpn_)
+        w.u64(*blocked_vpn_);
+
+    heap_->save(w);
+
+    w.u64(vmas_.size());
+    for (const auto &v : vmas_) {
+        w.u64(v.second.start);
+        w.u64(v.second.end);
+        w.u64(static_cast<uint64_t>(v.second.kind));
+    }
+
+    w.u64(counters_.brk_grows);
+    w.u64(counters_.mmap_bytes);
+    w.u64(counters_.tcache_hits);
+    w.u64(counters_.tcache_misses);
+    w.u64(counters_.central_ops);
+    w.u64(counters_.cross_thread_frees);
+    w.u64(counters_.stranded_bytes);
+
+    std::vector<uint32_t> tids;
+    for (const auto &t : threads_)
+        tids.push_back(t.first);
+    std::sort(tids.begin(), tids.end());
+    w.u64(tids.size());
+    for (uint32_t tid : tids) {
+        w.u64(tid);
+        threads_.at(tid).save(w);
+    }
+
+    w.u64(resident_pages_);
+    w.u64(vtime_);
+    w.u64(last_fault_);
+}
+
+Process Process::load(SnapshotReader &r) {
+    r.section("proc");
+    uint32_t pid = static_cast<uint32_t>(r.u64());
+    uint64_t page_size = r.u64();
+    HeapLayout layout;
+    layout.brk_grow_step = r.u64();
+    layout.mmap_threshold = r.u64();
+    layout.mmap_base = r.u64();
+    layout.tcache_batch = r.u64();
+
+    // The heap bounds come back with the allocator state below
+    Process p(pid, 0, 0, page_size, layout);
+    p.metrics_slot_ = static_cast<uint32_t>(r.u64());
+    p.core_ = static_cast<uint32_t>(r.u64());
+    p.state_ = static_cast<ProcessState>(r.u64());
+
+    for (uint64_t n = r.u64(); n > 0; --n) {
+        uint64_t vpn = r.u64();
+        PageTableEntry &pte = p.page_table_[vpn];
+        pte.valid = r.boolean();
+        pte.frame_id = static_cast<int>(r.i64());
+        pte.released = r.boolean();
+        pte.last_ref = r.u64();
+    }
+
+    if (r.boolean())
+        p.blocked_vpn_ = r.u64();
+
+    p.heap_->load(r);
+
+    p.vmas_.clear();
+    for (uint64_t n = r.u64(); n > 0; --n) {
+        VMA v;
+        v.start = r.u64();
+        v.end = r.u64();
+        v.kind = static_cast<VmaKind>(r.u64());
+        p.vmas_[v.start] = v;
+    }
+
+    p.counters_.brk_grows = r.u64();
+    p.counters_.mmap_bytes = r.u64();
+    p.counters_.tcache_hits = r.u64();
+    p.counters_.tcache_misses = r.u64();
+    p.counters_.central_ops = r.u64();
+    p.counters_.cross_thread_frees = r.u64();
+    p.counters_.stranded_bytes = r.u64();
+
+    p.threads_.clear();
+    for (uint64_t n = r.u64(); n > 0; --n) {
+        uint32_t tid = static_cast<uint32_t>(r.u64());
+        auto &tc = p.threads_.emplace(tid, ThreadCache(0)).first->second;
+        tc.load(r);
+    }
+
+    p.resident_pages_ = r.u64();
+    p.vtime_ = r.u64();
+    p.last_fault_ = r.u64();
+    return p;
+}
+
 } // namespace sim
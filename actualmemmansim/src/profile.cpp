@@ -0,0 +1,226 @@
+#include "sim/profile.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define SIM_PROFILE_RDTSC 1
+#endif
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace sim {
+
+bool Profiler::enabled_ = false;
+
+namespace {
+
+struct ZoneStats {
+    uint64_t ticks = 0;
+    uint64_t calls = 0;
+};
+
+ZoneStats zones[Profiler::NUM_ZONES];
+uint64_t open_since[Profiler::NUM_ZONES];
+uint64_t events_handled = 0;
+
+// Calibration stamps taken at enable() and report()
+uint64_t start_ticks = 0;
+std::chrono::steady_clock::time_point start_wall;
+
+#ifdef MEMSIM_PROFILE
+const char *zone_name(int z) {
+    switch (z) {
+        case Profiler::PARSE:       return "parse";
+        case Profiler::EVENT_LOOP:  return "event_loop";
+        case Profiler::QUEUE:       return "  queue_pop";
+        case Profiler::MMU_ACCESS:  return "  mmu_access";
+        case Profiler::PAGEIN:      return "  pagein";
+        case Profiler::FRAME_ALLOC: return "    frame_alloc";
+        case Profiler::HEAP:        return "  heap";
+        default:                    return "?";
+    }
+}
+#endif
+
+// ---------------- Hardware counters ----------------
+
+#if defined(__linux__)
+struct HwCounter {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+    int fd;
+};
+
+HwCounter hw[] = {
+    { "cycles",        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,       -1 },
+    { "instructions",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,     -1 },
+    { "cache_misses",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,     -1 },
+    { "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES,    -1 },
+};
+
+void hw_open() {
+    for (auto &c : hw) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = c.type;
+        attr.config = c.config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        c.fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        if (c.fd >= 0) {
+            ioctl(c.fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(c.fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+bool hw_report(std::ostream &os) {
+    bool any = false;
+    uint64_t values[sizeof(hw) / sizeof(hw[0])] = {};
+    bool have[sizeof(hw) / sizeof(hw[0])] = {};
+    for (size_t i = 0; i < sizeof(hw) / sizeof(hw[0]); ++i) {
+        if (hw[i].fd < 0)
+            continue;
+        ioctl(hw[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+        have[i] = read(hw[i].fd, &values[i], sizeof(values[i])) == sizeof(values[i]);
+        close(hw[i].fd);
+        hw[i].fd = -1;
+        any = any || have[i];
+    }
+    if (!any)
+        return false;
+
+    char line[128];
+    for (size_t i = 0; i < sizeof(hw) / sizeof(hw[0]); ++i) {
+        if (!have[i])
+            continue;
+        std::snprintf(line, sizeof(line), "  %-16s %16llu\n", hw[i].name,
+                      (unsigned long long)values[i]);
+        os << line;
+    }
+    if (have[0] && have[1] && values[0] != 0) {
+        std::snprintf(line, sizeof(line), "  %-16s %16.2f\n", "ipc",
+                      double(values[1]) / double(values[0]));
+        os << line;
+    }
+    return true;
+}
+#endif
+
+bool hw_requested = false;
+
+} // namespace
+
+void Profiler::enable(bool hw_counters) {
+    enabled_ = true;
+    start_ticks = ticks();
+    start_wall = std::chrono::steady_clock::now();
+    hw_requested = hw_counters;
+#if defined(__linux__)
+    if (hw_counters)
+        hw_open();
+#endif
+}
+
+uint64_t Profiler::ticks() noexcept {
+#ifdef SIM_PROFILE_RDTSC
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+void Profiler::add(Zone zone, uint64_t t) noexcept {
+    zones[zone].ticks += t;
+    ++zones[zone].calls;
+}
+
+void Profiler::begin(Zone zone) noexcept {
+    if (enabled_)
+        open_since[zone] = ticks();
+}
+
+void Profiler::end(Zone zone) noexcept {
+    if (enabled_)
+        add(zone, ticks() - open_since[zone]);
+}
+
+void Profiler::set_events(uint64_t events) noexcept {
+    events_handled = events;
+}
+
+// ---------------- Report ----------------
+
+void Profiler::report(std::ostream &os) {
+    if (!enabled_)
+        return;
+
+    uint64_t total_ticks = ticks() - start_ticks;
+    double wall_ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_wall).count());
+    double ns_per_tick = total_ticks ? wall_ns / double(total_ticks) : 1.0;
+
+    char line[128];
+    os << "\nHost profile:\n";
+    std::snprintf(line, sizeof(line), "  %-16s %12s %12s %7s %10s\n",
+                  "zone", "ms", "calls", "%", "ns/call");
+    os << line;
+
+    auto row = [&](const char *name, uint64_t t, uint64_t calls) {
+        double ms = double(t) * ns_per_tick / 1e6;
+        double pct = total_ticks ? 100.0 * double(t) / double(total_ticks) : 0.0;
+        double per = calls ? double(t) * ns_per_tick / double(calls) : 0.0;
+        std::snprintf(line, sizeof(line), "  %-16s %12.3f %12llu %6.1f%% %10.1f\n",
+                      name, ms, (unsigned long long)calls, pct, per);
+        os << line;
+    };
+
+#ifdef MEMSIM_PROFILE
+    for (int z = 0; z < NUM_ZONES; ++z) {
+        row(zone_name(z), zones[z].ticks, zones[z].calls);
+        if (z == HEAP) {
+            // Loop time outside the zones above: handlers and logging
+            uint64_t inner = zones[QUEUE].ticks + zones[MMU_ACCESS].ticks +
+                             zones[PAGEIN].ticks + zones[HEAP].ticks;
+            uint64_t loop = zones[EVENT_LOOP].ticks;
+            row("  other", loop > inner ? loop - inner : 0, events_handled);
+        }
+    }
+#else
+    os << "  (zones compiled out, build with MEMSIM_PROFILE)\n";
+#endif
+    row("total", total_ticks, 1);
+
+    double secs = wall_ns / 1e9;
+    std::snprintf(line, sizeof(line), "  %-16s %16llu\n  %-16s %16.0f\n",
+                  "events", (unsigned long long)events_handled,
+                  "events_per_sec", secs > 0 ? double(events_handled) / secs : 0.0);
+    os << line;
+
+    if (hw_requested) {
+#if defined(__linux__)
+        if (!hw_report(os))
+            os << "  hardware counters unavailable (perf_event_open failed)\n";
+#else
+        os << "  hardware counters need Linux perf_event_open\n";
+#endif
+    }
+}
+
+} // namespace sim
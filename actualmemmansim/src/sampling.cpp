@@ -0,0 +1,164 @@
+#include "sim/sampling.h"
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace sim {
+
+// Two-sided 95% normal quantile
+static const double CONFIDENCE_Z = 1.96;
+
+void SampleConfig::validate() const {
+    if (period == 0)
+        return;
+    if (window == 0)
+        throw std::invalid_argument("sample: --sample-window must be at least 1");
+    if (window + warmup > period)
+        throw std::invalid_argument("sample: window + warmup must fit in --sample-period");
+}
+
+Sampler::Sampler(const SampleConfig &cfg, const Metrics &metrics)
+    : cfg_(cfg),
+      metrics_(metrics),
+      events_(0),
+      detailed_events_(0),
+      measured_events_(0),
+      served_(0),
+      measuring_(false) {}
+
+bool Sampler::before_event() {
+    uint64_t pos = events_++ % cfg_.period;
+
+    if (pos == 0 && measuring_)
+        close_window();
+    if (pos == cfg_.period - cfg_.window) {
+        start_ = counters();
+        measuring_ = true;
+    }
+
+    if (pos < cfg_.period - cfg_.window - cfg_.warmup)
+        return false;
+    ++detailed_events_;
+    if (measuring_)
+        ++measured_events_;
+    return true;
+}
+
+void Sampler::count_access() noexcept {
+    ++served_;
+}
+
+void Sampler::finish() {
+    if (measuring_)
+        close_window();
+}
+
+size_t Sampler::windows() const noexcept {
+    return windows_.size();
+}
+
+Sampler::Window Sampler::counters() const {
+    Window w;
+    w.served = double(served_);
+    w.accesses = double(metrics_.latency().count());
+    w.faults = double(metrics_.page_faults());
+    w.tlb_hits = double(metrics_.tlb_hits());
+    w.latency = metrics_.latency().mean() * w.accesses;
+    return w;
+}
+
+void Sampler::close_window() {
+    Window end = counters();
+    Window w;
+    w.served = end.served - start_.served;
+    w.accesses = end.accesses - start_.accesses;
+    w.faults = end.faults - start_.faults;
+    w.tlb_hits = end.tlb_hits - start_.tlb_hits;
+    w.latency = end.latency - start_.latency;
+    windows_.push_back(w);
+    measuring_ = false;
+}
+
+// ---------------- Estimation ----------------
+
+// Ratio estimator sum(num) / sum(den) over the windows, with the usual
+// linearised variance and a finite-population correction (every unit
+// measured → zero width)
+Sampler::Estimate Sampler::ratio(double Window::*num, double Window::*den) const {
+    Estimate e;
+    size_t k = windows_.size();
+    double sx = 0.0, sy = 0.0;
+    for (const auto &w : windows_) {
+        sx += w.*den;
+        sy += w.*num;
+    }
+    if (sx == 0.0) {
+        e.half = std::numeric_limits<double>::quiet_NaN();
+        return e;
+    }
+    e.value = sy / sx;
+    if (k < 2) {
+        e.half = std::numeric_limits<double>::quiet_NaN();
+        return e;
+    }
+
+    double ss = 0.0;
+    for (const auto &w : windows_) {
+        double d = w.*num - e.value * w.*den;
+        ss += d * d;
+    }
+    double units = std::ceil(double(events_) / double(cfg_.period));
+    double fpc = units > double(k) ? 1.0 - double(k) / units : 0.0;
+    double mean_x = sx / double(k);
+    double var = fpc * ss / double(k - 1) / (double(k) * mean_x * mean_x);
+    e.half = CONFIDENCE_Z * std::sqrt(var);
+    return e;
+}
+
+// "value ± half", or "value (n/a)" when there is no interval
+static void print_estimate(std::ostream &os, const char *name, double value,
+                           double half, const char *fmt) {
+    char v[64], h[64];
+    std::snprintf(v, sizeof(v), fmt, value);
+    os << "  " << name << v;
+    if (std::isnan(half)) {
+        os << " (n/a)\n";
+        return;
+    }
+    std::snprintf(h, sizeof(h), fmt, half);
+    os << " ± " << h << "\n";
+}
+
+void Sampler::report(std::ostream &os) const {
+    os << "\nSampled estimate (95% confidence):\n";
+    os << "  windows         = " << windows_.size() << "\n";
+    os << "  events          = " << events_ << " (detailed " << detailed_events_
+       << ", measured " << measured_events_ << ")\n";
+    os << "  served          = " << served_ << "\n";
+
+    // Per executed access
+    Estimate fault_rate = ratio(&Window::faults, &Window::accesses);
+    Estimate hit_rate = ratio(&Window::tlb_hits, &Window::accesses);
+    Estimate lat = ratio(&Window::latency, &Window::accesses);
+    print_estimate(os, "fault_rate      = ", fault_rate.value, fault_rate.half, "%.4f");
+    print_estimate(os, "tlb_hit_rate    = ", hit_rate.value, hit_rate.half, "%.4f");
+    print_estimate(os, "latency_mean    = ", lat.value, lat.half, "%.2f");
+
+    // Whole run: per access served, times every access served
+    double n = double(served_);
+    const std::pair<const char *, double Window::*> totals[] = {
+        { "accesses        = ", &Window::accesses },
+        { "page_faults     = ", &Window::faults },
+        { "tlb_hits        = ", &Window::tlb_hits },
+        { "latency_cycles  = ", &Window::latency },
+    };
+    for (const auto &t : totals) {
+        Estimate e = ratio(t.second, &Window::served);
+        print_estimate(os, t.first, e.value * n, e.half * n, "%.0f");
+    }
+}
+
+} // namespace sim
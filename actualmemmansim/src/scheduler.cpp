@@ -1,76 +1,453 @@
 #include "sim/scheduler.h"
+#include "sim/snapshot.h"
 #include <algorithm>
 #include <stdexcept>
+#include <vector>
 
 namespace sim {
 
-Scheduler::Scheduler() = default;
+Scheduler::Scheduler(const SimConfig &cfg)
+    : policy_(cfg.sched),
+      quantum_(cfg.quantum),
+      switch_latency_(cfg.ctx_switch_latency),
+      cores_(cfg.cores),
+      generation_(0),
+      switches_(0),
+      switch_cycles_(0),
+      preemptions_(0),
+      migrations_(0) {}
 
-void Scheduler::add_process(uint32_t pid) {
-    if (states_.count(pid))
+void Scheduler::charge(Entry &e, uint64_t now) {
+    uint64_t d = now > e.since ? now - e.since : 0;
+    switch (e.state) {
+        case ProcessState::READY:
+            e.stats.wait += d;
+            break;
+        case ProcessState::RUNNING:
+            e.stats.cpu += d;
+            e.vruntime += d;
+            break;
+        case ProcessState::BLOCKED:
+            e.stats.blocked += d;
+            break;
+        case ProcessState::SLEEPING:
+            e.stats.idle += d;
+            break;
+        case ProcessState::SUSPENDED:
+            e.stats.suspended += d;
+            break;
+        default:
+            break;
+    }
+    if (now > e.since)
+        e.since = now;
+}
+
+void Scheduler::add_process(uint32_t pid, uint64_t now) {
+    if (procs_.count(pid))
         throw std::runtime_error("Scheduler: process already exists");
 
-    states_[pid] = ProcessState::READY;
-    ready_queue_.push_back(pid);
+    // Core with the fewest live processes
+    std::vector<size_t> load(cores_.size(), 0);
+    for (const auto &p : procs_) {
+        if (p.second.state != ProcessState::TERMINATED)
+            ++load[p.second.core];
+    }
+    uint32_t core = static_cast<uint32_t>(
+        std::min_element(load.begin(), load.end()) - load.begin());
+
+    Entry &e = procs_[pid];
+    e.state = ProcessState::SLEEPING;
+    e.core = core;
+    e.since = now;
+    e.vruntime = cores_[core].min_vruntime;
+}
+
+void Scheduler::work_arrived(uint32_t pid, uint64_t now) {
+    auto it = procs_.find(pid);
+    if (it == procs_.end() || it->second.state != ProcessState::SLEEPING)
+        return;
+
+    charge(it->second, now);
+    make_ready(pid, it->second);
+}
+
+void Scheduler::sleep_current(uint32_t core, uint64_t now) {
+    Core &c = cores_.at(core);
+    if (!c.current)
+        throw std::runtime_error("Scheduler: no running process to put to sleep");
+
+    Entry &e = procs_[*c.current];
+    charge(e, now);
+    e.state = ProcessState::SLEEPING;
+    c.current.reset();
 }
 
-void Scheduler::terminate_process(uint32_t pid) {
-    states_[pid] = ProcessState::TERMINATED;
+void Scheduler::terminate_process(uint32_t pid, uint64_t now) {
+    Entry &e = procs_[pid];
+    charge(e, now);
+    e.state = ProcessState::TERMINATED;
 
     // Remove from ready queue if present
-    ready_queue_.erase(
-        std::remove(ready_queue_.begin(), ready_queue_.end(), pid),
-        ready_queue_.end()
+    Core &c = cores_[e.core];
+    c.ready_queue.erase(
+        std::remove(c.ready_queue.begin(), c.ready_queue.end(), pid),
+        c.ready_queue.end()
     );
 
-    if (current_ && *current_ == pid)
-        current_.reset();
+    if (c.current && *c.current == pid)
+        c.current.reset();
 }
 
-void Scheduler::block_current() {
-    if (!current_)
+void Scheduler::block_current(uint32_t core, uint64_t now) {
+    Core &c = cores_.at(core);
+    if (!c.current)
         throw std::runtime_error("Scheduler: no running process to block");
 
-    states_[*current_] = ProcessState::BLOCKED;
-    current_.reset();
+    Entry &e = procs_[*c.current];
+    charge(e, now);
+    e.state = ProcessState::BLOCKED;
+    c.current.reset();
 }
 
-void Scheduler::wake_process(uint32_t pid) {
-    auto it = states_.find(pid);
-    if (it == states_.end())
+void Scheduler::wake_process(uint32_t pid, uint64_t now, bool has_work) {
+    auto it = procs_.find(pid);
+    if (it == procs_.end())
         throw std::runtime_error("Scheduler: wake unknown process");
 
-    if (it->second != ProcessState::BLOCKED)
+    Entry &e = it->second;
+    if (e.state != ProcessState::BLOCKED)
         return; // ignore spurious wakeups
 
-    it->second = ProcessState::READY;
-    ready_queue_.push_back(pid);
+    charge(e, now);
+    if (has_work)
+        make_ready(pid, e);
+    else
+        e.state = ProcessState::SLEEPING;
+}
+
+void Scheduler::suspend(uint32_t pid, uint64_t now) {
+    auto it = procs_.find(pid);
+    if (it == procs_.end())
+        throw std::runtime_error("Scheduler: suspend unknown process");
+    Entry &e = it->second;
+    if (e.state != ProcessState::READY && e.state != ProcessState::SLEEPING)
+        throw std::runtime_error("Scheduler: only a ready or sleeping process can be suspended");
+
+    charge(e, now);
+    Core &c = cores_[e.core];
+    c.ready_queue.erase(std::remove(c.ready_queue.begin(), c.ready_queue.end(), pid),
+                        c.ready_queue.end());
+    e.state = ProcessState::SUSPENDED;
+}
+
+void Scheduler::resume(uint32_t pid, uint64_t now, bool has_work) {
+    auto it = procs_.find(pid);
+    if (it == procs_.end() || it->second.state != ProcessState::SUSPENDED)
+        return;
+
+    charge(it->second, now);
+    if (has_work)
+        make_ready(pid, it->second);
+    else
+        it->second.state = ProcessState::SLEEPING;
+}
+
+ProcessState Scheduler::state(uint32_t pid) const {
+    auto it = procs_.find(pid);
+    if (it == procs_.end())
+        throw std::runtime_error("Scheduler: unknown process");
+    return it->second.state;
 }
 
-std::optional<uint32_t> Scheduler::schedule_next() {
-    if (current_)
-        return current_;
+void Scheduler::make_ready(uint32_t pid, Entry &e) {
+    e.state = ProcessState::READY;
+
+    // A sleeper comes back at most half a quantum ahead of the pack
+    Core &c = cores_[e.core];
+    uint64_t credit = quantum_ / 2;
+    if (c.min_vruntime > credit)
+        e.vruntime = std::max(e.vruntime, c.min_vruntime - credit);
+    c.ready_queue.push_back(pid);
+}
 
-    while (!ready_queue_.empty()) {
-        uint32_t pid = ready_queue_.front();
-        ready_queue_.pop_front();
+// ---------------- Dispatch ----------------
 
-        if (states_[pid] == ProcessState::READY) {
-            states_[pid] = ProcessState::RUNNING;
-            current_ = pid;
-            return current_;
+std::optional<uint32_t> Scheduler::pick(uint32_t core) {
+    Core &c = cores_[core];
+    if (policy_ != SchedPolicy::CFS) {
+        while (!c.ready_queue.empty()) {
+            uint32_t pid = c.ready_queue.front();
+            c.ready_queue.pop_front();
+            if (procs_[pid].state == ProcessState::READY)
+                return pid;
         }
+        return std::nullopt;
+    }
+
+    // Least vruntime; ties go to the one queued first
+    auto best = c.ready_queue.end();
+    for (auto it = c.ready_queue.begin(); it != c.ready_queue.end(); ++it) {
+        if (best == c.ready_queue.end() || procs_[*it].vruntime < procs_[*best].vruntime)
+            best = it;
+    }
+    if (best == c.ready_queue.end())
+        return std::nullopt;
+    uint32_t pid = *best;
+    c.ready_queue.erase(best);
+    c.min_vruntime = std::max(c.min_vruntime, procs_[pid].vruntime);
+    return pid;
+}
+
+// Idle balancing: only from a core that is running something, so a
+// core never takes what its owner is about to run itself
+bool Scheduler::pull(uint32_t core) {
+    uint32_t busiest = core;
+    for (uint32_t c = 0; c < cores_.size(); ++c) {
+        if (c == core || !cores_[c].current || cores_[c].ready_queue.empty())
+            continue;
+        if (busiest == core ||
+            cores_[c].ready_queue.size() > cores_[busiest].ready_queue.size())
+            busiest = c;
+    }
+    if (busiest == core)
+        return false;
+
+    Core &src = cores_[busiest];
+    Core &dst = cores_[core];
+    uint32_t pid = src.ready_queue.back();
+    src.ready_queue.pop_back();
+
+    // Keep its lag behind the queue it leaves
+    Entry &e = procs_[pid];
+    uint64_t lag = e.vruntime > src.min_vruntime ? e.vruntime - src.min_vruntime : 0;
+    e.vruntime = dst.min_vruntime + lag;
+    e.core = core;
+    ++e.stats.migrations;
+    ++migrations_;
+    dst.ready_queue.push_back(pid);
+    return true;
+}
+
+// rr: the quantum; cfs: the quantum shared by everything runnable here
+uint64_t Scheduler::slice(uint32_t core) const noexcept {
+    if (policy_ == SchedPolicy::RR)
+        return quantum_;
+    uint64_t runnable = cores_[core].ready_queue.size() + 1;
+    return std::max<uint64_t>({ quantum_ / runnable, quantum_ / 8, 1 });
+}
+
+std::optional<uint32_t> Scheduler::schedule_next(uint32_t core, uint64_t now) {
+    Core &c = cores_.at(core);
+    if (c.current)
+        return c.current;
+
+    auto pid = pick(core);
+    if (!pid && pull(core))
+        pid = pick(core);
+    if (!pid)
+        return std::nullopt;
+
+    Entry &e = procs_[*pid];
+    charge(e, now);
+    e.state = ProcessState::RUNNING;
+
+    Dispatch d;
+    d.pid = *pid;
+    d.core = core;
+    d.switched = c.last && *c.last != *pid;
+    if (d.switched) {
+        ++switches_;
+        switch_cycles_ += switch_latency_;
+        ++e.stats.switches;
+        e.since = now + switch_latency_;
     }
+    if (policy_ != SchedPolicy::FIFO) {
+        d.generation = e.generation = ++generation_;
+        d.slice_end = e.since + slice(core);
+    }
+
+    c.last = pid;
+    c.current = pid;
+    c.dispatch = d;
+    return c.current;
+}
+
+std::optional<Dispatch> Scheduler::take_dispatch(uint32_t core) {
+    Core &c = cores_.at(core);
+    auto d = c.dispatch;
+    c.dispatch.reset();
+    return d;
+}
+
+bool Scheduler::preempt(uint32_t pid, uint64_t generation, uint64_t now) {
+    auto it = procs_.find(pid);
+    if (it == procs_.end())
+        return false;
+    Entry &e = it->second;
+    Core &c = cores_[e.core];
+    if (!c.current || *c.current != pid)
+        return false;
+    if (generation != 0 && e.generation != generation)
+        return false;
+
+    charge(e, now);
+    e.state = ProcessState::READY;
+    ++e.stats.preemptions;
+    ++preemptions_;
+    c.ready_queue.push_back(pid);
+    c.current.reset();
+    return true;
+}
+
+std::optional<uint32_t> Scheduler::current(uint32_t core) const {
+    return cores_.at(core).current;
+}
+
+bool Scheduler::has_runnable(uint32_t core) const {
+    const Core &c = cores_.at(core);
+    if (c.current || !c.ready_queue.empty())
+        return true;
+    for (uint32_t o = 0; o < cores_.size(); ++o) {
+        if (o != core && cores_[o].current && !cores_[o].ready_queue.empty())
+            return true;
+    }
+    return false;
+}
+
+uint32_t Scheduler::core_of(uint32_t pid) const {
+    auto it = procs_.find(pid);
+    if (it == procs_.end())
+        throw std::runtime_error("Scheduler: unknown process");
+    return it->second.core;
+}
+
+size_t Scheduler::cores() const noexcept {
+    return cores_.size();
+}
+
+// ---------------- Report ----------------
 
-    return std::nullopt;
+uint64_t Scheduler::switches() const noexcept {
+    return switches_;
 }
 
-std::optional<uint32_t> Scheduler::current() const noexcept {
-    return current_;
+uint64_t Scheduler::switch_cycles() const noexcept {
+    return switch_cycles_;
 }
 
-bool Scheduler::has_runnable() const noexcept {
-    return current_.has_value() || !ready_queue_.empty();
+uint64_t Scheduler::preemptions() const noexcept {
+    return preemptions_;
+}
+
+uint64_t Scheduler::migrations() const noexcept {
+    return migrations_;
+}
+
+std::vector<std::pair<uint32_t, SchedStats>> Scheduler::stats(uint64_t now) const {
+    std::vector<std::pair<uint32_t, SchedStats>> out;
+    out.reserve(procs_.size());
+    for (const auto &p : procs_) {
+        Entry e = p.second;
+        charge(e, now);
+        out.emplace_back(p.first, e.stats);
+    }
+    std::sort(out.begin(), out.end(),
+              [](const auto &a, const auto &b) { return a.first < b.first; });
+    return out;
+}
+
+// ---------------- Checkpoint ----------------
+
+// Entries are written in pid order so equal schedulers give equal bytes
+void Scheduler::save(SnapshotWriter &w) const {
+    w.section("sched");
+    w.u64(cores_.size());
+    for (const Core &c : cores_) {
+        w.u64(c.ready_queue.size());
+        for (uint32_t pid : c.ready_queue)
+            w.u64(pid);
+        w.boolean(c.current.has_value());
+        if (c.current)
+            w.u64(*c.current);
+        w.boolean(c.last.has_value());
+        if (c.last)
+            w.u64(*c.last);
+        w.u64(c.min_vruntime);
+    }
+
+    std::vector<std::pair<uint32_t, const Entry *>> procs;
+    for (const auto &p : procs_)
+        procs.emplace_back(p.first, &p.second);
+    std::sort(procs.begin(), procs.end(),
+              [](const auto &a, const auto &b) { return a.first < b.first; });
+    w.u64(procs.size());
+    for (const auto &p : procs) {
+        const Entry &e = *p.second;
+        w.u64(p.first);
+        w.u64(static_cast<uint64_t>(e.state));
+        w.u64(e.core);
+        w.u64(e.since);
+        w.u64(e.vruntime);
+        w.u64(e.generation);
+        w.u64(e.stats.cpu);
+        w.u64(e.stats.wait);
+        w.u64(e.stats.blocked);
+        w.u64(e.stats.idle);
+        w.u64(e.stats.switches);
+        w.u64(e.stats.preemptions);
+        w.u64(e.stats.migrations);
+        w.u64(e.stats.suspended);
+    }
+
+    w.u64(generation_);
+    w.u64(switches_);
+    w.u64(switch_cycles_);
+    w.u64(preemptions_);
+    w.u64(migrations_);
+}
+
+void Scheduler::load(SnapshotReader &r) {
+    r.section("sched");
+    if (r.u64() != cores_.size())
+        throw std::runtime_error("Scheduler: checkpoint has another number of cores");
+    for (Core &c : cores_) {
+        c.ready_queue.clear();
+        for (uint64_t n = r.u64(); n > 0; --n)
+            c.ready_queue.push_back(static_cast<uint32_t>(r.u64()));
+        c.current.reset();
+        if (r.boolean())
+            c.current = static_cast<uint32_t>(r.u64());
+        c.last.reset();
+        if (r.boolean())
+            c.last = static_cast<uint32_t>(r.u64());
+        c.dispatch.reset();
+        c.min_vruntime = r.u64();
+    }
+
+    procs_.clear();
+    for (uint64_t n = r.u64(); n > 0; --n) {
+        Entry &e = procs_[static_cast<uint32_t>(r.u64())];
+        e.state = static_cast<ProcessState>(r.u64());
+        e.core = static_cast<uint32_t>(r.u64());
+        e.since = r.u64();
+        e.vruntime = r.u64();
+        e.generation = r.u64();
+        e.stats.cpu = r.u64();
+        e.stats.wait = r.u64();
+        e.stats.blocked = r.u64();
+        e.stats.idle = r.u64();
+        e.stats.switches = r.u64();
+        e.stats.preemptions = r.u64();
+        e.stats.migrations = r.u64();
+        e.stats.suspended = r.u64();
+    }
+
+    generation_ = r.u64();
+    switches_ = r.u64();
+    switch_cycles_ = r.u64();
+    preemptions_ = r.u64();
+    migrations_ = r.u64();
 }
 
 } // namespace sim
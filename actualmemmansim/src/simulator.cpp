@@ -0,0 +1,867 @@
+#include "sim/simulator.h"
+#include "sim/profile.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace sim {
+
+static uint64_t parse_u64(const std::string &s) {
+    if (s.size() > 2 && s[0] == '0' &&
+        (s[1] == 'x' || s[1] == 'X')) {
+        return std::stoull(s, nullptr, 16);
+    }
+    return std::stoull(s);
+}
+
+static void update_heap_metrics(Metrics &metrics, const Process &proc) {
+    metrics.update_heap(
+        proc.metrics_slot(),
+        proc.heap().total_heap_size(),
+        proc.heap().allocated_bytes(),
+        proc.heap().free_bytes(),
+        proc.heap().largest_free_block(),
+        proc.heap().internal_fragmentation()
+    );
+}
+
+// Queue a follow-up event from the same thread as `cause`
+static void push_followup(EventQueue &eq, const Event &cause, uint64_t now,
+                          int priority, const std::string &type,
+                          std::vector<std::string> args) {
+    Event ev;
+    ev.key.time = now;
+    ev.key.priority = priority;
+    ev.key.pid = cause.key.pid;
+    ev.tid = cause.tid;
+    ev.type = type;
+    ev.args = std::move(args);
+    eq.push(std::move(ev));
+}
+
+// Queue one ACCESS per page touched by [addr, addr + len), at time `now`
+static void push_range_accesses(EventQueue &eq, const Event &cause, uint64_t now,
+                                uint64_t addr, uint64_t len, uint64_t page_size,
+                                const char *mode) {
+    if (len == 0)
+        return;
+    uint64_t end = addr + len;
+    for (uint64_t a = addr; a < end; a = (a / page_size + 1) * page_size) {
+        std::ostringstream ss;
+        ss << "0x" << std::hex << a;
+        push_followup(eq, cause, now, 3, "ACCESS", { ss.str(), mode });
+    }
+}
+
+// Log record stamped with the event's time and thread
+static LogRecord log_record(LogKind kind, uint64_t now, uint32_t pid, const Event &ev) {
+    LogRecord rec;
+    rec.kind = kind;
+    rec.time = now;
+    rec.pid = pid;
+    rec.tid = ev.tid;
+    return rec;
+}
+
+// ---------------- Simulator ----------------
+
+Simulator::Simulator(const SimConfig &cfg, const Trace &trace, EventLog &log)
+    : cfg_(cfg),
+      trace_(trace),
+      next_trace_(0),
+      log_(log),
+      queue_(trace.events.size() + 1),
+      pmem_(cfg.num_frames, cfg.numa_nodes),
+      mmu_(pmem_, cfg_, metrics_),
+      sched_(cfg_),
+      fast_forward_(false),
+      ckpt_pending_(false),
+      events_handled_(0),
+      cpu_busy_until_(cfg.cores, 0),
+      cpu_wakeup_(cfg.cores, 0),
+      kswapd_pending_(false) {}
+
+void Simulator::enable_timeseries(std::ostream &out, const TimeSeriesConfig &ts_cfg) {
+    ts_ = std::make_unique<TimeSeries>(out, ts_cfg, metrics_, mmu_, pmem_);
+}
+
+void Simulator::enable_sampling(const SampleConfig &sample_cfg) {
+    sampler_ = std::make_unique<Sampler>(sample_cfg, metrics_);
+}
+
+const Sampler *Simulator::sampler() const noexcept {
+    return sampler_.get();
+}
+
+uint64_t Simulator::now() const noexcept {
+    return clock_.now();
+}
+
+const Scheduler& Simulator::scheduler() const noexcept {
+    return sched_;
+}
+
+const MMU& Simulator::mmu() const noexcept {
+    return mmu_;
+}
+
+const PhysicalMemory& Simulator::memory() const noexcept {
+    return pmem_;
+}
+
+uint64_t Simulator::events_handled() const noexcept {
+    return events_handled_;
+}
+
+const Metrics& Simulator::metrics() const noexcept {
+    return metrics_;
+}
+
+const SimConfig& Simulator::config() const noexcept {
+    return cfg_;
+}
+
+// ---------------- Checkpoint ----------------
+
+void Simulator::set_checkpoint(const CheckpointConfig &ckpt) {
+    ckpt_ = ckpt;
+    ckpt_pending_ = !ckpt.path.empty();
+}
+
+bool Simulator::checkpoint_pending() const noexcept {
+    return ckpt_pending_;
+}
+
+bool Simulator::checkpoint_due(const Event &next) const {
+    if (ckpt_.at_events)
+        return events_handled_ >= ckpt_.at_events;
+    return next.key.time >= ckpt_.at_cycles;
+}
+
+// FNV-1a over what makes one trace differ from another
+uint64_t Simulator::trace_fingerprint() const {
+    uint64_t h = 0xcbf29ce484222325ull;
+    auto mix = [&h](uint64_t v) {
+        for (int i = 0; i < 8; ++i, v >>= 8) {
+            h ^= v & 0xff;
+            h *= 0x100000001b3ull;
+        }
+    };
+    for (const auto &ev : trace_.events) {
+        mix(ev.key.time);
+        mix(ev.key.pid);
+        mix(ev.tid);
+        mix(std::hash<std::string>()(ev.type));
+        for (const auto &a : ev.args)
+            mix(std::hash<std::string>()(a));
+    }
+    return h;
+}
+
+void Simulator::write_checkpoint() {
+    std::ofstream out(ckpt_.path, std::ios::binary);
+    if (!out)
+        throw std::runtime_error("Simulator: cannot open " + ckpt_.path);
+    save(out);
+    ckpt_pending_ = false;
+}
+
+void Simulator::save(std::ostream &out) const {
+    SnapshotWriter w;
+
+    w.section("sim");
+    w.u64(trace_.events.size());
+    w.u64(trace_fingerprint());
+    w.u64(cfg_.page_size);
+    w.u64(cfg_.num_frames);
+    w.u64(cfg_.tlb_size);
+    w.u64(cfg_.cores);
+    w.u64(cfg_.numa_nodes);
+    w.u64(clock_.now());
+    w.u64(next_trace_);
+    w.u64(events_handled_);
+
+    // Streams in pid order so equal simulators give equal bytes
+    std::vector<uint32_t> pids;
+    for (const auto &st : streams_)
+        pids.push_back(st.first);
+    std::sort(pids.begin(), pids.end());
+    w.u64(pids.size());
+    for (uint32_t pid : pids) {
+        const auto &stream = streams_.at(pid);
+        w.u64(pid);
+        w.u64(stream.size());
+        for (const auto &a : stream) {
+            w.u64(a.vaddr);
+            w.u64(a.arrival);
+            w.u64(a.start);
+            w.u64(a.tid);
+            w.u64(a.free_addr);
+        }
+    }
+    w.u64(exit_pending_.size());
+    for (const auto &e : exit_pending_) {
+        w.u64(e.first);
+        w.u64(e.second);
+    }
+    for (size_t c = 0; c < cfg_.cores; ++c) {
+        w.u64(cpu_busy_until_[c]);
+        w.u64(cpu_wakeup_[c]);
+    }
+    w.u64(suspended_.size());
+    for (const auto &s : suspended_) {
+        w.u64(s.pid);
+        w.u64(s.pages);
+        w.boolean(s.accounted);
+    }
+    w.boolean(kswapd_pending_);
+
+    queue_.save(w);
+    pmem_.save(w);
+    mmu_.save(w);
+    sched_.save(w);
+    metrics_.save(w);
+
+    out.write(w.data().data(), static_cast<std::streamsize>(w.data().size()));
+    if (!out)
+        throw std::runtime_error("Simulator: checkpoint write failed");
+}
+
+void Simulator::restore(const std::string &snapshot) {
+    SnapshotReader r(snapshot);
+
+    r.section("sim");
+    if (r.u64() != trace_.events.size() || r.u64() != trace_fingerprint())
+        throw std::runtime_error("Simulator: checkpoint was taken over another trace");
+    if (r.u64() != cfg_.page_size)
+        throw std::runtime_error("Simulator: checkpoint has another page-size");
+    if (r.u64() != cfg_.num_frames)
+        throw std::runtime_error("Simulator: checkpoint has another frames");
+    if (r.u64() != cfg_.tlb_size)
+        throw std::runtime_error("Simulator: checkpoint has another tlb-size");
+    if (r.u64() != cfg_.cores)
+        throw std::runtime_error("Simulator: checkpoint has another cores");
+    if (r.u64() != cfg_.numa_nodes)
+        throw std::runtime_error("Simulator: checkpoint has another numa-nodes");
+    clock_.set(r.u64());
+    next_trace_ = r.u64();
+    events_handled_ = r.u64();
+
+    streams_.clear();
+    for (uint64_t n = r.u64(); n > 0; --n) {
+        auto &stream = streams_[static_cast<uint32_t>(r.u64())];
+        for (uint64_t k = r.u64(); k > 0; --k) {
+            PendingAccess a;
+            a.vaddr = r.u64();
+            a.arrival = r.u64();
+            a.start = r.u64();
+            a.tid = static_cast<uint32_t>(r.u64());
+            a.free_addr = r.u64();
+            stream.push_back(a);
+        }
+    }
+    exit_pending_.clear();
+    for (uint64_t n = r.u64(); n > 0; --n) {
+        uint32_t pid = static_cast<uint32_t>(r.u64());
+        exit_pending_[pid] = static_cast<uint32_t>(r.u64());
+    }
+    for (size_t c = 0; c < cfg_.cores; ++c) {
+        cpu_busy_until_[c] = r.u64();
+        cpu_wakeup_[c] = r.u64();
+    }
+    suspended_.clear();
+    for (uint64_t n = r.u64(); n > 0; --n) {
+        Suspension s;
+        s.pid = static_cast<uint32_t>(r.u64());
+        s.pages = r.u64();
+        s.accounted = r.boolean();
+        suspended_.push_back(s);
+    }
+    kswapd_pending_ = r.boolean();
+
+    queue_.load(r);
+    pmem_.load(r);
+    mmu_.load(r);
+    sched_.load(r);
+    metrics_.load(r);
+
+    if (!r.at_end())
+        throw std::runtime_error("Simulator: trailing bytes in checkpoint");
+}
+
+// ---------------- Event loop ----------------
+
+void Simulator::run() {
+    EventCompare after;
+    Event popped;
+
+    SIM_PROFILE_BEGIN(EVENT_LOOP);
+    while (next_trace_ < trace_.events.size() || !queue_.empty()) {
+        bool from_trace = next_trace_ < trace_.events.size() &&
+            (queue_.empty() || !after(trace_.events[next_trace_], queue_.top()));
+
+        // Checkpoint between events, before the next one is taken
+        if (ckpt_pending_ &&
+            checkpoint_due(from_trace ? trace_.events[next_trace_] : queue_.top())) {
+            write_checkpoint();
+            if (ckpt_.stop)
+                break;
+        }
+
+        const Event *ev;
+        {
+            SIM_PROFILE_SCOPE(QUEUE);
+            if (from_trace) {
+                ev = &trace_.events[next_trace_++];
+            } else {
+                popped = queue_.pop();
+                ev = &popped;
+            }
+        }
+        ++events_handled_;
+        if (ts_)
+            ts_->before_event(ev->key.time, clock_.now());
+        if (sampler_)
+            fast_forward_ = !sampler_->before_event();
+
+        if (ev->key.time > clock_.now())
+            clock_.set(ev->key.time);
+
+        handle(*ev);
+    }
+    SIM_PROFILE_END(EVENT_LOOP);
+
+    if (ts_)
+        ts_->finish(clock_.now());
+    if (sampler_)
+        sampler_->finish();
+    fast_forward_ = false;
+}
+
+// TLB switch policy and the slice's TIMER for what schedule_next() put
+// on the CPU
+void Simulator::on_dispatch(const std::optional<Dispatch> &d) {
+    if (!d)
+        return;
+    if (d->switched && cfg_.tlb_switch == TlbSwitchPolicy::FLUSH)
+        mmu_.flush_tlb(d->core);
+    if (d->slice_end != 0)
+        queue_.push(d->slice_end, 2, d->pid, "TIMER", { std::to_string(d->generation) });
+}
+
+// ---------------- CPU ----------------
+
+// Charges pending shootdown stalls, then gives every core its turn
+void Simulator::run_cpus() {
+    charge_shootdowns();
+    for (uint32_t c = 0; c < cfg_.cores; ++c)
+        run_cpu(c);
+}
+
+void Simulator::charge_shootdowns() {
+    uint64_t now = clock_.now();
+    for (uint32_t c = 0; c < cfg_.cores; ++c) {
+        if (uint64_t stall = mmu_.take_shootdown_stall(c))
+            cpu_busy_until_[c] = std::max(cpu_busy_until_[c], now) + stall;
+    }
+}
+
+// Runs queued accesses on core until it is busy or has nothing to run;
+// a busy core with work waiting comes back here through one RUN event
+void Simulator::run_cpu(uint32_t core) {
+    for (;;) {
+        uint64_t now = clock_.now();
+        if (now < cpu_busy_until_[core]) {
+            // Work arriving later calls back in here
+            if (sched_.has_runnable(core) && cpu_wakeup_[core] != cpu_busy_until_[core]) {
+                cpu_wakeup_[core] = cpu_busy_until_[core];
+                queue_.push(cpu_busy_until_[core], 1, 0, "RUN",
+                                  { std::to_string(core) });
+            }
+            return;
+        }
+
+        auto running = sched_.schedule_next(core, now);
+        if (!running)
+            return;
+        auto d = sched_.take_dispatch(core);
+        if (d && d->switched)
+            cpu_busy_until_[core] = now + cfg_.ctx_switch_latency;
+        on_dispatch(d);
+        if (now < cpu_busy_until_[core])
+            continue;
+
+        uint32_t pid = *running;
+        PendingAccess &a = streams_[pid].front();
+        a.start = now;
+
+        // The copy ahead of it is done: its shootdowns hit the cores now
+        if (a.free_addr != 0) {
+            if (free_block(pid, a.tid, a.free_addr))
+                charge_shootdowns();
+            finish_access(pid, now);
+            continue;
+        }
+
+        // Fast-forward times accesses and blocks on faults as the detailed
+        // path does, so both leave the same state behind
+        if (sampler_)
+            sampler_->count_access();
+        bool done;
+        if (fast_forward_)
+            done = mmu_.warm_access(pid, a.vaddr, core);
+        else
+            done = mmu_.access(pid, a.vaddr, core) != MMUAccessResult::PAGE_FAULT;
+        LogRecord rec;
+        rec.time = now;
+        rec.pid = pid;
+        rec.tid = a.tid;
+
+        if (done) {
+            rec.kind = LogKind::ACCESS_HIT;
+            rec.a = a.vaddr;
+            log(rec);
+
+            cpu_busy_until_[core] = now + mmu_.last_access_latency();
+            finish_access(pid, cpu_busy_until_[core]);
+        } else {
+            // Done when the page is in; the process waits for it
+            sched_.block_current(core, now);
+
+            uint64_t vpn = mmu_.vpn_from_vaddr(a.vaddr);
+            queue_.push(now + mmu_.last_pagein_latency(),
+                    0,
+                    pid,
+                    "PAGEIN_COMPLETE",
+                    { std::to_string(vpn) });
+
+            rec.kind = LogKind::PAGE_FAULT;
+            rec.a = vpn;
+            log(rec);
+        }
+    }
+}
+
+// The access at the head of pid's stream is done; a process left with
+// nothing to do sleeps, or exits if its PROC_EXIT was waiting
+void Simulator::finish_access(uint32_t pid, uint64_t done) {
+    auto &stream = streams_[pid];
+    const PendingAccess &a = stream.front();
+    if (!fast_forward_ && a.free_addr == 0)
+        metrics_.record_stream_access(mmu_.process(pid).metrics_slot(),
+                                      a.arrival, a.start, done);
+    stream.pop_front();
+    if (!stream.empty())
+        return;
+
+    uint32_t core = sched_.core_of(pid);
+    if (sched_.current(core) == pid)
+        sched_.sleep_current(core, done);
+    auto it = exit_pending_.find(pid);
+    if (it != exit_pending_.end()) {
+        uint32_t tid = it->second;
+        exit_pending_.erase(it);
+        exit_process(pid, tid);
+    }
+}
+
+// FREE by pid's thread tid; true if it gave pages back
+bool Simulator::free_block(uint32_t pid, uint32_t tid, uint64_t addr) {
+    auto &proc = mmu_.process(pid);
+    uint64_t now = clock_.now();
+    uint64_t released = mmu_.heap_free(pid, addr, now, tid);
+
+    update_heap_metrics(metrics_, proc);
+
+    LogRecord rec;
+    rec.kind = LogKind::FREE;
+    rec.time = now;
+    rec.pid = pid;
+    rec.tid = tid;
+    rec.a = addr;
+    rec.b = released;
+    log(rec);
+    if (released)
+        resume_suspended();
+    return released != 0;
+}
+
+void Simulator::exit_process(uint32_t pid, uint32_t tid) {
+    mmu_.unregister_process(pid, clock_.now());
+    sched_.terminate_process(pid, clock_.now());
+    streams_.erase(pid);
+
+    LogRecord rec;
+    rec.kind = LogKind::PROC_EXIT;
+    rec.time = clock_.now();
+    rec.pid = pid;
+    rec.tid = tid;
+    log(rec);
+
+    resume_suspended();
+}
+
+// Wakes the process whose page came in and completes its access
+void Simulator::finish_pagein(uint32_t pid, uint64_t vpn, const Event &ev) {
+    uint64_t now = clock_.now();
+    sched_.wake_process(pid, now, streams_[pid].size() > 1);
+
+    auto rec = log_record(LogKind::PAGEIN_COMPLETE, now, pid, ev);
+    rec.a = vpn;
+    log(rec);
+
+    if (!fast_forward_)
+        metrics_.record_fault_service(now - streams_[pid].front().start);
+    finish_access(pid, now);
+    resume_suspended();
+    run_cpus();
+}
+
+// ---------------- Background reclaim ----------------
+
+// Free frames fell under watermark-low: queue a pass unless one is
+void Simulator::wake_kswapd() {
+    if (cfg_.watermark_low == 0 || kswapd_pending_ || fast_forward_)
+        return;
+    if (pmem_.num_frames() - pmem_.used_frames() >= cfg_.watermark_low)
+        return;
+
+    kswapd_pending_ = true;
+    metrics_.record_kswapd_wakeup();
+    queue_.push(clock_.now(), 1, 0, "KSWAPD", {});
+}
+
+// ---------------- Load control ----------------
+
+// Memory still full at pid's fault: swap out the largest resident set
+// that is not running or paging in (ties: higher pid)
+void Simulator::load_control(uint32_t pid) {
+    if (pmem_.used_frames() < pmem_.num_frames())
+        return;
+
+    uint32_t victim = 0;
+    uint64_t most = 0;
+    for (const auto &p : mmu_.processes()) {
+        if (p.first == pid)
+            continue;
+        ProcessState st = sched_.state(p.first);
+        if (st != ProcessState::READY && st != ProcessState::SLEEPING)
+            continue;
+        uint64_t pages = p.second.resident_pages();
+        if (pages > most || (pages == most && pages != 0 && p.first > victim)) {
+            victim = p.first;
+            most = pages;
+        }
+    }
+    if (most == 0)
+        return;
+
+    uint64_t now = clock_.now();
+    uint64_t pages = mmu_.swap_out(victim, now, !fast_forward_);
+    sched_.suspend(victim, now);
+    suspended_.push_back(Suspension{ victim, pages, !fast_forward_ });
+
+    LogRecord rec;
+    rec.kind = LogKind::SUSPEND;
+    rec.time = now;
+    rec.pid = victim;
+    rec.a = pages;
+    log(rec);
+}
+
+// Brings suspended processes back, oldest first, while their old
+// resident sets fit in the free frames. Called from inside run_cpu(),
+// so the cores pick them up through a RUN event.
+void Simulator::resume_suspended() {
+    while (!suspended_.empty()) {
+        Suspension s = suspended_.front();
+        uint32_t pid = s.pid;
+        if (mmu_.processes().count(pid) == 0) {
+            suspended_.pop_front();
+            continue;
+        }
+        if (pmem_.num_frames() - pmem_.used_frames() < s.pages)
+            return;
+        suspended_.pop_front();
+
+        uint64_t now = clock_.now();
+        auto it = streams_.find(pid);
+        sched_.resume(pid, now, it != streams_.end() && !it->second.empty());
+        if (s.accounted)
+            metrics_.record_resume(mmu_.process(pid).metrics_slot());
+
+        LogRecord rec;
+        rec.kind = LogKind::RESUME;
+        rec.time = now;
+        rec.pid = pid;
+        log(rec);
+
+        uint32_t core = sched_.core_of(pid);
+        queue_.push(now, 1, 0, "RUN", { std::to_string(core) });
+    }
+}
+
+// Fast-forward is silent apart from failures
+void Simulator::log(const LogRecord &rec) {
+    if (!fast_forward_ || is_failure(rec.kind))
+        log_.record(rec);
+}
+
+void Simulator::handle(const Event &ev) {
+    uint32_t pid = ev.key.pid;
+
+    // ---------- PROCESS START ----------
+    // args: heap_base, heap_top, [cgroup path]
+    if (ev.type == "PROC_START") {
+        uint64_t heap_base = parse_u64(ev.args[0]);
+        uint64_t heap_top  = parse_u64(ev.args[1]);
+        uint64_t heap_size = heap_top - heap_base;
+
+        mmu_.register_process(pid, heap_base, heap_size,
+                              ev.args.size() > 2 ? ev.args[2] : std::string());
+        sched_.add_process(pid, clock_.now());
+
+        log(log_record(LogKind::PROC_START, clock_.now(), pid, ev));
+    }
+
+    // ---------- PROCESS EXIT ----------
+    // Waits for accesses still queued or paging in
+    else if (ev.type == "PROC_EXIT") {
+        auto it = streams_.find(pid);
+        if (it != streams_.end() && !it->second.empty()) {
+            exit_pending_[pid] = ev.tid;
+            return;
+        }
+        exit_process(pid, ev.tid);
+    }
+
+    // ---------- THREAD START / EXIT ----------
+    else if (ev.type == "THREAD_START") {
+        mmu_.thread_start(pid, ev.tid);
+
+        log(log_record(LogKind::THREAD_START, clock_.now(), pid, ev));
+    }
+
+    else if (ev.type == "THREAD_EXIT") {
+        uint64_t released = mmu_.thread_exit(pid, ev.tid, clock_.now());
+        update_heap_metrics(metrics_, mmu_.process(pid));
+
+        auto rec = log_record(LogKind::THREAD_EXIT, clock_.now(), pid, ev);
+        rec.a = released;
+        log(rec);
+        if (released) {
+            resume_suspended();
+            run_cpus();     // shootdown stalls
+        }
+    }
+
+    // ---------- MALLOC ----------
+    else if (ev.type == "MALLOC") {
+        auto &proc = mmu_.process(pid);
+        uint64_t size = parse_u64(ev.args[0]);
+
+        auto addr = mmu_.heap_alloc(pid, size, ev.tid);
+        if (!addr) {
+            log(log_record(LogKind::MALLOC_FAILED, clock_.now(), pid, ev));
+            return;
+        }
+
+        update_heap_metrics(metrics_, proc);
+
+        auto rec = log_record(LogKind::MALLOC, clock_.now(), pid, ev);
+        rec.a = size;
+        rec.b = *addr;
+        log(rec);
+    }
+
+    // ---------- FREE ----------
+    else if (ev.type == "FREE") {
+        if (free_block(pid, ev.tid, parse_u64(ev.args[0])))
+            run_cpus();     // shootdown stalls
+    }
+
+    // ---------- REALLOC ----------
+    // args: old_addr (0 = malloc), new_size (0 = free)
+    else if (ev.type == "REALLOC") {
+        if (ev.args.size() < 2)
+            throw std::runtime_error("Simulator: REALLOC needs old_addr and new_size");
+        auto &proc = mmu_.process(pid);
+        uint64_t old_addr = parse_u64(ev.args[0]);
+        uint64_t size = parse_u64(ev.args[1]);
+
+        if (old_addr == 0) {
+            push_followup(queue_, ev, clock_.now(), 4, "MALLOC", { ev.args[1] });
+            return;
+        }
+        if (size == 0) {
+            push_followup(queue_, ev, clock_.now(), 4, "FREE", { ev.args[0] });
+            return;
+        }
+
+        auto res = mmu_.heap_realloc(pid, old_addr, size, ev.tid);
+        if (!res.addr) {
+            log(log_record(LogKind::REALLOC_FAILED, clock_.now(), pid, ev));
+            return;
+        }
+
+        // Moved: copy page by page, then free the old block. The free
+        // follows the copy on the stream, so it waits for the last access
+        if (res.moved) {
+            push_range_accesses(queue_, ev, clock_.now(), old_addr,
+                                res.copy_bytes, cfg_.page_size, "R");
+            push_range_accesses(queue_, ev, clock_.now(), *res.addr,
+                                res.copy_bytes, cfg_.page_size, "W");
+            push_followup(queue_, ev, clock_.now(), 3, "COPY_FREE", { ev.args[0] });
+        }
+
+        update_heap_metrics(metrics_, proc);
+
+        auto rec = log_record(LogKind::REALLOC, clock_.now(), pid, ev);
+        rec.a = old_addr;
+        rec.b = size;
+        rec.c = *res.addr;
+        rec.d = res.copy_bytes;
+        rec.moved = res.moved;
+        log(rec);
+    }
+
+    // ---------- CALLOC ----------
+    // args: count, [elem_size = 1]
+    else if (ev.type == "CALLOC") {
+        auto &proc = mmu_.process(pid);
+        uint64_t count = parse_u64(ev.args[0]);
+        uint64_t elem = ev.args.size() > 1 ? parse_u64(ev.args[1]) : 1;
+        uint64_t size = count * elem;
+
+        // count * elem_size overflowing fails like calloc does
+        CallocResult res;
+        if (elem == 0 || count <= UINT64_MAX / elem)
+            res = mmu_.heap_calloc(pid, size, ev.tid);
+        if (!res.addr) {
+            log(log_record(LogKind::CALLOC_FAILED, clock_.now(), pid, ev));
+            return;
+        }
+
+        // memset only the pages that may hold old data
+        for (uint64_t vpn : res.zero_vpns) {
+            uint64_t lo = std::max(*res.addr, vpn * cfg_.page_size);
+            push_range_accesses(queue_, ev, clock_.now(), lo, 1, cfg_.page_size, "W");
+        }
+
+        update_heap_metrics(metrics_, proc);
+
+        auto rec = log_record(LogKind::CALLOC, clock_.now(), pid, ev);
+        rec.a = size;
+        rec.b = *res.addr;
+        rec.c = res.zero_vpns.size();
+        log(rec);
+    }
+
+    // ---------- ACCESS ----------
+    // Queued on the process's stream; run_cpu() serves it in turn
+    else if (ev.type == "ACCESS") {
+        mmu_.process(pid);  // unknown process throws here, not later
+
+        PendingAccess a;
+        a.vaddr = parse_u64(ev.args[0]);
+        a.arrival = clock_.now();
+        a.tid = ev.tid;
+        streams_[pid].push_back(a);
+
+        sched_.work_arrived(pid, clock_.now());
+        run_cpus();
+    }
+
+    // ---------- COPY FREE ----------
+    // REALLOC's old block joins the stream behind its copy
+    else if (ev.type == "COPY_FREE") {
+        PendingAccess a;
+        a.arrival = clock_.now();
+        a.tid = ev.tid;
+        a.free_addr = parse_u64(ev.args[0]);
+        streams_[pid].push_back(a);
+
+        sched_.work_arrived(pid, clock_.now());
+        run_cpus();
+    }
+
+    // ---------- PAGEIN COMPLETE ----------
+    // Maps the page; the faulting access at the head of the stream
+    // completes now, or after the direct reclaim it needed
+    else if (ev.type == "PAGEIN_COMPLETE") {
+        uint64_t vpn = std::stoull(ev.args[0]);
+
+        if (cfg_.frame_policy == FramePolicy::WS || cfg_.frame_policy == FramePolicy::PFF) {
+            mmu_.trim_resident_set(pid, clock_.now(), !fast_forward_);
+            load_control(pid);
+        }
+        bool direct = mmu_.complete_pagein(pid, vpn, clock_.now(), sched_.core_of(pid),
+                                           !fast_forward_);
+        uint64_t stall = (direct ? cfg_.reclaim_latency : 0) + mmu_.take_compress_cycles();
+        wake_kswapd();
+        if (direct && !fast_forward_)
+            metrics_.record_direct_reclaim(stall);
+        if (stall != 0) {
+            push_followup(queue_, ev, clock_.now() + stall, 0,
+                          "RECLAIM_DONE", ev.args);
+            run_cpus();     // shootdown stalls
+            return;
+        }
+        finish_pagein(pid, vpn, ev);
+    }
+
+    else if (ev.type == "RECLAIM_DONE") {
+        finish_pagein(pid, parse_u64(ev.args[0]), ev);
+    }
+
+    // ---------- KSWAPD ----------
+    // One background pass toward watermark-high; the next follows once
+    // this one's reclaim time is over
+    else if (ev.type == "KSWAPD") {
+        uint64_t free = pmem_.num_frames() - pmem_.used_frames();
+        uint64_t got = 0;
+        if (free < cfg_.watermark_high)
+            got = mmu_.reclaim(std::min(cfg_.kswapd_batch, cfg_.watermark_high - free),
+                               clock_.now(), !fast_forward_);
+        uint64_t busy = got * cfg_.reclaim_latency + mmu_.take_compress_cycles();
+        if (got) {
+            if (!fast_forward_)
+                metrics_.record_kswapd_batch(got);
+
+            LogRecord rec;
+            rec.kind = LogKind::KSWAPD;
+            rec.time = clock_.now();
+            rec.a = got;
+            rec.b = free + got;
+            log(rec);
+        }
+
+        if (got && free + got < cfg_.watermark_high)
+            queue_.push(clock_.now() + busy, 1, 0, "KSWAPD", {});
+        else
+            kswapd_pending_ = false;
+        run_cpus();     // shootdown stalls
+    }
+
+    // ---------- RUN ----------
+    // A core is free again after a hit, a context switch or a shootdown
+    else if (ev.type == "RUN") {
+        cpu_wakeup_[parse_u64(ev.args[0])] = 0;
+        run_cpus();
+    }
+
+    // ---------- TIMER ----------
+    // Queued at dispatch with the slice's generation; one from the trace
+    // (no args) preempts the process whatever slice it is in
+    else if (ev.type == "TIMER") {
+        uint64_t generation = ev.args.empty() ? 0 : parse_u64(ev.args[0]);
+        if (sched_.preempt(pid, generation, clock_.now())) {
+            log(log_record(LogKind::PREEMPT, clock_.now(), pid, ev));
+            run_cpus();
+        }
+    }
+}
+
+} // namespace sim
@@ -0,0 +1,111 @@
+#include "sim/snapshot.h"
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace sim {
+
+static const char MAGIC[8] = { 'M', 'S', 'I', 'M', 'C', 'K', 'P', '1' };
+
+// ---------------- Writer ----------------
+
+SnapshotWriter::SnapshotWriter() : buf_(MAGIC, sizeof(MAGIC)) {}
+
+void SnapshotWriter::section(const char *name) {
+    str(name);
+}
+
+void SnapshotWriter::u64(uint64_t v) {
+    while (v >= 0x80) {
+        buf_ += static_cast<char>((v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    buf_ += static_cast<char>(v);
+}
+
+void SnapshotWriter::i64(int64_t v) {
+    u64((static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63));
+}
+
+void SnapshotWriter::boolean(bool b) {
+    buf_ += b ? '\1' : '\0';
+}
+
+void SnapshotWriter::str(const std::string &s) {
+    u64(s.size());
+    buf_ += s;
+}
+
+// Mantissa as a 64-bit integer plus the binary exponent
+void SnapshotWriter::real(long double v) {
+    int exp = 0;
+    long double m = std::frexp(v, &exp);
+    boolean(m < 0);
+    u64(static_cast<uint64_t>(std::ldexp(std::fabs(m), 64)));
+    i64(exp);
+}
+
+const std::string &SnapshotWriter::data() const noexcept {
+    return buf_;
+}
+
+// ---------------- Reader ----------------
+
+SnapshotReader::SnapshotReader(const std::string &data)
+    : data_(data), pos_(sizeof(MAGIC)) {
+    if (data.size() < sizeof(MAGIC) || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0)
+        throw std::runtime_error("Snapshot: not a checkpoint file");
+}
+
+void SnapshotReader::section(const char *name) {
+    if (str() != name)
+        throw std::runtime_error(std::string("Snapshot: corrupt, expected section ") + name);
+}
+
+uint64_t SnapshotReader::u64() {
+    uint64_t v = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (pos_ >= data_.size())
+            throw std::runtime_error("Snapshot: truncated");
+        uint8_t b = static_cast<uint8_t>(data_[pos_++]);
+        v |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return v;
+    }
+    throw std::runtime_error("Snapshot: bad varint");
+}
+
+int64_t SnapshotReader::i64() {
+    uint64_t zz = u64();
+    return static_cast<int64_t>((zz >> 1) ^ (~(zz & 1) + 1));
+}
+
+bool SnapshotReader::boolean() {
+    if (pos_ >= data_.size())
+        throw std::runtime_error("Snapshot: truncated");
+    return data_[pos_++] != 0;
+}
+
+std::string SnapshotReader::str() {
+    uint64_t n = u64();
+    if (n > data_.size() - pos_)
+        throw std::runtime_error("Snapshot: truncated");
+    std::string s = data_.substr(pos_, n);
+    pos_ += n;
+    return s;
+}
+
+long double SnapshotReader::real() {
+    bool neg = boolean();
+    long double m = std::ldexp(static_cast<long double>(u64()), -64);
+    int exp = static_cast<int>(i64());
+    long double v = std::ldexp(m, exp);
+    return neg ? -v : v;
+}
+
+bool SnapshotReader::at_end() const noexcept {
+    return pos_ == data_.size();
+}
+
+} // namespace sim
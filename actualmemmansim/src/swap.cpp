@@ -0,0 +1,274 @@
+#include "sim/swap.h"
+#include "sim/snapshot.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace sim {
+
+SwapArea::SwapArea(const SimConfig &cfg)
+    : cluster_(cfg.swap_cluster),
+      readahead_(cfg.swap_readahead),
+      cache_size_(cfg.swap_cache),
+      slots_(cfg.swap_slots),
+      cluster_used_((cfg.swap_slots + cfg.swap_cluster - 1) / cfg.swap_cluster, 0),
+      cursor_(0),
+      next_cluster_(0),
+      scan_(0),
+      stamp_(0),
+      used_(0),
+      peak_used_(0),
+      writes_(0),
+      new_clusters_(0),
+      fragmented_(0),
+      full_(0),
+      reads_(0),
+      cache_hits_(0),
+      readahead_pages_(0),
+      readahead_hits_(0) {}
+
+bool SwapArea::enabled() const noexcept {
+    return !slots_.empty();
+}
+
+// ---------------- Slots ----------------
+
+uint64_t SwapArea::allocate() {
+    // Rest of the current cluster
+    if (cursor_ % cluster_ != 0 && cursor_ < slots_.size())
+        return cursor_++;
+
+    // Next entirely free cluster
+    size_t clusters = cluster_used_.size();
+    for (size_t i = 0; i < clusters; ++i) {
+        uint64_t c = (next_cluster_ + i) % clusters;
+        if (cluster_used_[c] != 0)
+            continue;
+        ++new_clusters_;
+        next_cluster_ = (c + 1) % clusters;
+        cursor_ = c * cluster_;
+        return cursor_++;
+    }
+
+    // Any free slot
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        uint64_t s = (scan_ + i) % slots_.size();
+        if (slots_[s].used)
+            continue;
+        ++fragmented_;
+        scan_ = (s + 1) % slots_.size();
+        return s;
+    }
+    return NONE;
+}
+
+bool SwapArea::write(uint32_t pid, uint64_t vpn) {
+    release(pid, vpn);
+    uint64_t s = allocate();
+    if (s == NONE) {
+        ++full_;
+        return false;
+    }
+
+    Slot &slot = slots_[s];
+    slot.used = true;
+    slot.pid = pid;
+    slot.vpn = vpn;
+    ++cluster_used_[s / cluster_];
+    slot_of_[{ pid, vpn }] = s;
+    ++writes_;
+    ++used_;
+    if (used_ > peak_used_)
+        peak_used_ = used_;
+
+    // Under writeback: a fault soon after finds it in the swap cache
+    cache(s, false);
+    return true;
+}
+
+void SwapArea::free_slot(uint64_t s) {
+    Slot &slot = slots_[s];
+    uncache(s);
+    slot_of_.erase({ slot.pid, slot.vpn });
+    slot = Slot{};
+    --cluster_used_[s / cluster_];
+    --used_;
+}
+
+void SwapArea::release(uint32_t pid, uint64_t vpn) {
+    auto it = slot_of_.find({ pid, vpn });
+    if (it != slot_of_.end())
+        free_slot(it->second);
+}
+
+void SwapArea::drop_range(uint32_t pid, uint64_t first_vpn, uint64_t end_vpn) {
+    auto it = slot_of_.lower_bound({ pid, first_vpn });
+    while (it != slot_of_.end() && it->first.first == pid && it->first.second < end_vpn) {
+        uint64_t s = it->second;
+        ++it;
+        free_slot(s);
+    }
+}
+
+void SwapArea::drop_process(uint32_t pid) {
+    drop_range(pid, 0, UINT64_MAX);
+}
+
+// ---------------- Swap cache ----------------
+
+void SwapArea::cache(uint64_t s, bool readahead) {
+    if (cache_size_ == 0)
+        return;
+    while (cache_.size() >= cache_size_)
+        uncache(cache_.begin()->second);
+    cache_[++stamp_] = s;
+    slots_[s].cached = stamp_;
+    slots_[s].readahead = readahead;
+}
+
+void SwapArea::uncache(uint64_t s) {
+    Slot &slot = slots_[s];
+    if (slot.cached == 0)
+        return;
+    cache_.erase(slot.cached);
+    slot.cached = 0;
+    slot.readahead = false;
+}
+
+bool SwapArea::read(uint32_t pid, uint64_t vpn) {
+    auto it = slot_of_.find({ pid, vpn });
+    if (it == slot_of_.end()) {
+        ++reads_;
+        return false;
+    }
+
+    uint64_t s = it->second;
+    if (slots_[s].cached != 0) {
+        ++cache_hits_;
+        if (slots_[s].readahead)
+            ++readahead_hits_;
+        return true;
+    }
+
+    // One I/O for the slot and the ones after it, no more than the
+    // cache holds so readahead does not push out its own pages
+    ++reads_;
+    if (readahead_ > 1) {
+        uint64_t end = std::min<uint64_t>({ s + readahead_, s + 1 + cache_size_, slots_.size() });
+        for (uint64_t t = s + 1; t < end; ++t) {
+            if (!slots_[t].used || slots_[t].cached != 0)
+                continue;
+            cache(t, true);
+            ++readahead_pages_;
+        }
+    }
+    return false;
+}
+
+// ---------------- Counters ----------------
+
+uint64_t SwapArea::slots() const noexcept {
+    return slots_.size();
+}
+
+uint64_t SwapArea::used() const noexcept {
+    return used_;
+}
+
+uint64_t SwapArea::peak_used() const noexcept {
+    return peak_used_;
+}
+
+uint64_t SwapArea::writes() const noexcept {
+    return writes_;
+}
+
+uint64_t SwapArea::new_clusters() const noexcept {
+    return new_clusters_;
+}
+
+uint64_t SwapArea::fragmented() const noexcept {
+    return fragmented_;
+}
+
+uint64_t SwapArea::full() const noexcept {
+    return full_;
+}
+
+uint64_t SwapArea::reads() const noexcept {
+    return reads_;
+}
+
+uint64_t SwapArea::cache_hits() const noexcept {
+    return cache_hits_;
+}
+
+uint64_t SwapArea::readahead_pages() const noexcept {
+    return readahead_pages_;
+}
+
+uint64_t SwapArea::readahead_hits() const noexcept {
+    return readahead_hits_;
+}
+
+// ---------------- Checkpoint ----------------
+
+void SwapArea::save(SnapshotWriter &w) const {
+    w.section("swap");
+    w.u64(slots_.size());
+    w.u64(cluster_);
+    for (const auto &s : slot_of_) {
+        w.u64(s.second + 1);
+        w.u64(s.first.first);
+        w.u64(s.first.second);
+        w.boolean(slots_[s.second].readahead);
+    }
+    w.u64(0);
+    w.u64(cache_.size());
+    for (const auto &c : cache_)
+        w.u64(c.second);
+    w.u64(cursor_);
+    w.u64(next_cluster_);
+    w.u64(scan_);
+    for (uint64_t v : { peak_used_, writes_, new_clusters_, fragmented_, full_, reads_,
+                        cache_hits_, readahead_pages_, readahead_hits_ })
+        w.u64(v);
+}
+
+void SwapArea::load(SnapshotReader &r) {
+    r.section("swap");
+    if (r.u64() != slots_.size() || r.u64() != cluster_)
+        throw std::runtime_error("SwapArea: checkpoint has another swap geometry");
+
+    slots_.assign(slots_.size(), Slot{});
+    cluster_used_.assign(cluster_used_.size(), 0);
+    slot_of_.clear();
+    cache_.clear();
+    used_ = 0;
+    for (uint64_t s = r.u64(); s != 0; s = r.u64()) {
+        Slot &slot = slots_.at(s - 1);
+        slot.used = true;
+        slot.pid = static_cast<uint32_t>(r.u64());
+        slot.vpn = r.u64();
+        slot.readahead = r.boolean();
+        slot_of_[{ slot.pid, slot.vpn }] = s - 1;
+        ++cluster_used_[(s - 1) / cluster_];
+        ++used_;
+    }
+
+    // Stamps restart; only their order matters
+    stamp_ = 0;
+    for (uint64_t n = r.u64(); n > 0; --n) {
+        uint64_t s = r.u64();
+        cache_[++stamp_] = s;
+        slots_.at(s).cached = stamp_;
+    }
+    cursor_ = r.u64();
+    next_cluster_ = r.u64();
+    scan_ = r.u64();
+    for (uint64_t *v : { &peak_used_, &writes_, &new_clusters_, &fragmented_, &full_, &reads_,
+                         &cache_hits_, &readahead_pages_, &readahead_hits_ })
+        *v = r.u64();
+}
+
+} // namespace sim
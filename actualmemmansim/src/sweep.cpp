@@ -0,0 +1,156 @@
+#include "sim/sweep.h"
+#include "sim/simulator.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+
+namespace sim {
+
+// What one point reports
+struct SweepResult {
+    std::string error;
+    uint64_t events = 0;
+    uint64_t sim_time = 0;
+    uint64_t page_faults = 0;
+    double tlb_hit_rate = 0.0;
+    double latency_mean = 0.0;
+    uint64_t latency_p50 = 0;
+    uint64_t latency_p99 = 0;
+    uint64_t peak_resident = 0;
+    uint64_t allocated_bytes = 0;
+    double external_frag = 0.0;
+    double host_ms = 0.0;
+};
+
+SweepAxis parse_sweep_axis(const std::string &spec) {
+    size_t eq = spec.find('=');
+    if (eq == std::string::npos || eq == 0 || eq + 1 == spec.size())
+        throw std::invalid_argument("sweep: expected key=v1,v2,... in " + spec);
+
+    SweepAxis axis;
+    axis.key = spec.substr(0, eq);
+    size_t pos = eq + 1;
+    while (pos <= spec.size()) {
+        size_t comma = spec.find(',', pos);
+        if (comma == std::string::npos)
+            comma = spec.size();
+        if (comma == pos)
+            throw std::invalid_argument("sweep: empty value in " + spec);
+        axis.values.push_back(spec.substr(pos, comma - pos));
+        pos = comma + 1;
+    }
+    return axis;
+}
+
+std::vector<SweepPoint> expand_sweep(const SimConfig &base,
+                                     const std::vector<SweepAxis> &axes) {
+    std::vector<SweepPoint> points(1);
+    points[0].cfg = base;
+
+    for (const auto &axis : axes) {
+        std::vector<SweepPoint> next;
+        next.reserve(points.size() * axis.values.size());
+        for (const auto &p : points) {
+            for (const auto &v : axis.values) {
+                SweepPoint q = p;
+                if (!q.cfg.set(axis.key, v))
+                    throw std::invalid_argument("sweep: unknown key " + axis.key);
+                q.values.push_back(v);
+                next.push_back(std::move(q));
+            }
+        }
+        points = std::move(next);
+    }
+
+    for (const auto &p : points)
+        p.cfg.validate();
+    return points;
+}
+
+static void run_point(const Trace &trace, const SweepPoint &point,
+                      const std::string &snapshot, SweepResult &res) {
+    auto start = std::chrono::steady_clock::now();
+    try {
+        // Nothing is printed from workers: the table is the output
+        std::ostream null_out(nullptr);
+        EventLog log(null_out, null_out, LogLevel::OFF);
+        Simulator sim(point.cfg, trace, log);
+        if (!snapshot.empty())
+            sim.restore(snapshot);
+        sim.run();
+
+        const Metrics &m = sim.metrics();
+        res.events = sim.events_handled();
+        res.sim_time = sim.now();
+        res.page_faults = m.page_faults();
+        res.tlb_hit_rate = m.tlb_hit_rate();
+        res.latency_mean = m.latency().mean();
+        res.latency_p50 = m.latency_p50();
+        res.latency_p99 = m.latency_p99();
+        res.peak_resident = m.peak_resident_frames();
+        res.allocated_bytes = m.allocated_bytes();
+        res.external_frag = m.external_fragmentation();
+    } catch (const std::exception &e) {
+        res.error = e.what();
+        for (auto &ch : res.error)
+            if (ch == ',' || ch == '\n')
+                ch = ';';
+    }
+    res.host_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+void run_sweep(const Trace &trace, const std::vector<SweepAxis> &axes,
+               const std::vector<SweepPoint> &points, unsigned jobs,
+               std::ostream &out, const std::string &snapshot) {
+    std::vector<SweepResult> results(points.size());
+    std::atomic<size_t> next{0};
+
+    auto worker = [&]() {
+        for (size_t i = next++; i < points.size(); i = next++)
+            run_point(trace, points[i], snapshot, results[i]);
+    };
+
+    if (jobs == 0)
+        jobs = 1;
+    if (jobs > points.size())
+        jobs = static_cast<unsigned>(points.size());
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < jobs; ++t)
+        pool.emplace_back(worker);
+    worker();
+    for (auto &t : pool)
+        t.join();
+
+    // ---------------- Table ----------------
+    for (const auto &axis : axes)
+        out << axis.key << ",";
+    out << "events,sim_time,page_faults,tlb_hit_rate,lat_mean,lat_p50,lat_p99,"
+           "peak_resident,allocated_bytes,external_frag,host_ms,error\n";
+
+    char buf[256];
+    for (size_t i = 0; i < points.size(); ++i) {
+        for (const auto &v : points[i].values)
+            out << v << ",";
+        const SweepResult &r = results[i];
+        std::snprintf(buf, sizeof(buf),
+                      "%llu,%llu,%llu,%.4f,%.2f,%llu,%llu,%llu,%llu,%.4f,%.1f,",
+                      (unsigned long long)r.events,
+                      (unsigned long long)r.sim_time,
+                      (unsigned long long)r.page_faults,
+                      r.tlb_hit_rate, r.latency_mean,
+                      (unsigned long long)r.latency_p50,
+                      (unsigned long long)r.latency_p99,
+                      (unsigned long long)r.peak_resident,
+                      (unsigned long long)r.allocated_bytes,
+                      r.external_frag, r.host_ms);
+        out << buf << r.error << "\n";
+    }
+    out.flush();
+}
+
+} // namespace sim
@@ -0,0 +1,104 @@
+#include "sim/threadcache.h"
+#include "sim/snapshot.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace sim {
+
+// tcmalloc-like small size classes (bytes)
+static const uint64_t CLASS_SIZES[] = {
+    8, 16, 32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256, 320, 384, 448, 512,
+    640, 768, 896, 1024
+};
+static constexpr int NUM_CLASSES = sizeof(CLASS_SIZES) / sizeof(CLASS_SIZES[0]);
+
+int ThreadCache::size_class(uint64_t size) noexcept {
+    const uint64_t *end = CLASS_SIZES + NUM_CLASSES;
+    const uint64_t *it = std::lower_bound(CLASS_SIZES, end, size);
+    return (it == end) ? NO_CLASS : static_cast<int>(it - CLASS_SIZES);
+}
+
+int ThreadCache::exact_class(uint64_t size) noexcept {
+    int cls = size_class(size);
+    return (cls != NO_CLASS && CLASS_SIZES[cls] == size) ? cls : NO_CLASS;
+}
+
+uint64_t ThreadCache::class_size(int cls) noexcept {
+    return CLASS_SIZES[cls];
+}
+
+ThreadCache::ThreadCache(size_t batch)
+    : batch_(batch),
+      lists_(NUM_CLASSES),
+      cached_bytes_(0) {}
+
+size_t ThreadCache::batch() const noexcept {
+    return batch_;
+}
+
+std::optional<uint64_t> ThreadCache::pop(int cls) {
+    auto &list = lists_[cls];
+    if (list.empty())
+        return std::nullopt;
+    uint64_t addr = list.back();
+    list.pop_back();
+    cached_bytes_ -= CLASS_SIZES[cls];
+    return addr;
+}
+
+void ThreadCache::push(int cls, uint64_t addr) {
+    lists_[cls].push_back(addr);
+    cached_bytes_ += CLASS_SIZES[cls];
+}
+
+size_t ThreadCache::count(int cls) const {
+    return lists_[cls].size();
+}
+
+size_t ThreadCache::limit() const noexcept {
+    return 2 * batch_;
+}
+
+void ThreadCache::take_cold(int cls, size_t n, std::vector<uint64_t> &out) {
+    auto &list = lists_[cls];
+    n = std::min(n, list.size());
+    out.insert(out.end(), list.begin(), list.begin() + n);
+    list.erase(list.begin(), list.begin() + n);
+    cached_bytes_ -= n * CLASS_SIZES[cls];
+}
+
+void ThreadCache::take_all(std::vector<uint64_t> &out) {
+    for (auto &list : lists_) {
+        out.insert(out.end(), list.begin(), list.end());
+        list.clear();
+    }
+    cached_bytes_ = 0;
+}
+
+uint64_t ThreadCache::cached_bytes() const noexcept {
+    return cached_bytes_;
+}
+
+void ThreadCache::save(SnapshotWriter &w) const {
+    w.u64(batch_);
+    for (const auto &list : lists_) {
+        w.u64(list.size());
+        for (uint64_t addr : list)
+            w.u64(addr);
+    }
+    w.u64(cached_bytes_);
+}
+
+void ThreadCache::load(SnapshotReader &r) {
+    batch_ = r.u64();
+    for (auto &list : lists_) {
+        list.resize(r.u64());
+        for (auto &addr : list)
+            addr = r.u64();
+    }
+    cached_bytes_ = r.u64();
+}
+
+} // namespace sim
@@ -0,0 +1,96 @@
+#include "sim/timeseries.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace sim {
+
+TimeSeries::TimeSeries(std::ostream &out, const TimeSeriesConfig &cfg,
+                       const Metrics &metrics, const MMU &mmu,
+                       const PhysicalMemory &pmem)
+    : out_(out),
+      cfg_(cfg),
+      metrics_(metrics),
+      mmu_(mmu),
+      pmem_(pmem),
+      next_time_(cfg.every_cycles),
+      events_(0),
+      last_events_(0),
+      last_tlb_hits_(0),
+      last_tlb_misses_(0),
+      last_faults_(0) {
+    if (enabled())
+        out_ << "time,events,accesses,faults,fault_rate,tlb_hit_rate,"
+                "free_frames,resident_frames,heap_allocated,heap_free,"
+                "external_frag,rss\n";
+}
+
+bool TimeSeries::enabled() const noexcept {
+    return cfg_.every_cycles != 0 || cfg_.every_events != 0;
+}
+
+void TimeSeries::before_event(uint64_t time, uint64_t now) {
+    if (cfg_.every_events != 0 && events_ != last_events_ &&
+        events_ % cfg_.every_events == 0)
+        sample(now);
+
+    if (cfg_.every_cycles != 0) {
+        while (next_time_ <= time) {
+            sample(next_time_);
+            next_time_ += cfg_.every_cycles;
+        }
+    }
+    ++events_;
+}
+
+void TimeSeries::finish(uint64_t now) {
+    if (enabled() && events_ != last_events_)
+        sample(now);
+    out_.flush();
+}
+
+// ---------------- Row ----------------
+
+void TimeSeries::sample(uint64_t time) {
+    uint64_t hits = metrics_.tlb_hits() - last_tlb_hits_;
+    uint64_t misses = metrics_.tlb_misses() - last_tlb_misses_;
+    uint64_t faults = metrics_.page_faults() - last_faults_;
+    uint64_t accesses = hits + misses;
+
+    last_events_ = events_;
+    last_tlb_hits_ = metrics_.tlb_hits();
+    last_tlb_misses_ = metrics_.tlb_misses();
+    last_faults_ = metrics_.page_faults();
+
+    rss_scratch_.clear();
+    for (const auto &p : mmu_.processes())
+        rss_scratch_.emplace_back(p.first, p.second.resident_pages());
+    std::sort(rss_scratch_.begin(), rss_scratch_.end());
+
+    char buf[256];
+    std::snprintf(buf, sizeof(buf),
+                  "%llu,%llu,%llu,%llu,%.4f,%.4f,%zu,%zu,%llu,%llu,%.4f,",
+                  (unsigned long long)time,
+                  (unsigned long long)events_,
+                  (unsigned long long)accesses,
+                  (unsigned long long)faults,
+                  accesses ? double(faults) / double(accesses) : 0.0,
+                  accesses ? double(hits) / double(accesses) : 0.0,
+                  pmem_.num_frames() - pmem_.used_frames(),
+                  pmem_.used_frames(),
+                  (unsigned long long)metrics_.allocated_bytes(),
+                  (unsigned long long)metrics_.free_bytes(),
+                  metrics_.external_fragmentation());
+    line_.assign(buf);
+
+    for (size_t i = 0; i < rss_scratch_.size(); ++i) {
+        std::snprintf(buf, sizeof(buf), "%s%u:%llu", i ? " " : "",
+                      rss_scratch_[i].first,
+                      (unsigned long long)rss_scratch_[i].second);
+        line_ += buf;
+    }
+    line_ += '\n';
+    out_ << line_;
+}
+
+} // namespace sim
@@ -1,5 +1,7 @@
 #include "sim/workload.h"
+#include "sim/profile.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <unordered_map>
@@ -42,8 +44,12 @@ static int event_priority_for_name(const std::string &ename) {
         {"ACCESS",          3},
         {"MALLOC",          4},
         {"FREE",            4},
+        {"REALLOC",         4},
+        {"CALLOC",          4},
         {"PROC_START",      4},
         {"PROC_EXIT",       4},
+        {"THREAD_START",    4},
+        {"THREAD_EXIT",     4},
         {"SLEEP",           4},
         {"IO_START",        4}
     };
@@ -71,6 +77,19 @@ Workload::Workload(const std::string &path)
     : path_(path) {}
 
 bool Workload::parse_into(EventQueue &q) {
+    Trace trace;
+    if (!parse_into(trace))
+        return false;
+    // Renumbered by the queue, in the same order
+    for (auto &ev : trace.events) {
+        ev.key.seq = 0;
+        q.push(std::move(ev));
+    }
+    return true;
+}
+
+bool Workload::parse_into(Trace &trace) {
+    SIM_PROFILE_SCOPE(PARSE);
     std::ifstream ifs(path_);
     if (!ifs) {
         std::cerr << "Workload: failed to open trace file: " << path_ << "\n";
@@ -103,21 +122,35 @@ bool Workload::parse_into(EventQueue &q) {
             continue;
         }
 
+        // pid field is "pid" or "pid:tid"
         uint32_t pid = 0;
+        uint32_t tid = 0;
         try {
-            pid = static_cast<uint32_t>(std::stoul(toks[1]));
+            size_t colon = toks[1].find(':');
+            pid = static_cast<uint32_t>(std::stoul(toks[1].substr(0, colon)));
+            if (colon != std::string::npos)
+                tid = static_cast<uint32_t>(std::stoul(toks[1].substr(colon + 1)));
         } catch (...) {
             std::cerr << "Workload: invalid pid at line " << lineno << "\n";
             continue;
         }
 
-        std::string evname = toks[2];
-        std::vector<std::string> args(toks.begin() + 3, toks.end());
-        int pri = event_priority_for_name(evname);
-
-        q.push(ts, pri, pid, evname, args, raw);
+        Event ev;
+        ev.key.time = ts;
+        ev.key.priority = event_priority_for_name(toks[2]);
+        ev.key.pid = pid;
+        ev.tid = tid;
+        ev.type = toks[2];
+        ev.args.assign(toks.begin() + 3, toks.end());
+        ev.raw_line = raw;
+        ev.key.seq = trace.events.size() + 1;
+
+        trace.events.push_back(std::move(ev));
     }
 
+    EventCompare after;
+    std::sort(trace.events.begin(), trace.events.end(),
+              [&after](const Event &a, const Event &b) { return after(b, a); });
     return true;
 }
 
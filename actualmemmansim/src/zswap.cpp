@@ -0,0 +1,176 @@
+#include "sim/zswap.h"
+#include "sim/snapshot.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace sim {
+
+// splitmix64 finalizer: a well-spread value per page
+static uint64_t mix(uint64_t x) noexcept {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+ZswapPool::ZswapPool(const SimConfig &cfg)
+    : capacity_(cfg.zswap_pool),
+      page_size_(cfg.page_size),
+      ratios_(cfg.zswap_ratio),
+      total_weight_(0),
+      bytes_(0),
+      peak_pages_(0),
+      peak_bytes_(0),
+      stores_(0),
+      loads_(0),
+      rejects_full_(0),
+      rejects_incompressible_(0),
+      stored_bytes_(0) {
+    for (const auto &r : ratios_)
+        total_weight_ += r.weight;
+}
+
+bool ZswapPool::enabled() const noexcept {
+    return capacity_ != 0;
+}
+
+uint64_t ZswapPool::compressed_size(uint32_t pid, uint64_t vpn) const {
+    uint64_t pick = mix(mix(pid) ^ vpn) % total_weight_;
+    for (const auto &r : ratios_) {
+        if (pick < r.weight) {
+            auto size = static_cast<uint64_t>(std::ceil(static_cast<double>(page_size_) / r.ratio));
+            return std::clamp<uint64_t>(size, 1, page_size_);
+        }
+        pick -= r.weight;
+    }
+    return page_size_;
+}
+
+bool ZswapPool::store(uint32_t pid, uint64_t vpn) {
+    uint64_t size = compressed_size(pid, vpn);
+    if (size >= page_size_) {
+        ++rejects_incompressible_;
+        return false;
+    }
+    if (bytes_ + size > capacity_) {
+        ++rejects_full_;
+        return false;
+    }
+
+    entries_[{ pid, vpn }] = size;
+    bytes_ += size;
+    ++stores_;
+    stored_bytes_ += size;
+    if (entries_.size() > peak_pages_) {
+        peak_pages_ = entries_.size();
+        peak_bytes_ = bytes_;
+    }
+    return true;
+}
+
+bool ZswapPool::load(uint32_t pid, uint64_t vpn) {
+    auto it = entries_.find({ pid, vpn });
+    if (it == entries_.end())
+        return false;
+    bytes_ -= it->second;
+    entries_.erase(it);
+    ++loads_;
+    return true;
+}
+
+bool ZswapPool::contains(uint32_t pid, uint64_t vpn) const {
+    return entries_.count({ pid, vpn }) != 0;
+}
+
+void ZswapPool::drop_range(uint32_t pid, uint64_t first_vpn, uint64_t end_vpn) {
+    auto it = entries_.lower_bound({ pid, first_vpn });
+    while (it != entries_.end() && it->first.first == pid && it->first.second < end_vpn) {
+        bytes_ -= it->second;
+        it = entries_.erase(it);
+    }
+}
+
+void ZswapPool::drop_process(uint32_t pid) {
+    drop_range(pid, 0, UINT64_MAX);
+}
+
+uint64_t ZswapPool::capacity() const noexcept {
+    return capacity_;
+}
+
+uint64_t ZswapPool::pages() const noexcept {
+    return entries_.size();
+}
+
+uint64_t ZswapPool::bytes() const noexcept {
+    return bytes_;
+}
+
+uint64_t ZswapPool::peak_pages() const noexcept {
+    return peak_pages_;
+}
+
+uint64_t ZswapPool::peak_bytes() const noexcept {
+    return peak_bytes_;
+}
+
+uint64_t ZswapPool::stores() const noexcept {
+    return stores_;
+}
+
+uint64_t ZswapPool::loads() const noexcept {
+    return loads_;
+}
+
+uint64_t ZswapPool::rejects_full() const noexcept {
+    return rejects_full_;
+}
+
+uint64_t ZswapPool::rejects_incompressible() const noexcept {
+    return rejects_incompressible_;
+}
+
+double ZswapPool::mean_ratio() const noexcept {
+    if (stored_bytes_ == 0) return 0.0;
+    return static_cast<double>(stores_ * page_size_) / static_cast<double>(stored_bytes_);
+}
+
+void ZswapPool::save(SnapshotWriter &w) const {
+    w.section("zswap");
+    w.u64(entries_.size());
+    for (const auto &e : entries_) {
+        w.u64(e.first.first);
+        w.u64(e.first.second);
+        w.u64(e.second);
+    }
+    w.u64(peak_pages_);
+    w.u64(peak_bytes_);
+    w.u64(stores_);
+    w.u64(loads_);
+    w.u64(rejects_full_);
+    w.u64(rejects_incompressible_);
+    w.u64(stored_bytes_);
+}
+
+void ZswapPool::load(SnapshotReader &r) {
+    r.section("zswap");
+    entries_.clear();
+    bytes_ = 0;
+    for (uint64_t n = r.u64(); n > 0; --n) {
+        auto pid = static_cast<uint32_t>(r.u64());
+        uint64_t vpn = r.u64();
+        uint64_t size = r.u64();
+        entries_[{ pid, vpn }] = size;
+        bytes_ += size;
+    }
+    peak_pages_ = r.u64();
+    peak_bytes_ = r.u64();
+    stores_ = r.u64();
+    loads_ = r.u64();
+    rejects_full_ = r.u64();
+    rejects_incompressible_ = r.u64();
+    stored_bytes_ = r.u64();
+}
+
+} // namespace sim